@@ -0,0 +1,149 @@
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <vector>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define FRUSTUM_X86 1
+#include <xmmintrin.h>
+#endif
+
+// The view volume of a projection * view (* model) matrix as six planes (Gribb and
+// Hartmann, "Fast Extraction of Viewing Frustum Planes from the World-View-Projection
+// Matrix"), in the space the matrix maps from: with the model matrix included, bounds in
+// model space are tested as they are.
+//
+//     Frustum frustum(projection * camera.GetViewMatrix() * model);
+//     cullBoxes(frustum, boxes, visible);
+struct Frustum
+{
+    // xyz the inward unit normal, w the offset: p is inside where dot(xyz, p) + w >= 0
+    glm::vec4 planes[6];
+
+    explicit Frustum(const glm::mat4 &matrix)
+    {
+        // glm is column major: row r is (m[0][r], m[1][r], m[2][r], m[3][r])
+        glm::vec4 rows[4];
+        for (int r = 0; r < 4; ++r)
+            rows[r] = glm::vec4(matrix[0][r], matrix[1][r], matrix[2][r], matrix[3][r]);
+        planes[0] = rows[3] + rows[0];  // left
+        planes[1] = rows[3] - rows[0];  // right
+        planes[2] = rows[3] + rows[1];  // bottom
+        planes[3] = rows[3] - rows[1];  // top
+        planes[4] = rows[3] + rows[2];  // near
+        planes[5] = rows[3] - rows[2];  // far
+        for (int p = 0; p < 6; ++p)
+        {
+            float length = glm::length(glm::vec3(planes[p]));
+            if (length > 0.0f)
+                planes[p] /= length;
+        }
+    }
+
+    bool intersectsSphere(const glm::vec3 &center, float radius) const
+    {
+        for (int p = 0; p < 6; ++p)
+            if (glm::dot(glm::vec3(planes[p]), center) + planes[p].w < -radius)
+                return false;
+        return true;
+    }
+
+    // the box given by its centre and half size
+    bool intersectsBox(const glm::vec3 &center, const glm::vec3 &extent) const
+    {
+        for (int p = 0; p < 6; ++p)
+        {
+            glm::vec3 normal(planes[p]);
+            if (glm::dot(normal, center) + planes[p].w < -glm::dot(glm::abs(normal), extent))
+                return false;
+        }
+        return true;
+    }
+};
+
+// axis aligned boxes as centres and half sizes, one array per component, so cullBoxes
+// tests four at a time.
+struct BoundingBoxes
+{
+    std::vector<float> centerX, centerY, centerZ;
+    std::vector<float> extentX, extentY, extentZ;
+
+    size_t size() const { return centerX.size(); }
+
+    void add(const glm::vec3 &lower, const glm::vec3 &upper)
+    {
+        glm::vec3 center = (lower + upper) * 0.5f, extent = (upper - lower) * 0.5f;
+        centerX.push_back(center.x); centerY.push_back(center.y); centerZ.push_back(center.z);
+        extentX.push_back(extent.x); extentY.push_back(extent.y); extentZ.push_back(extent.z);
+    }
+};
+
+// what a cull let through and what it dropped
+struct CullingStats
+{
+    unsigned int visible = 0;
+    unsigned int culled = 0;
+
+    CullingStats &operator+=(const CullingStats &other)
+    {
+        visible += other.visible;
+        culled += other.culled;
+        return *this;
+    }
+};
+
+// visible[i] = 1 if box i is inside or crosses the frustum, else 0 (conservative: a box
+// just outside a corner may pass). Returns the counts.
+inline CullingStats cullBoxes(const Frustum &frustum, const BoundingBoxes &boxes, std::vector<unsigned char> &visible)
+{
+    size_t count = boxes.size();
+    visible.resize(count);
+    CullingStats stats;
+    size_t i = 0;
+#ifdef FRUSTUM_X86
+    // a box is outside a plane if its centre is further behind it than the box reaches
+    // along the normal: dot(n, c) + w + dot(|n|, e) < 0
+    __m128 nx[6], ny[6], nz[6], ax[6], ay[6], az[6], w[6];
+    const __m128 signBit = _mm_set1_ps(-0.0f);
+    for (int p = 0; p < 6; ++p)
+    {
+        nx[p] = _mm_set1_ps(frustum.planes[p].x);
+        ny[p] = _mm_set1_ps(frustum.planes[p].y);
+        nz[p] = _mm_set1_ps(frustum.planes[p].z);
+        w[p] = _mm_set1_ps(frustum.planes[p].w);
+        ax[p] = _mm_andnot_ps(signBit, nx[p]);
+        ay[p] = _mm_andnot_ps(signBit, ny[p]);
+        az[p] = _mm_andnot_ps(signBit, nz[p]);
+    }
+    const __m128 zero = _mm_setzero_ps();
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 cx = _mm_loadu_ps(&boxes.centerX[i]), cy = _mm_loadu_ps(&boxes.centerY[i]), cz = _mm_loadu_ps(&boxes.centerZ[i]);
+        __m128 ex = _mm_loadu_ps(&boxes.extentX[i]), ey = _mm_loadu_ps(&boxes.extentY[i]), ez = _mm_loadu_ps(&boxes.extentZ[i]);
+        __m128 outside = zero;
+        for (int p = 0; p < 6; ++p)
+        {
+            __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(cx, nx[p]), _mm_mul_ps(cy, ny[p])), _mm_add_ps(_mm_mul_ps(cz, nz[p]), w[p]));
+            __m128 reach = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ex, ax[p]), _mm_mul_ps(ey, ay[p])), _mm_mul_ps(ez, az[p]));
+            outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(distance, reach), zero));
+        }
+        int mask = _mm_movemask_ps(outside);
+        for (int k = 0; k < 4; ++k)
+            visible[i + k] = (mask >> k & 1) ? 0 : 1;
+    }
+#endif
+    for (; i < count; ++i)
+    {
+        glm::vec3 center(boxes.centerX[i], boxes.centerY[i], boxes.centerZ[i]);
+        glm::vec3 extent(boxes.extentX[i], boxes.extentY[i], boxes.extentZ[i]);
+        visible[i] = frustum.intersectsBox(center, extent) ? 1 : 0;
+    }
+    for (i = 0; i < count; ++i)
+        stats.visible += visible[i];
+    stats.culled = (unsigned int)count - stats.visible;
+    return stats;
+}
+#endif
@@ -0,0 +1,210 @@
+#ifndef GEOMETRY_BUFFER_H
+#define GEOMETRY_BUFFER_H
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <learnopengl/mesh.h>
+
+#include <iostream>
+#include <vector>
+
+// The vertices and indices of many meshes (a model's, or a whole scene's) sub-allocated
+// from one vertex and one index buffer behind a single VAO. Every added mesh gets a draw
+// index; a range of consecutive draws goes out as one glMultiDrawElementsIndirect from a
+// command buffer written once at upload(), each command's baseInstance selecting the
+// mesh's position decode from a per draw attribute array. Without GL 4.3 (or
+// ARB_multi_draw_indirect and ARB_base_instance) the range is drawn with one
+// glDrawElementsBaseVertex per mesh and the decode set as constant attributes.
+// A mesh's levels of detail are more draws over its vertices (addLevel).
+//
+//     GeometryBuffer scene(VERTEX_QUANTIZED);
+//     unsigned int first = scene.add(mesh);  // ... for every mesh
+//     scene.upload();
+//     scene.draw(first, count);
+class GeometryBuffer
+{
+public:
+    // glMultiDrawElementsIndirect's command layout
+    struct DrawCommand
+    {
+        GLuint count;
+        GLuint instanceCount;
+        GLuint firstIndex;
+        GLint  baseVertex;
+        GLuint baseInstance;
+    };
+
+    explicit GeometryBuffer(VertexFormat format = VERTEX_FULL) : format(format) {}
+
+    // the buffers are deleted with it (on the GL thread, while the context is current); not
+    // copyable, two copies would delete the same names.
+    ~GeometryBuffer()
+    {
+        if (VAO)
+            glDeleteVertexArrays(1, &VAO);
+        GLuint buffers[4] = { VBO, EBO, decodeBuffer, commandBuffer };
+        for (int i = 0; i < 4; ++i)
+            if (buffers[i])
+                glDeleteBuffers(1, &buffers[i]);
+    }
+
+    GeometryBuffer(const GeometryBuffer &) = delete;
+    GeometryBuffer &operator=(const GeometryBuffer &) = delete;
+
+    VertexFormat vertexFormat() const { return format; }
+    unsigned int drawCount() const { return (unsigned int)commands.size(); }
+    bool uploaded() const { return VAO != 0; }
+    // true if draw() issues a single multi-draw per range
+    bool multiDraw() const { return indirect; }
+
+    // appends the mesh's geometry in this buffer's format (setting the mesh's position
+    // decode) and returns its draw index. Only before upload().
+    unsigned int add(Mesh &mesh)
+    {
+        if (uploaded())
+        {
+            std::cout << "ERROR::GEOMETRY_BUFFER::ADD_AFTER_UPLOAD" << std::endl;
+            return 0;
+        }
+        DrawCommand command;
+        command.count = (GLuint)mesh.indices.size();
+        command.instanceCount = 1;
+        command.firstIndex = (GLuint)indexData.size();
+        command.baseVertex = (GLint)vertexCount;
+        command.baseInstance = (GLuint)commands.size();
+        commands.push_back(command);
+
+        packVertices(mesh.vertices, format, vertexData, mesh.positionOffset, mesh.positionScale);
+        mesh.format = format;
+        vertexCount += mesh.vertices.size();
+        indexData.insert(indexData.end(), mesh.indices.begin(), mesh.indices.end());
+        decode.push_back(mesh.positionOffset);
+        decode.push_back(mesh.positionScale);
+        return command.baseInstance;
+    }
+
+    // a draw of other indices over the vertices of draw (a coarser level of its mesh); its
+    // draw index. Only before upload().
+    unsigned int addLevel(unsigned int draw, const vector<unsigned int> &indices)
+    {
+        unsigned int level = repeat(draw);
+        if (level != draw)
+        {
+            commands[level].count = (GLuint)indices.size();
+            commands[level].firstIndex = (GLuint)indexData.size();
+            indexData.insert(indexData.end(), indices.begin(), indices.end());
+        }
+        return level;
+    }
+
+    // draw once more, under a new draw index (for a mesh with fewer levels than others
+    // drawn with it). Only before upload().
+    unsigned int repeat(unsigned int draw)
+    {
+        if (uploaded() || draw >= commands.size())
+        {
+            std::cout << (uploaded() ? "ERROR::GEOMETRY_BUFFER::ADD_AFTER_UPLOAD" : "ERROR::GEOMETRY_BUFFER::NO_SUCH_DRAW") << std::endl;
+            return draw;
+        }
+        DrawCommand command = commands[draw];
+        command.baseInstance = (GLuint)commands.size();
+        commands.push_back(command);
+        decode.push_back(decode[draw * 2]);
+        decode.push_back(decode[draw * 2 + 1]);
+        return command.baseInstance;
+    }
+
+    // creates the buffers from everything added; the staging copies are freed.
+    void upload()
+    {
+        if (uploaded())
+            return;
+        indirect = GLEW_VERSION_4_3 || (GLEW_ARB_multi_draw_indirect && GLEW_ARB_base_instance);
+
+        glGenVertexArrays(1, &VAO);
+        glGenBuffers(1, &VBO);
+        glGenBuffers(1, &EBO);
+        glBindVertexArray(VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        glBufferData(GL_ARRAY_BUFFER, vertexData.size(), vertexData.empty() ? nullptr : &vertexData[0], GL_STATIC_DRAW);
+        setupVertexAttributes(format);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexData.size() * sizeof(unsigned int), indexData.empty() ? nullptr : &indexData[0], GL_STATIC_DRAW);
+
+        if (indirect)
+        {
+            // offset and scale of each draw, stepped by the instance (= baseInstance)
+            glGenBuffers(1, &decodeBuffer);
+            glBindBuffer(GL_ARRAY_BUFFER, decodeBuffer);
+            glBufferData(GL_ARRAY_BUFFER, decode.size() * sizeof(glm::vec3), decode.empty() ? nullptr : &decode[0], GL_STATIC_DRAW);
+            glEnableVertexAttribArray(POSITION_OFFSET_ATTRIBUTE);
+            glVertexAttribPointer(POSITION_OFFSET_ATTRIBUTE, 3, GL_FLOAT, GL_FALSE, 2 * sizeof(glm::vec3), (void*)0);
+            glVertexAttribDivisor(POSITION_OFFSET_ATTRIBUTE, 1);
+            glEnableVertexAttribArray(POSITION_SCALE_ATTRIBUTE);
+            glVertexAttribPointer(POSITION_SCALE_ATTRIBUTE, 3, GL_FLOAT, GL_FALSE, 2 * sizeof(glm::vec3), (void*)sizeof(glm::vec3));
+            glVertexAttribDivisor(POSITION_SCALE_ATTRIBUTE, 1);
+
+            glGenBuffers(1, &commandBuffer);
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+            glBufferData(GL_DRAW_INDIRECT_BUFFER, commands.size() * sizeof(DrawCommand), commands.empty() ? nullptr : &commands[0], GL_STATIC_DRAW);
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+        }
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        vertexBytes = vertexData.size();
+        indexBytes = indexData.size() * sizeof(unsigned int);
+        vector<unsigned char>().swap(vertexData);
+        vector<unsigned int>().swap(indexData);
+    }
+
+    // binds the vertex array (and the command buffer); draw() expects it bound.
+    void bind() const
+    {
+        glBindVertexArray(VAO);
+        if (indirect)
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+    }
+
+    // draws count meshes from draw index first, all with the textures bound now.
+    void draw(unsigned int first, unsigned int count) const
+    {
+        if (indirect)
+        {
+            glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)(first * sizeof(DrawCommand)), count, 0);
+            return;
+        }
+        for (unsigned int i = first; i < first + count; ++i)
+        {
+            const DrawCommand &command = commands[i];
+            glVertexAttrib3fv(POSITION_OFFSET_ATTRIBUTE, &decode[i * 2][0]);
+            glVertexAttrib3fv(POSITION_SCALE_ATTRIBUTE, &decode[i * 2 + 1][0]);
+            glDrawElementsBaseVertex(GL_TRIANGLES, command.count, GL_UNSIGNED_INT,
+                (void*)(command.firstIndex * sizeof(unsigned int)), command.baseVertex);
+        }
+    }
+
+    // vertex and index bytes added so far (until upload())
+    size_t stagedBytes() const { return vertexData.size() + indexData.size() * sizeof(unsigned int); }
+
+    // sizes of the vertex and index buffers once uploaded
+    size_t vertexBufferBytes() const { return vertexBytes; }
+    size_t indexBufferBytes() const { return indexBytes; }
+
+private:
+    VertexFormat format;
+    // staging until upload()
+    vector<unsigned char> vertexData;
+    vector<unsigned int> indexData;
+    size_t vertexCount = 0;
+    // per draw: the command and the position decode (offset, scale)
+    vector<DrawCommand> commands;
+    vector<glm::vec3> decode;
+
+    bool indirect = false;
+    unsigned int VAO = 0, VBO = 0, EBO = 0;
+    unsigned int decodeBuffer = 0, commandBuffer = 0;
+    size_t vertexBytes = 0, indexBytes = 0;
+};
+#endif
@@ -0,0 +1,22 @@
+#ifndef HASH_H
+#define HASH_H
+
+#include <cstddef>
+#include <cstdint>
+
+// 64-bit FNV-1a over a byte range, continuing from hash so it can be chained over several
+// pieces. It names the linked program binaries (shader_source.h), checks the mesh cache
+// against its source (mesh_cache.h) and names the baked IBL files (ibl_cache.h).
+const uint64_t FNV1A_OFFSET_BASIS = 14695981039346656037ull;
+
+inline uint64_t fnv1aHash(const void *data, size_t bytes, uint64_t hash = FNV1A_OFFSET_BASIS)
+{
+    const unsigned char *p = (const unsigned char *)data;
+    for (size_t i = 0; i < bytes; ++i)
+    {
+        hash ^= p[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+#endif
@@ -0,0 +1,373 @@
+#ifndef MESH_CACHE_H
+#define MESH_CACHE_H
+
+#include <learnopengl/hash.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Processed model geometry kept next to the source file (<model>.meshcache), so a warm
+// start maps it and uploads the vertices and indices without running the importer.
+// The file is read in place:
+//
+//     MeshCacheHeader
+//     MeshCacheEntry[meshCount]        one per mesh, in draw order
+//     MeshCacheTexture[textureCount]   material textures of all meshes
+//     MeshCacheLod[lodCount]           coarser index lists of all meshes
+//     char strings[stringBytes]        texture types and paths, 0 terminated
+//     vertex and index arrays          each 16 byte aligned, at the entries' offsets
+//
+// An entry is only used if the version, the vertex size, the import flags and the hash
+// of the source file's contents all match; bump MESH_CACHE_VERSION whenever the
+// processing after the import changes.
+const char MESH_CACHE_MAGIC[4] = { 'M', 'S', 'H', 'C' };
+const uint32_t MESH_CACHE_VERSION = 3;    // 2: optimized triangle and vertex order, 3: levels of detail
+
+struct MeshCacheHeader
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t vertexSize;
+    uint32_t importFlags;
+    uint64_t sourceHash;
+    uint64_t fileBytes;     // catches truncated files
+    uint32_t meshCount;
+    uint32_t textureCount;
+    uint32_t stringBytes;
+    uint32_t lodCount;
+};
+
+struct MeshCacheEntry
+{
+    uint64_t vertexOffset;  // from the start of the file
+    uint64_t indexOffset;
+    uint32_t vertexCount;
+    uint32_t indexCount;
+    uint32_t firstTexture;
+    uint32_t textureCount;
+    uint32_t firstLod;
+    uint32_t lodCount;      // levels after the full one
+};
+
+struct MeshCacheTexture
+{
+    uint32_t type;          // offsets into the strings
+    uint32_t path;
+};
+
+// the indices of a level, over the mesh's vertices
+struct MeshCacheLod
+{
+    uint64_t indexOffset;
+    uint32_t indexCount;
+    uint32_t reserved;
+};
+
+// a whole file mapped read-only.
+class MappedFile
+{
+public:
+    MappedFile() {}
+    ~MappedFile() { close(); }
+
+    bool open(const std::string &path)
+    {
+        close();
+#ifdef _WIN32
+        file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (file == INVALID_HANDLE_VALUE)
+            return false;
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+        {
+            close();
+            return false;
+        }
+        mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (mapping)
+            bytes = (const unsigned char *)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        length = (size_t)size.QuadPart;
+#else
+        descriptor = ::open(path.c_str(), O_RDONLY);
+        if (descriptor < 0)
+            return false;
+        struct stat info;
+        if (fstat(descriptor, &info) != 0 || info.st_size == 0)
+        {
+            close();
+            return false;
+        }
+        void *view = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+        if (view != MAP_FAILED)
+            bytes = (const unsigned char *)view;
+        length = (size_t)info.st_size;
+#endif
+        if (!bytes)
+        {
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    void close()
+    {
+#ifdef _WIN32
+        if (bytes)
+            UnmapViewOfFile(bytes);
+        if (mapping)
+            CloseHandle(mapping);
+        if (file != INVALID_HANDLE_VALUE)
+            CloseHandle(file);
+        mapping = NULL;
+        file = INVALID_HANDLE_VALUE;
+#else
+        if (bytes)
+            munmap((void *)bytes, length);
+        if (descriptor >= 0)
+            ::close(descriptor);
+        descriptor = -1;
+#endif
+        bytes = nullptr;
+        length = 0;
+    }
+
+    const unsigned char *data() const { return bytes; }
+    size_t size() const { return length; }
+
+private:
+    MappedFile(const MappedFile &);
+    MappedFile &operator=(const MappedFile &);
+
+    const unsigned char *bytes = nullptr;
+    size_t length = 0;
+#ifdef _WIN32
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = NULL;
+#else
+    int descriptor = -1;
+#endif
+};
+
+// hash of a file's contents (mapped, not read through a buffer); false if it can't be opened.
+inline bool meshCacheHashFile(const std::string &path, uint64_t &hash)
+{
+    MappedFile file;
+    if (!file.open(path))
+        return false;
+    hash = fnv1aHash(file.data(), file.size());
+    return true;
+}
+
+// a cache file mapped and checked against the source; the arrays point into the mapping.
+class MeshCacheReader
+{
+public:
+    bool open(const std::string &path, uint64_t sourceHash, uint32_t importFlags, uint32_t vertexSize)
+    {
+        if (!file.open(path))
+            return false;
+        const unsigned char *bytes = file.data();
+        if (file.size() < sizeof(MeshCacheHeader))
+            return reject(path, "truncated");
+        memcpy(&header, bytes, sizeof(header));
+        if (memcmp(header.magic, MESH_CACHE_MAGIC, 4) != 0 || header.version != MESH_CACHE_VERSION || header.vertexSize != vertexSize)
+            return reject(path, "from another version");
+        if (header.sourceHash != sourceHash || header.importFlags != importFlags)
+            return reject(path, "out of date");
+        size_t tables = sizeof(MeshCacheHeader) + header.meshCount * sizeof(MeshCacheEntry)
+            + header.textureCount * sizeof(MeshCacheTexture) + header.lodCount * sizeof(MeshCacheLod) + header.stringBytes;
+        if (header.fileBytes != file.size() || tables > file.size())
+            return reject(path, "truncated");
+        entries = (const MeshCacheEntry *)(bytes + sizeof(MeshCacheHeader));
+        textureTable = (const MeshCacheTexture *)(entries + header.meshCount);
+        lodTable = (const MeshCacheLod *)(textureTable + header.textureCount);
+        strings = (const char *)(lodTable + header.lodCount);
+        for (uint32_t i = 0; i < header.meshCount; ++i)
+        {
+            const MeshCacheEntry &entry = entries[i];
+            if (entry.vertexOffset + (uint64_t)entry.vertexCount * vertexSize > file.size()
+                || entry.indexOffset + (uint64_t)entry.indexCount * sizeof(uint32_t) > file.size()
+                || entry.firstTexture + entry.textureCount > header.textureCount
+                || entry.firstLod + entry.lodCount > header.lodCount)
+                return reject(path, "damaged");
+        }
+        for (uint32_t i = 0; i < header.lodCount; ++i)
+            if (lodTable[i].indexOffset + (uint64_t)lodTable[i].indexCount * sizeof(uint32_t) > file.size())
+                return reject(path, "damaged");
+        for (uint32_t i = 0; i < header.textureCount; ++i)
+            if (textureTable[i].type >= header.stringBytes || textureTable[i].path >= header.stringBytes)
+                return reject(path, "damaged");
+        if (header.stringBytes && strings[header.stringBytes - 1] != 0)
+            return reject(path, "damaged");
+        return true;
+    }
+
+    uint32_t meshCount() const { return header.meshCount; }
+    const MeshCacheEntry &mesh(uint32_t i) const { return entries[i]; }
+    const void *vertices(uint32_t i) const { return file.data() + entries[i].vertexOffset; }
+    const uint32_t *indices(uint32_t i) const { return (const uint32_t *)(file.data() + entries[i].indexOffset); }
+    const char *textureType(uint32_t texture) const { return strings + textureTable[texture].type; }
+    const char *texturePath(uint32_t texture) const { return strings + textureTable[texture].path; }
+    // level 1 + lod of mesh i
+    const MeshCacheLod &lod(uint32_t i, uint32_t lod) const { return lodTable[entries[i].firstLod + lod]; }
+    const uint32_t *lodIndices(uint32_t i, uint32_t lod) const { return (const uint32_t *)(file.data() + this->lod(i, lod).indexOffset); }
+
+private:
+    MappedFile file;
+    MeshCacheHeader header;
+    const MeshCacheEntry *entries = nullptr;
+    const MeshCacheTexture *textureTable = nullptr;
+    const MeshCacheLod *lodTable = nullptr;
+    const char *strings = nullptr;
+
+    bool reject(const std::string &path, const char *why)
+    {
+        std::cout << "Mesh cache " << path << " is " << why << ", importing the model" << std::endl;
+        file.close();
+        return false;
+    }
+};
+
+// collects the processed meshes and writes them in the layout above.
+class MeshCacheWriter
+{
+public:
+    explicit MeshCacheWriter(uint32_t vertexSize) : vertexSize(vertexSize) {}
+
+    // textures: (type, path) pairs of the mesh's material; lods: the index lists of its
+    // coarser levels
+    void addMesh(const void *vertices, uint32_t vertexCount, const uint32_t *indices, uint32_t indexCount,
+        const std::vector<std::pair<std::string, std::string> > &textures,
+        const std::vector<std::vector<uint32_t> > &lods = std::vector<std::vector<uint32_t> >())
+    {
+        MeshCacheEntry entry;
+        entry.vertexOffset = append(vertices, (size_t)vertexCount * vertexSize);
+        entry.indexOffset = append(indices, (size_t)indexCount * sizeof(uint32_t));
+        entry.vertexCount = vertexCount;
+        entry.indexCount = indexCount;
+        entry.firstTexture = (uint32_t)textureTable.size();
+        entry.textureCount = (uint32_t)textures.size();
+        for (size_t i = 0; i < textures.size(); ++i)
+        {
+            MeshCacheTexture texture;
+            texture.type = addString(textures[i].first);
+            texture.path = addString(textures[i].second);
+            textureTable.push_back(texture);
+        }
+        entry.firstLod = (uint32_t)lodTable.size();
+        entry.lodCount = (uint32_t)lods.size();
+        for (size_t i = 0; i < lods.size(); ++i)
+        {
+            MeshCacheLod lod;
+            lod.indexOffset = append(lods[i].empty() ? nullptr : &lods[i][0], lods[i].size() * sizeof(uint32_t));
+            lod.indexCount = (uint32_t)lods[i].size();
+            lod.reserved = 0;
+            lodTable.push_back(lod);
+        }
+        entries.push_back(entry);
+    }
+
+    // write to path (through a temporary file, so a reader never sees half of it).
+    bool write(const std::string &path, uint64_t sourceHash, uint32_t importFlags) const
+    {
+        MeshCacheHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, MESH_CACHE_MAGIC, 4);
+        header.version = MESH_CACHE_VERSION;
+        header.vertexSize = vertexSize;
+        header.importFlags = importFlags;
+        header.sourceHash = sourceHash;
+        header.meshCount = (uint32_t)entries.size();
+        header.textureCount = (uint32_t)textureTable.size();
+        header.stringBytes = (uint32_t)strings.size();
+        header.lodCount = (uint32_t)lodTable.size();
+        size_t tables = sizeof(header) + entries.size() * sizeof(MeshCacheEntry)
+            + textureTable.size() * sizeof(MeshCacheTexture) + lodTable.size() * sizeof(MeshCacheLod) + strings.size();
+        size_t dataStart = align(tables);
+        header.fileBytes = dataStart + blob.size();
+
+        // the offsets were collected relative to the blob
+        std::vector<MeshCacheEntry> placed(entries);
+        for (size_t i = 0; i < placed.size(); ++i)
+        {
+            placed[i].vertexOffset += dataStart;
+            placed[i].indexOffset += dataStart;
+        }
+        std::vector<MeshCacheLod> placedLods(lodTable);
+        for (size_t i = 0; i < placedLods.size(); ++i)
+            placedLods[i].indexOffset += dataStart;
+
+        std::string temporary = path + ".tmp";
+        FILE *file = fopen(temporary.c_str(), "wb");
+        if (!file)
+        {
+            std::cout << "Failed to write mesh cache " << path << std::endl;
+            return false;
+        }
+        static const char padding[16] = { 0 };
+        bool ok = fwrite(&header, sizeof(header), 1, file) == 1
+            && (placed.empty() || fwrite(&placed[0], sizeof(MeshCacheEntry), placed.size(), file) == placed.size())
+            && (textureTable.empty() || fwrite(&textureTable[0], sizeof(MeshCacheTexture), textureTable.size(), file) == textureTable.size())
+            && (placedLods.empty() || fwrite(&placedLods[0], sizeof(MeshCacheLod), placedLods.size(), file) == placedLods.size())
+            && (strings.empty() || fwrite(&strings[0], 1, strings.size(), file) == strings.size())
+            && (dataStart == tables || fwrite(padding, 1, dataStart - tables, file) == dataStart - tables)
+            && (blob.empty() || fwrite(&blob[0], 1, blob.size(), file) == blob.size());
+        ok = fclose(file) == 0 && ok;
+        remove(path.c_str());
+        if (!ok || rename(temporary.c_str(), path.c_str()) != 0)
+        {
+            remove(temporary.c_str());
+            std::cout << "Failed to write mesh cache " << path << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+private:
+    uint32_t vertexSize;
+    std::vector<MeshCacheEntry> entries;
+    std::vector<MeshCacheTexture> textureTable;
+    std::vector<MeshCacheLod> lodTable;
+    std::vector<char> strings;
+    std::vector<unsigned char> blob;
+
+    static size_t align(size_t offset) { return (offset + 15) & ~(size_t)15; }
+
+    uint64_t append(const void *data, size_t bytes)
+    {
+        size_t offset = align(blob.size());
+        blob.resize(offset + bytes);
+        if (bytes)
+            memcpy(&blob[offset], data, bytes);
+        return offset;
+    }
+
+    uint32_t addString(const std::string &text)
+    {
+        uint32_t offset = (uint32_t)strings.size();
+        strings.insert(strings.end(), text.begin(), text.end());
+        strings.push_back(0);
+        return offset;
+    }
+};
+#endif
@@ -0,0 +1,294 @@
+#ifndef MESH_SIMPLIFY_H
+#define MESH_SIMPLIFY_H
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/mesh.h>
+#include <learnopengl/mesh_optimize.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+// Levels of detail by quadric error edge collapse (Garland and Heckbert, "Surface
+// Simplification Using Quadric Error Metrics", 1997). A vertex is only ever collapsed onto
+// a neighbour, never moved, so every level is an index list over the mesh's own vertices
+// and all levels share its vertex buffer. Identical vertices are treated as one; vertices
+// on a border or on an attribute seam (vertices at one position that differ in normal,
+// texture coordinates or tangent frame) stay, so neither the outline nor the texturing
+// tears.
+// Each pass collapses the cheapest edges whose neighbourhoods don't overlap, skipping
+// those that would flip a triangle, until the target size or the error limit is reached.
+
+// sum of squared distances to a set of planes, each weighted by its triangle's area
+struct Quadric
+{
+    double a2 = 0, ab = 0, ac = 0, ad = 0, b2 = 0, bc = 0, bd = 0, c2 = 0, cd = 0, d2 = 0;
+    double weight = 0;
+
+    // the plane dot(n, p) + d = 0 (n unit length)
+    static Quadric plane(const glm::dvec3 &n, double d, double weight)
+    {
+        Quadric q;
+        q.a2 = n.x * n.x * weight; q.ab = n.x * n.y * weight; q.ac = n.x * n.z * weight; q.ad = n.x * d * weight;
+        q.b2 = n.y * n.y * weight; q.bc = n.y * n.z * weight; q.bd = n.y * d * weight;
+        q.c2 = n.z * n.z * weight; q.cd = n.z * d * weight;
+        q.d2 = d * d * weight;
+        q.weight = weight;
+        return q;
+    }
+
+    Quadric &operator+=(const Quadric &o)
+    {
+        a2 += o.a2; ab += o.ab; ac += o.ac; ad += o.ad; b2 += o.b2; bc += o.bc; bd += o.bd;
+        c2 += o.c2; cd += o.cd; d2 += o.d2; weight += o.weight;
+        return *this;
+    }
+
+    double evaluate(const glm::vec3 &p) const
+    {
+        double x = p.x, y = p.y, z = p.z;
+        double error = a2 * x * x + 2 * ab * x * y + 2 * ac * x * z + 2 * ad * x
+            + b2 * y * y + 2 * bc * y * z + 2 * bd * y
+            + c2 * z * z + 2 * cd * z + d2;
+        return std::max(error, 0.0);
+    }
+};
+
+// fewer triangles of the same surface: at most targetIndexCount indices, unless that would
+// move it further than targetError (a distance, like the mesh's positions) from the input.
+// resultError (may be null) gets the largest error of a collapse made.
+inline vector<unsigned int> simplifyMesh(const vector<Vertex> &vertices, const vector<unsigned int> &indices,
+    size_t targetIndexCount, float targetError, float *resultError = nullptr)
+{
+    size_t vertexCount = vertices.size();
+    vector<unsigned int> result(indices.begin(), indices.begin() + indices.size() / 3 * 3);
+    if (resultError)
+        *resultError = 0.0f;
+
+    // vertices sharing a position form a group; identical ones in it are welded (the
+    // triangles use the first), and a group left with several different ones is a seam
+    vector<unsigned int> byPosition(vertexCount);
+    for (size_t v = 0; v < vertexCount; ++v)
+        byPosition[v] = (unsigned int)v;
+    std::sort(byPosition.begin(), byPosition.end(), [&](unsigned int a, unsigned int b)
+    {
+        const glm::vec3 &p = vertices[a].Position, &q = vertices[b].Position;
+        if (p != q)
+            return p.x != q.x ? p.x < q.x : p.y != q.y ? p.y < q.y : p.z < q.z;
+        int order = memcmp(&vertices[a], &vertices[b], sizeof(Vertex));
+        return order != 0 ? order < 0 : a < b;
+    });
+    vector<unsigned int> group(vertexCount), weld(vertexCount);
+    vector<unsigned int> groupSize;
+    for (size_t i = 0; i < vertexCount; ++i)
+    {
+        unsigned int v = byPosition[i];
+        if (i == 0 || vertices[v].Position != vertices[byPosition[i - 1]].Position)
+            groupSize.push_back(0);
+        group[v] = (unsigned int)groupSize.size() - 1;
+        if (i > 0 && groupSize.back() > 0 && memcmp(&vertices[v], &vertices[byPosition[i - 1]], sizeof(Vertex)) == 0)
+            weld[v] = weld[byPosition[i - 1]];
+        else
+        {
+            weld[v] = v;
+            ++groupSize.back();
+        }
+    }
+    for (size_t i = 0; i < result.size(); ++i)
+        result[i] = weld[result[i]];
+
+    // border (and non-manifold) edges: not shared by exactly two triangles of the surface
+    vector<bool> lockedGroup(groupSize.size(), false);
+    for (size_t g = 0; g < groupSize.size(); ++g)
+        lockedGroup[g] = groupSize[g] > 1;
+    {
+        std::unordered_map<uint64_t, unsigned int> edgeTriangles;
+        for (size_t i = 0; i < result.size(); i += 3)
+            for (int k = 0; k < 3; ++k)
+            {
+                unsigned int a = group[result[i + k]], b = group[result[i + (k + 1) % 3]];
+                if (a != b)
+                    ++edgeTriangles[(uint64_t)std::min(a, b) << 32 | std::max(a, b)];
+            }
+        for (std::unordered_map<uint64_t, unsigned int>::const_iterator e = edgeTriangles.begin(); e != edgeTriangles.end(); ++e)
+            if (e->second != 2)
+            {
+                lockedGroup[(unsigned int)(e->first >> 32)] = true;
+                lockedGroup[(unsigned int)e->first] = true;
+            }
+    }
+
+    // the planes of each vertex's triangles
+    vector<Quadric> quadrics(vertexCount);
+    for (size_t i = 0; i < result.size(); i += 3)
+    {
+        glm::dvec3 p0(vertices[result[i]].Position), p1(vertices[result[i + 1]].Position), p2(vertices[result[i + 2]].Position);
+        glm::dvec3 normal = glm::cross(p1 - p0, p2 - p0);
+        double length = glm::length(normal);
+        if (length == 0.0)
+            continue;
+        normal /= length;
+        Quadric q = Quadric::plane(normal, -glm::dot(normal, p0), length * 0.5);
+        for (int k = 0; k < 3; ++k)
+            quadrics[result[i + k]] += q;
+    }
+
+    struct Collapse
+    {
+        unsigned int from, to;
+        float error;    // root mean square distance to the planes merged into to
+    };
+    vector<unsigned int> remap(vertexCount);
+    vector<bool> touched(vertexCount);
+    vector<size_t> firstTriangle(vertexCount + 1);
+    vector<unsigned int> adjacency;
+    vector<Collapse> collapses;
+    while (result.size() > targetIndexCount)
+    {
+        // triangles of each vertex
+        std::fill(firstTriangle.begin(), firstTriangle.end(), 0);
+        for (size_t i = 0; i < result.size(); ++i)
+            ++firstTriangle[result[i] + 1];
+        for (size_t v = 0; v < vertexCount; ++v)
+            firstTriangle[v + 1] += firstTriangle[v];
+        adjacency.resize(result.size());
+        {
+            vector<size_t> fill(firstTriangle.begin(), firstTriangle.end() - 1);
+            for (size_t i = 0; i < result.size(); ++i)
+                adjacency[fill[result[i]]++] = (unsigned int)(i / 3);
+        }
+
+        // every edge, both ways, cheapest first
+        collapses.clear();
+        for (size_t i = 0; i < result.size(); i += 3)
+            for (int k = 0; k < 3; ++k)
+            {
+                unsigned int a = result[i + k], b = result[i + (k + 1) % 3];
+                for (int way = 0; way < 2; ++way, std::swap(a, b))
+                {
+                    if (lockedGroup[group[a]])
+                        continue;
+                    Quadric merged = quadrics[a];
+                    merged += quadrics[b];
+                    Collapse collapse = { a, b, 0.0f };
+                    if (merged.weight > 0.0)
+                        collapse.error = (float)std::sqrt(merged.evaluate(vertices[b].Position) / merged.weight);
+                    collapses.push_back(collapse);
+                }
+            }
+        std::sort(collapses.begin(), collapses.end(), [](const Collapse &x, const Collapse &y) { return x.error < y.error; });
+
+        for (size_t v = 0; v < vertexCount; ++v)
+            remap[v] = (unsigned int)v;
+        std::fill(touched.begin(), touched.end(), false);
+        size_t removedIndices = 0, collapsed = 0;
+        for (size_t c = 0; c < collapses.size() && result.size() - removedIndices > targetIndexCount; ++c)
+        {
+            const Collapse &collapse = collapses[c];
+            if (collapse.error > targetError)
+                break;
+            if (touched[collapse.from] || touched[collapse.to])
+                continue;
+
+            // the triangles that stay must keep their facing
+            const glm::vec3 &target = vertices[collapse.to].Position;
+            bool flips = false;
+            for (size_t a = firstTriangle[collapse.from]; a < firstTriangle[collapse.from + 1] && !flips; ++a)
+            {
+                const unsigned int *triangle = &result[adjacency[a] * 3];
+                if (triangle[0] == collapse.to || triangle[1] == collapse.to || triangle[2] == collapse.to)
+                    continue;
+                glm::vec3 before[3], after[3];
+                for (int k = 0; k < 3; ++k)
+                {
+                    before[k] = vertices[triangle[k]].Position;
+                    after[k] = triangle[k] == collapse.from ? target : before[k];
+                }
+                glm::vec3 n0 = glm::cross(before[1] - before[0], before[2] - before[0]);
+                glm::vec3 n1 = glm::cross(after[1] - after[0], after[2] - after[0]);
+                flips = glm::dot(n0, n1) <= 0.0f;
+            }
+            if (flips)
+                continue;
+
+            // lock the neighbourhood for the rest of the pass, so the test above stays true
+            for (size_t a = firstTriangle[collapse.from]; a < firstTriangle[collapse.from + 1]; ++a)
+            {
+                const unsigned int *triangle = &result[adjacency[a] * 3];
+                if (triangle[0] == collapse.to || triangle[1] == collapse.to || triangle[2] == collapse.to)
+                    removedIndices += 3;
+                for (int k = 0; k < 3; ++k)
+                    touched[triangle[k]] = true;
+            }
+            remap[collapse.from] = collapse.to;
+            quadrics[collapse.to] += quadrics[collapse.from];
+            if (resultError)
+                *resultError = std::max(*resultError, collapse.error);
+            ++collapsed;
+        }
+        if (!collapsed)
+            break;
+
+        // apply, dropping the triangles that collapsed
+        size_t write = 0;
+        for (size_t i = 0; i < result.size(); i += 3)
+        {
+            unsigned int a = remap[result[i]], b = remap[result[i + 1]], c = remap[result[i + 2]];
+            if (a == b || b == c || c == a)
+                continue;
+            result[write++] = a;
+            result[write++] = b;
+            result[write++] = c;
+        }
+        result.resize(write);
+    }
+    return result;
+}
+
+// at most this many levels, the full mesh included
+const unsigned int MESH_LOD_LEVELS = 5;
+// each level aims at this fraction of the triangles of the one before
+const float MESH_LOD_REDUCTION = 0.5f;
+// a level that keeps more than this fraction isn't worth its indices, the chain ends
+const float MESH_LOD_MIN_REDUCTION = 0.85f;
+// the error level 1 may have, relative to the mesh's extent; it doubles every level, as a
+// level is drawn at half the size on screen of the one before (see Model::SelectLod)
+const float MESH_LOD_ERROR = 0.01f;
+
+// the coarser levels (1, 2, ...) of a mesh, each simplified from the one before and
+// reordered for the vertex cache.
+inline vector<vector<unsigned int> > buildMeshLods(const vector<Vertex> &vertices, const vector<unsigned int> &indices)
+{
+    vector<vector<unsigned int> > lods;
+    if (vertices.empty() || indices.size() < 3)
+        return lods;
+    glm::vec3 lower = vertices[0].Position, upper = vertices[0].Position;
+    for (size_t v = 1; v < vertices.size(); ++v)
+    {
+        lower = glm::min(lower, vertices[v].Position);
+        upper = glm::max(upper, vertices[v].Position);
+    }
+    glm::vec3 size = upper - lower;
+    float extent = std::max(size.x, std::max(size.y, size.z));
+
+    const vector<unsigned int> *previous = &indices;
+    float errorLimit = MESH_LOD_ERROR * extent, error = 0.0f;
+    for (unsigned int level = 1; level < MESH_LOD_LEVELS; ++level, errorLimit *= 2.0f)
+    {
+        size_t target = (size_t)(previous->size() / 3 * MESH_LOD_REDUCTION) * 3;
+        float levelError = 0.0f;
+        vector<unsigned int> lod = simplifyMesh(vertices, *previous, target, errorLimit - error, &levelError);
+        if (lod.empty() || lod.size() > previous->size() * MESH_LOD_MIN_REDUCTION)
+            break;
+        error += levelError;
+        lods.push_back(optimizeVertexCache(lod, vertices.size()));
+        previous = &lods.back();
+    }
+    return lods;
+}
+#endif
@@ -3,24 +3,71 @@
 
 //#include <glad/glad.h>
 #include <glm/glm.hpp>
+#include "shader_source.h"
 
+#include <algorithm>
+#include <atomic>
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <cstring>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+// index of an active uniform in Shader::uniforms, from Shader::uniform(name).
+// -1 (an inactive or unknown name) turns the setters into no-ops, like location -1 does.
+typedef int UniformHandle;
+
+// an active default-block uniform found by reflection at link time. arrays get one
+// entry per element ("lights[0]", "lights[1]", ...), each with its own location.
+struct ShaderUniform
+{
+    std::string name;
+    GLint location;
+    GLenum type;
+    // last value uploaded through the setters, for skipping redundant uploads
+    float value[16];
+    bool uploaded;
+};
+
+// an active uniform block (std140 etc.), see Shader::bindBlock.
+struct ShaderUniformBlock
+{
+    std::string name;
+    GLuint index;
+    GLint dataSize;
+};
+
+// setter calls since the last resetStatistics(): uploads reached the driver, redundant
+// ones were skipped because the uniform already held the value, unknown ones named no
+// active uniform.
+struct ShaderUniformStats
+{
+    unsigned long uploads;
+    unsigned long redundant;
+    unsigned long unknown;
+};
+
+// when a program is compiled and linked: in the constructor (blocking, as always), or
+// only once build() is called, so the work can overlap other loading (see ready()).
+enum ShaderBuild { BUILD_NOW, BUILD_LATER };
 
 class Shader
 {
 public:
     unsigned int ID;
-    // constructor generates the shader on the fly
+    // constructor generates the shader on the fly. the sources may #include files of
+    // ShaderSourceMap::global() and get the defines injected (see shader_source.h); with
+    // shaderSpirvDirectory() set, the offline SPIR-V modules are used where they exist.
     // ------------------------------------------------------------------------
-    Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr)
+    Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr, ShaderBuild when = BUILD_NOW,
+        const ShaderDefines &defines = ShaderDefines())
+        : ID(0), vertexFile(vertexPath), fragmentFile(fragmentPath), geometryFile(geometryPath ? geometryPath : ""),
+          specialization(defines), hasGeometry(geometryPath != nullptr), built(false), linked(false)
     {
         // 1. retrieve the vertex/fragment source code from filePath
-        std::string vertexCode;
-        std::string fragmentCode;
-        std::string geometryCode;
         std::ifstream vShaderFile;
         std::ifstream fShaderFile;
         std::ifstream gShaderFile;
@@ -57,44 +104,162 @@ public:
         {
             std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
         }
-        const char* vShaderCode = vertexCode.c_str();
-        const char * fShaderCode = fragmentCode.c_str();
-        // 2. compile shaders
-        unsigned int vertex, fragment;
-        // vertex shader
-        vertex = glCreateShader(GL_VERTEX_SHADER);
-        glShaderSource(vertex, 1, &vShaderCode, NULL);
-        glCompileShader(vertex);
-        checkCompileErrors(vertex, "VERTEX");
-        // fragment Shader
-        fragment = glCreateShader(GL_FRAGMENT_SHADER);
-        glShaderSource(fragment, 1, &fShaderCode, NULL);
-        glCompileShader(fragment);
-        checkCompileErrors(fragment, "FRAGMENT");
-        // if geometry shader is given, compile geometry shader
-        unsigned int geometry;
-        if(geometryPath != nullptr)
-        {
-            const char * gShaderCode = geometryCode.c_str();
-            geometry = glCreateShader(GL_GEOMETRY_SHADER);
-            glShaderSource(geometry, 1, &gShaderCode, NULL);
-            glCompileShader(geometry);
-            checkCompileErrors(geometry, "GEOMETRY");
+        // expand the includes and specialize; the result identifies the program
+        preprocess(vertexCode, vertexPath, defines, "vertex");
+        preprocess(fragmentCode, fragmentPath, defines, "fragment");
+        if(hasGeometry)
+            preprocess(geometryCode, geometryPath, defines, "geometry");
+        if (when == BUILD_NOW)
+        {
+            build();
+            finish();
         }
-        // shader Program
+    }
+    // 2. compile shaders and link the program without asking for the results, so a driver
+    // with KHR_parallel_shader_compile carries on in the background. may run on another
+    // thread whose context shares objects with the one drawing; that thread passes
+    // flush = true so the program is complete before the drawing context looks at it.
+    // ------------------------------------------------------------------------
+    void build(bool flush = false)
+    {
         ID = glCreateProgram();
+        fromBinary = loadProgramBinary(ID, hash);
+        if (fromBinary)
+        {
+            if (flush)
+                glFinish();
+            built = true;
+            return;
+        }
+        fromSpirv = !spirvRejected && loadSpirv();
+        if (!fromSpirv)
+        {
+            const char* vShaderCode = vertexCode.c_str();
+            const char * fShaderCode = fragmentCode.c_str();
+            // vertex shader
+            vertex = glCreateShader(GL_VERTEX_SHADER);
+            glShaderSource(vertex, 1, &vShaderCode, NULL);
+            glCompileShader(vertex);
+            // fragment Shader
+            fragment = glCreateShader(GL_FRAGMENT_SHADER);
+            glShaderSource(fragment, 1, &fShaderCode, NULL);
+            glCompileShader(fragment);
+            // if geometry shader is given, compile geometry shader
+            if(hasGeometry)
+            {
+                const char * gShaderCode = geometryCode.c_str();
+                geometry = glCreateShader(GL_GEOMETRY_SHADER);
+                glShaderSource(geometry, 1, &gShaderCode, NULL);
+                glCompileShader(geometry);
+            }
+        }
+        // shader Program
         glAttachShader(ID, vertex);
         glAttachShader(ID, fragment);
-        if(geometryPath != nullptr)
+        if(hasGeometry)
             glAttachShader(ID, geometry);
+        if (shaderProgramCacheEnabled())
+            glProgramParameteri(ID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
         glLinkProgram(ID);
-        checkCompileErrors(ID, "PROGRAM");
-        // delete the shaders as they're linked into our program now and no longer necessery
-        glDeleteShader(vertex);
-        glDeleteShader(fragment);
-        if(geometryPath != nullptr)
-            glDeleteShader(geometry);
+        if (flush)
+            glFinish();
+        built = true;
+    }
+    // true once the program is linked and usable. the first time it is, the compile/link
+    // logs are checked and the uniforms reflected (on the calling, drawing thread). with
+    // KHR_parallel_shader_compile, or after a flushed build on another thread, this never
+    // blocks; otherwise it waits for the link like the constructor does.
+    // ------------------------------------------------------------------------
+    bool ready()
+    {
+        if (linked)
+            return true;
+        if (!built)
+            return false;
+        if (GLEW_KHR_parallel_shader_compile || GLEW_ARB_parallel_shader_compile)
+        {
+            GLint complete = GL_FALSE;
+            glGetProgramiv(ID, GL_COMPLETION_STATUS_KHR, &complete);
+            if (!complete)
+                return false;
+        }
+        finish();
+        return true;
+    }
+    // hash of the preprocessed sources (the program cache key) and the files they were
+    // assembled from, each stage's own file first.
+    // ------------------------------------------------------------------------
+    uint64_t sourceHash() const { return hash; }
+    const std::vector<std::string> &sourceFiles() const { return files; }
+    // true once ready() if the program linked; false before.
+    bool linkSucceeded() const { return linked && linkStatus; }
+    // hot reload: a new program from the same files and defines, read again and built
+    // later (hand it to the compiler, wait for its ready(), then adopt() it).
+    // ------------------------------------------------------------------------
+    std::unique_ptr<Shader> rebuilt() const
+    {
+        return std::unique_ptr<Shader>(new Shader(vertexFile.c_str(), fragmentFile.c_str(),
+            hasGeometry ? geometryFile.c_str() : nullptr, BUILD_LATER, specialization));
+    }
+    // replace this program by next (which must be ready) if next linked; otherwise keep
+    // it and drop next. handles stay valid: every uniform keeps its index, and the values
+    // set so far (samplers etc.) and the uniform block bindings are carried over.
+    // ------------------------------------------------------------------------
+    bool adopt(Shader &next)
+    {
+        if (!next.linkSucceeded())
+        {
+            glDeleteProgram(next.ID);
+            next.ID = 0;
+            return false;
+        }
+        GLint current = 0;
+        glGetIntegerv(GL_CURRENT_PROGRAM, &current);
+        glUseProgram(next.ID);
+        std::vector<ShaderUniform> merged = uniforms;
+        std::unordered_map<std::string, int> index = uniformIndex;
+        for (size_t i = 0; i < merged.size(); ++i)
+        {
+            UniformHandle handle = next.uniform(merged[i].name);
+            if (handle < 0)
+            {
+                merged[i].location = -1; // no longer active, the setters do nothing
+                continue;
+            }
+            const ShaderUniform &u = next.uniforms[handle];
+            if (u.type != merged[i].type)
+                merged[i].uploaded = false;
+            merged[i].location = u.location;
+            merged[i].type = u.type;
+            if (merged[i].uploaded)
+                upload(merged[i]);
+        }
+        for (size_t i = 0; i < next.uniforms.size(); ++i)
+            if (index.find(next.uniforms[i].name) == index.end())
+            {
+                index[next.uniforms[i].name] = (int)merged.size();
+                merged.push_back(next.uniforms[i]);
+            }
+        for (std::unordered_map<std::string, int>::const_iterator it = next.uniformIndex.begin(); it != next.uniformIndex.end(); ++it)
+            if (index.find(it->first) == index.end())
+                index[it->first] = index[next.uniforms[it->second].name];
+        for (size_t i = 0; i < blocks.size(); ++i)
+        {
+            GLint binding = 0;
+            glGetActiveUniformBlockiv(ID, blocks[i].index, GL_UNIFORM_BLOCK_BINDING, &binding);
+            next.bindBlock(blocks[i].name, (GLuint)binding);
+        }
+        glUseProgram(current == (GLint)ID ? next.ID : (GLuint)current);
 
+        glDeleteProgram(ID);
+        ID = next.ID;
+        next.ID = 0;
+        uniforms.swap(merged);
+        uniformIndex.swap(index);
+        blocks = next.blocks;
+        hash = next.hash;
+        files = next.files;
+        return true;
     }
     // activate the shader
     // ------------------------------------------------------------------------
@@ -102,66 +267,343 @@ public:
     { 
         glUseProgram(ID); 
     }
+    // uniform reflection
+    // ------------------------------------------------------------------------
+    // handle of an active uniform (a hash lookup, no driver call); resolve once and keep it.
+    UniformHandle uniform(const std::string &name) const
+    {
+        std::unordered_map<std::string, int>::const_iterator it = uniformIndex.find(name);
+        return it == uniformIndex.end() ? -1 : it->second;
+    }
+    // ------------------------------------------------------------------------
+    // bind the uniform block to a binding point; false if the program has no such block.
+    bool bindBlock(const std::string &name, GLuint binding) const
+    {
+        for (size_t i = 0; i < blocks.size(); ++i)
+            if (blocks[i].name == name)
+            {
+                glUniformBlockBinding(ID, blocks[i].index, binding);
+                return true;
+            }
+        return false;
+    }
+    // ------------------------------------------------------------------------
+    const std::vector<ShaderUniform> &activeUniforms() const { return uniforms; }
+    const std::vector<ShaderUniformBlock> &activeBlocks() const { return blocks; }
+    const ShaderUniformStats &statistics() const { return stats; }
+    void resetStatistics() { stats = ShaderUniformStats(); }
+    // handle based setters; the program must be in use, as with the named ones.
+    // ------------------------------------------------------------------------
+    void set(UniformHandle handle, bool value) const
+    {
+        set(handle, (int)value);
+    }
+    void set(UniformHandle handle, int value) const
+    {
+        if (changed(handle, &value, sizeof(value)))
+            glUniform1i(uniforms[handle].location, value);
+    }
+    void set(UniformHandle handle, float value) const
+    {
+        if (changed(handle, &value, sizeof(value)))
+            glUniform1f(uniforms[handle].location, value);
+    }
+    void set(UniformHandle handle, const glm::vec2 &value) const
+    {
+        if (changed(handle, &value[0], sizeof(value)))
+            glUniform2fv(uniforms[handle].location, 1, &value[0]);
+    }
+    void set(UniformHandle handle, const glm::vec3 &value) const
+    {
+        if (changed(handle, &value[0], sizeof(value)))
+            glUniform3fv(uniforms[handle].location, 1, &value[0]);
+    }
+    void set(UniformHandle handle, const glm::vec4 &value) const
+    {
+        if (changed(handle, &value[0], sizeof(value)))
+            glUniform4fv(uniforms[handle].location, 1, &value[0]);
+    }
+    void set(UniformHandle handle, const glm::mat2 &mat) const
+    {
+        if (changed(handle, &mat[0][0], sizeof(mat)))
+            glUniformMatrix2fv(uniforms[handle].location, 1, GL_FALSE, &mat[0][0]);
+    }
+    void set(UniformHandle handle, const glm::mat3 &mat) const
+    {
+        if (changed(handle, &mat[0][0], sizeof(mat)))
+            glUniformMatrix3fv(uniforms[handle].location, 1, GL_FALSE, &mat[0][0]);
+    }
+    void set(UniformHandle handle, const glm::mat4 &mat) const
+    {
+        if (changed(handle, &mat[0][0], sizeof(mat)))
+            glUniformMatrix4fv(uniforms[handle].location, 1, GL_FALSE, &mat[0][0]);
+    }
     // utility uniform functions
     // ------------------------------------------------------------------------
     void setBool(const std::string &name, bool value) const
     {         
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value); 
+        set(uniform(name), value);
     }
     // ------------------------------------------------------------------------
     void setInt(const std::string &name, int value) const
     { 
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), value); 
+        set(uniform(name), value);
     }
     // ------------------------------------------------------------------------
     void setFloat(const std::string &name, float value) const
     { 
-        glUniform1f(glGetUniformLocation(ID, name.c_str()), value); 
+        set(uniform(name), value);
     }
     // ------------------------------------------------------------------------
     void setVec2(const std::string &name, const glm::vec2 &value) const
     { 
-        glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        set(uniform(name), value);
     }
     void setVec2(const std::string &name, float x, float y) const
     { 
-        glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y); 
+        set(uniform(name), glm::vec2(x, y));
     }
     // ------------------------------------------------------------------------
     void setVec3(const std::string &name, const glm::vec3 &value) const
     { 
-        glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        set(uniform(name), value);
     }
     void setVec3(const std::string &name, float x, float y, float z) const
     { 
-        glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z); 
+        set(uniform(name), glm::vec3(x, y, z));
     }
     // ------------------------------------------------------------------------
     void setVec4(const std::string &name, const glm::vec4 &value) const
     { 
-        glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        set(uniform(name), value);
     }
     void setVec4(const std::string &name, float x, float y, float z, float w) 
     { 
-        glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w); 
+        set(uniform(name), glm::vec4(x, y, z, w));
     }
     // ------------------------------------------------------------------------
     void setMat2(const std::string &name, const glm::mat2 &mat) const
     {
-        glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        set(uniform(name), mat);
     }
     // ------------------------------------------------------------------------
     void setMat3(const std::string &name, const glm::mat3 &mat) const
     {
-        glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        set(uniform(name), mat);
     }
     // ------------------------------------------------------------------------
     void setMat4(const std::string &name, const glm::mat4 &mat) const
     {
-        glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        set(uniform(name), mat);
     }
 
 private:
+    std::string vertexCode;
+    std::string fragmentCode;
+    std::string geometryCode;
+    std::string vertexFile;
+    std::string fragmentFile;
+    std::string geometryFile;
+    ShaderDefines specialization;
+    bool hasGeometry;
+    uint64_t hash = FNV1A_OFFSET_BASIS;
+    std::vector<std::string> files;
+    unsigned int vertex = 0, fragment = 0, geometry = 0;
+    bool fromBinary = false;
+    // linked from the SPIR-V modules; rejected when the driver keeps no names for reflection
+    bool fromSpirv = false;
+    bool spirvRejected = false;
+    // set by build(), possibly on another thread; linked once finish() has run
+    std::atomic<bool> built;
+    bool linked;
+    bool linkStatus = false;
+    // the setters are const like before; the last values and counters are bookkeeping
+    mutable std::vector<ShaderUniform> uniforms;
+    std::vector<ShaderUniformBlock> blocks;
+    std::unordered_map<std::string, int> uniformIndex;
+    mutable ShaderUniformStats stats = ShaderUniformStats();
+
+    // run a stage through preprocessShader and fold it into hash and files.
+    // ------------------------------------------------------------------------
+    void preprocess(std::string &code, const char *path, const ShaderDefines &defines, const char *stage)
+    {
+        ShaderSource source = preprocessShader(code, path, defines);
+        code = source.code;
+        hash = fnv1aHash(stage, strlen(stage), hash);
+        hash = fnv1aHash(code.data(), code.size(), hash);
+        for (size_t i = 0; i < source.files.size(); ++i)
+            if (std::find(files.begin(), files.end(), source.files[i]) == files.end())
+                files.push_back(source.files[i]);
+    }
+    // check the logs, drop the shader objects and reflect the linked program.
+    // ------------------------------------------------------------------------
+    void finish()
+    {
+        if (!fromBinary)
+        {
+            checkCompileErrors(vertex, "VERTEX");
+            checkCompileErrors(fragment, "FRAGMENT");
+            if(hasGeometry)
+                checkCompileErrors(geometry, "GEOMETRY");
+            checkCompileErrors(ID, "PROGRAM");
+            // delete the shaders as they're linked into our program now and no longer necessery
+            glDeleteShader(vertex);
+            glDeleteShader(fragment);
+            if(hasGeometry)
+                glDeleteShader(geometry);
+        }
+        reflect();
+        if (fromSpirv && !reflectedByName())
+        {
+            // the setters go by name; without names in the module fall back to the GLSL
+            std::cout << "SPIR-V program of " << vertexFile << " has no uniform names, compiling the GLSL" << std::endl;
+            glDeleteProgram(ID);
+            uniforms.clear();
+            blocks.clear();
+            uniformIndex.clear();
+            spirvRejected = true;
+            build();
+            finish();
+            return;
+        }
+        GLint success;
+        glGetProgramiv(ID, GL_LINK_STATUS, &success);
+        linkStatus = success == GL_TRUE;
+        if (linkStatus && !fromBinary)
+            saveProgramBinary(ID, hash);
+        vertexCode.clear();
+        fragmentCode.clear();
+        geometryCode.clear();
+        linked = true;
+    }
+    // attach the offline SPIR-V modules of all stages, specialized with the defines; false
+    // (and nothing attached) if SPIR-V is off or a stage has no usable module.
+    // ------------------------------------------------------------------------
+    bool loadSpirv()
+    {
+        if (!shaderSpirvEnabled())
+            return false;
+        std::string vertexModule = shaderSpirvPath(vertexFile, files);
+        std::string fragmentModule = shaderSpirvPath(fragmentFile, files);
+        std::string geometryModule = hasGeometry ? shaderSpirvPath(geometryFile, files) : "";
+        if (vertexModule.empty() || fragmentModule.empty() || (hasGeometry && geometryModule.empty()))
+            return false;
+        vertex = loadSpirvShader(GL_VERTEX_SHADER, vertexModule, specialization);
+        fragment = vertex ? loadSpirvShader(GL_FRAGMENT_SHADER, fragmentModule, specialization) : 0;
+        geometry = fragment && hasGeometry ? loadSpirvShader(GL_GEOMETRY_SHADER, geometryModule, specialization) : 0;
+        if (!vertex || !fragment || (hasGeometry && !geometry))
+        {
+            glDeleteShader(vertex);
+            glDeleteShader(fragment);
+            glDeleteShader(geometry);
+            vertex = fragment = geometry = 0;
+            return false;
+        }
+        return true;
+    }
+    // every reflected uniform and block has a name (and the uniforms a location by it).
+    // ------------------------------------------------------------------------
+    bool reflectedByName() const
+    {
+        for (size_t i = 0; i < uniforms.size(); ++i)
+            if (uniforms[i].name.empty() || uniforms[i].location == -1)
+                return false;
+        for (size_t i = 0; i < blocks.size(); ++i)
+            if (blocks[i].name.empty())
+                return false;
+        return true;
+    }
+    // enumerate the active uniforms and uniform blocks of the linked program.
+    // ------------------------------------------------------------------------
+    void reflect()
+    {
+        GLint count = 0, maxLength = 0;
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+        std::vector<GLchar> name(maxLength + 1);
+        for (GLint i = 0; i < count; ++i)
+        {
+            GLint size = 0, block = -1;
+            GLenum type;
+            glGetActiveUniform(ID, (GLuint)i, (GLsizei)name.size(), NULL, &size, &type, &name[0]);
+            GLuint index = (GLuint)i;
+            glGetActiveUniformsiv(ID, 1, &index, GL_UNIFORM_BLOCK_INDEX, &block);
+            if (block != -1)
+                continue; // lives in a buffer, see blocks
+            std::string base = &name[0];
+            bool isArray = base.size() > 3 && base.compare(base.size() - 3, 3, "[0]") == 0;
+            if (isArray)
+                base.erase(base.size() - 3);
+            for (GLint element = 0; element < size; ++element)
+            {
+                ShaderUniform u;
+                u.name = isArray ? base + "[" + std::to_string(element) + "]" : base;
+                u.location = glGetUniformLocation(ID, u.name.c_str());
+                u.type = type;
+                u.uploaded = false;
+                uniformIndex[u.name] = (int)uniforms.size();
+                if (isArray && element == 0)
+                    uniformIndex[base] = (int)uniforms.size(); // "lights" names element 0, as in GL
+                uniforms.push_back(u);
+            }
+        }
+
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORM_BLOCKS, &count);
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORM_BLOCK_MAX_NAME_LENGTH, &maxLength);
+        name.assign(maxLength + 1, 0);
+        for (GLint i = 0; i < count; ++i)
+        {
+            ShaderUniformBlock b;
+            glGetActiveUniformBlockName(ID, (GLuint)i, (GLsizei)name.size(), NULL, &name[0]);
+            b.name = &name[0];
+            b.index = (GLuint)i;
+            glGetActiveUniformBlockiv(ID, (GLuint)i, GL_UNIFORM_BLOCK_DATA_SIZE, &b.dataSize);
+            blocks.push_back(b);
+        }
+    }
+    // send the last value set to the (new) program in use, see adopt().
+    // ------------------------------------------------------------------------
+    static void upload(const ShaderUniform &u)
+    {
+        switch (u.type)
+        {
+        case GL_FLOAT: glUniform1f(u.location, u.value[0]); break;
+        case GL_FLOAT_VEC2: glUniform2fv(u.location, 1, u.value); break;
+        case GL_FLOAT_VEC3: glUniform3fv(u.location, 1, u.value); break;
+        case GL_FLOAT_VEC4: glUniform4fv(u.location, 1, u.value); break;
+        case GL_FLOAT_MAT2: glUniformMatrix2fv(u.location, 1, GL_FALSE, u.value); break;
+        case GL_FLOAT_MAT3: glUniformMatrix3fv(u.location, 1, GL_FALSE, u.value); break;
+        case GL_FLOAT_MAT4: glUniformMatrix4fv(u.location, 1, GL_FALSE, u.value); break;
+        default:
+        {
+            // int, bool and the samplers, set through set(handle, int)
+            int value;
+            memcpy(&value, u.value, sizeof(value));
+            glUniform1i(u.location, value);
+        }
+        }
+    }
+    // count the set and tell whether it has to reach the driver.
+    // ------------------------------------------------------------------------
+    bool changed(UniformHandle handle, const void *value, size_t bytes) const
+    {
+        if (handle < 0)
+        {
+            ++stats.unknown;
+            return false;
+        }
+        ShaderUniform &u = uniforms[handle];
+        if (u.uploaded && memcmp(u.value, value, bytes) == 0)
+        {
+            ++stats.redundant;
+            return false;
+        }
+        memcpy(u.value, value, bytes);
+        u.uploaded = true;
+        ++stats.uploads;
+        return true;
+    }
+
     // utility function for checking shader compilation/linking errors.
     // ------------------------------------------------------------------------
     void checkCompileErrors(GLuint shader, std::string type)
@@ -0,0 +1,257 @@
+#ifndef COMPUTE_SHADER_H
+#define COMPUTE_SHADER_H
+
+#include "GL/glew.h"
+#include <glm/glm.hpp>
+#include "shader.h"
+
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+
+class ComputeShader
+{
+public:
+    unsigned int ID;
+    // constructor generates the compute shader on the fly (or loads its SPIR-V module, see Shader)
+    // ------------------------------------------------------------------------
+    ComputeShader(const char* computePath, ShaderBuild when = BUILD_NOW, const ShaderDefines &defines = ShaderDefines())
+        : ID(0), computeFile(computePath), specialization(defines), built(false), linked(false)
+    {
+        // 1. retrieve the compute source code from filePath
+        std::ifstream cShaderFile;
+        // ensure ifstream objects can throw exceptions:
+        cShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
+        try
+        {
+            // open file
+            cShaderFile.open(computePath);
+            std::stringstream cShaderStream;
+            // read file's buffer contents into stream
+            cShaderStream << cShaderFile.rdbuf();
+            // close file handler
+            cShaderFile.close();
+            // convert stream into string
+            computeCode = cShaderStream.str();
+        }
+        catch (std::ifstream::failure& e)
+        {
+            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ: " << e.what() << std::endl;
+        }
+        // includes and defines, see Shader
+        ShaderSource source = preprocessShader(computeCode, computePath, defines);
+        computeCode = source.code;
+        files = source.files;
+        hash = fnv1aHash("compute", strlen("compute"));
+        hash = fnv1aHash(computeCode.data(), computeCode.size(), hash);
+        if (when == BUILD_NOW)
+        {
+            build();
+            finish();
+        }
+    }
+    // 2. compile and link without waiting for the result; see Shader::build.
+    // ------------------------------------------------------------------------
+    void build(bool flush = false)
+    {
+        ID = glCreateProgram();
+        fromBinary = loadProgramBinary(ID, hash);
+        if (fromBinary)
+        {
+            if (flush)
+                glFinish();
+            built = true;
+            return;
+        }
+        std::string module = !spirvRejected && shaderSpirvEnabled() ? shaderSpirvPath(computeFile, files) : "";
+        compute = module.empty() ? 0 : loadSpirvShader(GL_COMPUTE_SHADER, module, specialization);
+        fromSpirv = compute != 0;
+        if (!fromSpirv)
+        {
+            const char* cShaderCode = computeCode.c_str();
+            compute = glCreateShader(GL_COMPUTE_SHADER);
+            glShaderSource(compute, 1, &cShaderCode, NULL);
+            glCompileShader(compute);
+        }
+        // shader Program
+        glAttachShader(ID, compute);
+        if (shaderProgramCacheEnabled())
+            glProgramParameteri(ID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        glLinkProgram(ID);
+        if (flush)
+            glFinish();
+        built = true;
+    }
+    // true once the program is linked; see Shader::ready.
+    // ------------------------------------------------------------------------
+    bool ready()
+    {
+        if (linked)
+            return true;
+        if (!built)
+            return false;
+        if (GLEW_KHR_parallel_shader_compile || GLEW_ARB_parallel_shader_compile)
+        {
+            GLint complete = GL_FALSE;
+            glGetProgramiv(ID, GL_COMPLETION_STATUS_KHR, &complete);
+            if (!complete)
+                return false;
+        }
+        finish();
+        return true;
+    }
+    uint64_t sourceHash() const { return hash; }
+    const std::vector<std::string> &sourceFiles() const { return files; }
+    bool linkSucceeded() const { return linked && linkStatus; }
+    // hot reload, see Shader::rebuilt and Shader::adopt. the setters go to the driver by
+    // name and keep no values, so the uniforms of an adopted program have to be set again.
+    // ------------------------------------------------------------------------
+    std::unique_ptr<ComputeShader> rebuilt() const
+    {
+        return std::unique_ptr<ComputeShader>(new ComputeShader(computeFile.c_str(), BUILD_LATER, specialization));
+    }
+    bool adopt(ComputeShader &next)
+    {
+        if (!next.linkSucceeded())
+        {
+            glDeleteProgram(next.ID);
+            next.ID = 0;
+            return false;
+        }
+        glDeleteProgram(ID);
+        ID = next.ID;
+        next.ID = 0;
+        hash = next.hash;
+        files = next.files;
+        return true;
+    }
+    // activate the shader
+    // ------------------------------------------------------------------------
+    void use()
+    {
+        glUseProgram(ID);
+    }
+    // utility uniform functions
+    // ------------------------------------------------------------------------
+    void setBool(const std::string &name, bool value) const
+    {
+        glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+    }
+    // ------------------------------------------------------------------------
+    void setInt(const std::string &name, int value) const
+    {
+        glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+    }
+    // ------------------------------------------------------------------------
+    void setFloat(const std::string &name, float value) const
+    {
+        glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+    }
+    // ------------------------------------------------------------------------
+    void setVec2(const std::string &name, const glm::vec2 &value) const
+    {
+        glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+    }
+    // ------------------------------------------------------------------------
+    void setVec3(const std::string &name, const glm::vec3 &value) const
+    {
+        glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+    }
+    // ------------------------------------------------------------------------
+    void setMat4(const std::string &name, const glm::mat4 &mat) const
+    {
+        glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+    }
+
+private:
+    std::string computeCode;
+    std::string computeFile;
+    ShaderDefines specialization;
+    uint64_t hash = 0;
+    std::vector<std::string> files;
+    unsigned int compute = 0;
+    bool fromBinary = false;
+    bool fromSpirv = false;
+    bool spirvRejected = false;
+    std::atomic<bool> built;
+    bool linked;
+    bool linkStatus = false;
+
+    void finish()
+    {
+        if (!fromBinary)
+        {
+            checkCompileErrors(compute, "COMPUTE");
+            checkCompileErrors(ID, "PROGRAM");
+            // delete the shader as it's linked into our program now and no longer necessery
+            glDeleteShader(compute);
+        }
+        if (fromSpirv && !uniformsByName())
+        {
+            // the setters look the uniforms up by name; fall back to the GLSL
+            std::cout << "SPIR-V program of " << computeFile << " has no uniform names, compiling the GLSL" << std::endl;
+            glDeleteProgram(ID);
+            spirvRejected = true;
+            build();
+            finish();
+            return;
+        }
+        GLint success;
+        glGetProgramiv(ID, GL_LINK_STATUS, &success);
+        linkStatus = success == GL_TRUE;
+        if (linkStatus && !fromBinary)
+            saveProgramBinary(ID, hash);
+        computeCode.clear();
+        linked = true;
+    }
+
+    // every active uniform has a name its location can be queried by.
+    bool uniformsByName() const
+    {
+        GLint count = 0, maxLength = 0;
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+        std::vector<GLchar> name(maxLength + 1);
+        for (GLint i = 0; i < count; ++i)
+        {
+            GLint size = 0;
+            GLenum type;
+            name[0] = 0;
+            glGetActiveUniform(ID, (GLuint)i, (GLsizei)name.size(), NULL, &size, &type, &name[0]);
+            if (name[0] == 0 || glGetUniformLocation(ID, &name[0]) == -1)
+                return false;
+        }
+        return true;
+    }
+
+    // utility function for checking shader compilation/linking errors.
+    // ------------------------------------------------------------------------
+    void checkCompileErrors(GLuint shader, std::string type)
+    {
+        GLint success;
+        GLchar infoLog[1024];
+        if(type != "PROGRAM")
+        {
+            glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+            if(!success)
+            {
+                glGetShaderInfoLog(shader, 1024, NULL, infoLog);
+                std::cout << "ERROR::SHADER_COMPILATION_ERROR of type: " << type << "\n" << infoLog << "\n -- --------------------------------------------------- -- " << std::endl;
+            }
+        }
+        else
+        {
+            glGetProgramiv(shader, GL_LINK_STATUS, &success);
+            if(!success)
+            {
+                glGetProgramInfoLog(shader, 1024, NULL, infoLog);
+                std::cout << "ERROR::PROGRAM_LINKING_ERROR of type: " << type << "\n" << infoLog << "\n -- --------------------------------------------------- -- " << std::endl;
+            }
+        }
+    }
+};
+#endif
@@ -0,0 +1,400 @@
+#ifndef SHADER_SOURCE_H
+#define SHADER_SOURCE_H
+
+#include <GL/glew.h>
+
+#include <learnopengl/hash.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <sys/stat.h>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// The files GLSL sources can #include, by name: shared code is registered once (from disk
+// or as a string) and every Shader built afterwards resolves
+//
+//     #include "brdf_common.glsl"
+//
+// against it. A file is inserted once per program even if included several times. Files
+// registered from disk keep their path, which the programs report as their source (for the
+// hot reload and the SPIR-V check), and are read again by reloadFile.
+class ShaderSourceMap
+{
+public:
+    // the map the Shader loaders use.
+    static ShaderSourceMap &global()
+    {
+        static ShaderSourceMap map;
+        return map;
+    }
+
+    void add(const std::string &name, const std::string &source)
+    {
+        files[name] = source;
+    }
+    // read path now and register it as name; false if the file can't be read.
+    bool addFile(const std::string &name, const std::string &path)
+    {
+        std::ifstream file(path.c_str());
+        if (!file)
+        {
+            std::cout << "ERROR::SHADER::INCLUDE_FILE_NOT_SUCCESFULLY_READ: " << path << std::endl;
+            return false;
+        }
+        std::stringstream stream;
+        stream << file.rdbuf();
+        files[name] = stream.str();
+        paths[name] = path;
+        return true;
+    }
+    // read the files registered from path again (after an edit); false if there are none
+    // or it can't be read, in which case the old text stays.
+    bool reloadFile(const std::string &path)
+    {
+        bool reloaded = false;
+        for (std::unordered_map<std::string, std::string>::const_iterator it = paths.begin(); it != paths.end(); ++it)
+            if (it->second == path)
+            {
+                std::string name = it->first;
+                reloaded = addFile(name, path) || reloaded;
+            }
+        return reloaded;
+    }
+    // the file on disk name was read from; name itself if it was added as a string.
+    std::string path(const std::string &name) const
+    {
+        std::unordered_map<std::string, std::string>::const_iterator it = paths.find(name);
+        return it == paths.end() ? name : it->second;
+    }
+    // nullptr if nothing is registered under name.
+    const std::string *find(const std::string &name) const
+    {
+        std::unordered_map<std::string, std::string>::const_iterator it = files.find(name);
+        return it == files.end() ? nullptr : &it->second;
+    }
+
+private:
+    std::unordered_map<std::string, std::string> files;
+    std::unordered_map<std::string, std::string> paths;    // of the ones read from disk
+};
+
+// Constants specialized per program (sample counts, array sizes, ...), injected as
+// #defines right after the #version line. The shaders keep a default for each:
+//
+//     #ifndef SAMPLE_COUNT
+//     #define SAMPLE_COUNT 256u
+//     #endif
+//
+// Numeric values also keep their 32-bit pattern, for the specialization constants of
+// SPIR-V modules (see loadSpirvShader).
+class ShaderDefines
+{
+public:
+    struct Value
+    {
+        std::string name;
+        std::string text;
+        uint32_t bits;
+        bool numeric;
+    };
+
+    ShaderDefines &set(const std::string &name, const std::string &value)
+    {
+        return set(name, value, 0, false);
+    }
+    ShaderDefines &set(const std::string &name, int value)
+    {
+        return set(name, std::to_string(value), (uint32_t)value, true);
+    }
+    // as an unsigned literal ("256u"), for uint loop counters
+    ShaderDefines &set(const std::string &name, unsigned int value)
+    {
+        return set(name, std::to_string(value) + "u", value, true);
+    }
+    // always with a decimal point, so it stays a float in GLSL
+    ShaderDefines &set(const std::string &name, float value)
+    {
+        char text[32];
+        snprintf(text, sizeof(text), "%.9g", value);
+        std::string s = text;
+        if (s.find_first_of(".eE") == std::string::npos)
+            s += ".0";
+        uint32_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        return set(name, s, bits, true);
+    }
+
+    bool empty() const { return values.empty(); }
+    const std::vector<Value> &all() const { return values; }
+    std::string text() const
+    {
+        std::string s;
+        for (size_t i = 0; i < values.size(); ++i)
+            s += "#define " + values[i].name + " " + values[i].text + "\n";
+        return s;
+    }
+
+private:
+    std::vector<Value> values;
+
+    ShaderDefines &set(const std::string &name, const std::string &text, uint32_t bits, bool numeric)
+    {
+        Value value = { name, text, bits, numeric };
+        for (size_t i = 0; i < values.size(); ++i)
+            if (values[i].name == name)
+            {
+                values[i] = value;
+                return *this;
+            }
+        values.push_back(value);
+        return *this;
+    }
+};
+
+// a GLSL source after preprocessShader, and every file it was assembled from (the
+// source itself first, then the includes in the order they were inserted, by their path
+// on disk, see ShaderSourceMap::path).
+struct ShaderSource
+{
+    std::string code;
+    std::vector<std::string> files;
+};
+
+// expand the #include "name" lines of source against the map and inject the defines after
+// #version. #line directives keep the compiler's line numbers pointing into the original
+// files; the source string number is the index into ShaderSource::files.
+inline void preprocessShaderInto(ShaderSource &out, const std::string &source, const std::string &name,
+    const ShaderSourceMap &map, const ShaderDefines *defines, std::unordered_set<std::string> &included)
+{
+    int fileIndex = (int)out.files.size();
+    out.files.push_back(name);
+    std::istringstream lines(source);
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(lines, line))
+    {
+        ++lineNumber;
+        size_t start = line.find_first_not_of(" \t");
+        if (start != std::string::npos && line.compare(start, 8, "#include") == 0)
+        {
+            size_t open = line.find_first_of("\"<", start + 8);
+            size_t close = open == std::string::npos ? open : line.find_first_of("\">", open + 1);
+            std::string includeName = close == std::string::npos ? "" : line.substr(open + 1, close - open - 1);
+            const std::string *includedSource = map.find(includeName);
+            if (!includedSource)
+            {
+                std::cout << "ERROR::SHADER::INCLUDE_NOT_FOUND: \"" << includeName << "\" in " << name << ":" << lineNumber << std::endl;
+                out.code += "// " + line + "\n";
+                continue;
+            }
+            if (included.insert(includeName).second)
+            {
+                out.code += "#line 1 " + std::to_string(out.files.size()) + "\n";
+                preprocessShaderInto(out, *includedSource, map.path(includeName), map, nullptr, included);
+                out.code += "#line " + std::to_string(lineNumber + 1) + " " + std::to_string(fileIndex) + "\n";
+            }
+            else
+                out.code += "\n";
+            continue;
+        }
+        out.code += line + "\n";
+        if (defines && !defines->empty() && start != std::string::npos && line.compare(start, 8, "#version") == 0)
+        {
+            out.code += defines->text();
+            out.code += "#line " + std::to_string(lineNumber + 1) + " " + std::to_string(fileIndex) + "\n";
+        }
+    }
+}
+
+inline ShaderSource preprocessShader(const std::string &source, const std::string &name,
+    const ShaderDefines &defines = ShaderDefines(), const ShaderSourceMap &map = ShaderSourceMap::global())
+{
+    ShaderSource out;
+    std::unordered_set<std::string> included;
+    preprocessShaderInto(out, source, name, map, &defines, included);
+    return out;
+}
+
+// Linked program binaries (ARB_get_program_binary, core in 4.1), named by the hash of the
+// preprocessed sources and the driver, so a change to any included file or define is a
+// new entry. the directory is empty, i.e. the cache off, until the application sets it.
+inline std::string &shaderProgramCacheDirectory()
+{
+    static std::string directory;
+    return directory;
+}
+
+inline std::string shaderProgramCachePath(uint64_t sourceHash)
+{
+    const GLenum names[3] = { GL_VENDOR, GL_RENDERER, GL_VERSION };
+    uint64_t hash = sourceHash;
+    for (int i = 0; i < 3; ++i)
+    {
+        const char *value = (const char *)glGetString(names[i]);
+        if (value)
+            hash = fnv1aHash(value, strlen(value), hash);
+    }
+    char name[40];
+    snprintf(name, sizeof(name), "/program_%016llx.bin", (unsigned long long)hash);
+    return shaderProgramCacheDirectory() + name;
+}
+
+inline bool shaderProgramCacheEnabled()
+{
+    return !shaderProgramCacheDirectory().empty() && (GLEW_VERSION_4_1 || GLEW_ARB_get_program_binary);
+}
+
+// load a cached binary into program; false (program untouched but unlinked) on a miss or
+// when the driver rejects the binary, after which the program is compiled as usual.
+inline bool loadProgramBinary(GLuint program, uint64_t sourceHash)
+{
+    if (!shaderProgramCacheEnabled())
+        return false;
+    FILE *file = fopen(shaderProgramCachePath(sourceHash).c_str(), "rb");
+    if (!file)
+        return false;
+    GLenum format = 0;
+    std::vector<char> binary;
+    bool ok = fread(&format, sizeof(format), 1, file) == 1 && fseek(file, 0, SEEK_END) == 0;
+    long size = ok ? ftell(file) - (long)sizeof(format) : 0;
+    if (ok && size > 0)
+    {
+        binary.resize(size);
+        ok = fseek(file, sizeof(format), SEEK_SET) == 0 && fread(&binary[0], 1, binary.size(), file) == binary.size();
+    }
+    fclose(file);
+    if (!ok || binary.empty())
+        return false;
+    glProgramBinary(program, format, &binary[0], (GLsizei)binary.size());
+    GLint linked = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    return linked == GL_TRUE;
+}
+
+// store the linked program (built with GL_PROGRAM_BINARY_RETRIEVABLE_HINT).
+inline void saveProgramBinary(GLuint program, uint64_t sourceHash)
+{
+    if (!shaderProgramCacheEnabled())
+        return;
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0)
+        return;
+    std::vector<char> binary(length);
+    GLenum format = 0;
+    glGetProgramBinary(program, length, NULL, &format, &binary[0]);
+    std::string path = shaderProgramCachePath(sourceHash);
+    FILE *file = fopen(path.c_str(), "wb");
+    bool ok = file && fwrite(&format, sizeof(format), 1, file) == 1 && fwrite(&binary[0], 1, binary.size(), file) == binary.size();
+    if (file)
+        fclose(file);
+    if (!ok)
+        std::cout << "Failed to write program cache file " << path << std::endl;
+}
+// SPIR-V modules compiled offline (the SpirvShaders target of the project writes
+// <directory>/<stage file name>.spv), loaded through ARB_gl_spirv instead of compiling
+// the GLSL. the directory is empty, i.e. SPIR-V off, until the application sets it.
+inline std::string &shaderSpirvDirectory()
+{
+    static std::string directory;
+    return directory;
+}
+
+// constant_id of the specialization constants the shaders declare for their SPIR-V build
+//
+//     #ifdef GL_SPIRV
+//     layout (constant_id = 0) const uint SAMPLE_COUNT = 256u;
+//     #elif !defined(SAMPLE_COUNT)
+//     #define SAMPLE_COUNT 256u
+//     #endif
+//
+// by name, so a ShaderDefines value reaches a module as the same constant it sets in GLSL.
+inline std::unordered_map<std::string, GLuint> &shaderConstantIds()
+{
+    static std::unordered_map<std::string, GLuint> ids;
+    return ids;
+}
+
+inline bool shaderSpirvEnabled()
+{
+    return !shaderSpirvDirectory().empty() && (GLEW_VERSION_4_6 || GLEW_ARB_gl_spirv);
+}
+
+// the module of a stage source file; empty if there is none or it is older than the
+// GLSL or any of sources (the files the program was preprocessed from, includes too), i.e.
+// not rebuilt since the last edit.
+inline std::string shaderSpirvPath(const std::string &sourcePath, const std::vector<std::string> &sources)
+{
+    std::string path = shaderSpirvDirectory() + "/" + sourcePath.substr(sourcePath.find_last_of("/\\") + 1) + ".spv";
+    struct stat spirv, source;
+    if (stat(path.c_str(), &spirv) != 0)
+        return "";
+    for (size_t i = 0; i <= sources.size(); ++i)
+    {
+        const std::string &file = i < sources.size() ? sources[i] : sourcePath;
+        if (stat(file.c_str(), &source) == 0 && source.st_mtime > spirv.st_mtime)
+        {
+            std::cout << path << " is older than " << file << ", compiling the GLSL" << std::endl;
+            return "";
+        }
+    }
+    return path;
+}
+
+// a shader object of the given type from a SPIR-V module, specialized with the defines
+// that name a constant in shaderConstantIds(). 0 if the module can't be read or doesn't
+// specialize. defines without a constant_id are fixed when the module is compiled, so
+// they have to keep the values the build target used (the shader defaults).
+inline GLuint loadSpirvShader(GLenum type, const std::string &path, const ShaderDefines &defines)
+{
+    std::vector<char> module;
+    FILE *file = fopen(path.c_str(), "rb");
+    if (!file)
+        return 0;
+    char buffer[4096];
+    size_t read;
+    while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0)
+        module.insert(module.end(), buffer, buffer + read);
+    fclose(file);
+    if (module.empty() || module.size() % 4 != 0)
+        return 0;
+
+    std::vector<GLuint> ids, values;
+    for (size_t i = 0; i < defines.all().size(); ++i)
+    {
+        const ShaderDefines::Value &value = defines.all()[i];
+        std::unordered_map<std::string, GLuint>::const_iterator id = shaderConstantIds().find(value.name);
+        if (id == shaderConstantIds().end())
+            continue;
+        if (!value.numeric)
+        {
+            std::cout << "ERROR::SHADER::SPIRV_CONSTANT_NOT_NUMERIC: " << value.name << std::endl;
+            return 0;
+        }
+        ids.push_back(id->second);
+        values.push_back(value.bits);
+    }
+
+    GLuint shader = glCreateShader(type);
+    glShaderBinary(1, &shader, GL_SHADER_BINARY_FORMAT_SPIR_V_ARB, &module[0], (GLsizei)module.size());
+    (GLEW_VERSION_4_6 ? glSpecializeShader : glSpecializeShaderARB)(shader, "main", (GLuint)ids.size(), ids.empty() ? NULL : &ids[0], values.empty() ? NULL : &values[0]);
+    GLint specialized = GL_FALSE;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &specialized);
+    if (!specialized)
+    {
+        GLchar infoLog[1024];
+        glGetShaderInfoLog(shader, 1024, NULL, infoLog);
+        std::cout << "ERROR::SHADER::SPIRV_SPECIALIZATION_ERROR: " << path << "\n" << infoLog << std::endl;
+        glDeleteShader(shader);
+        return 0;
+    }
+    return shader;
+}
+#endif
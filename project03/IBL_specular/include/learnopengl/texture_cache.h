@@ -0,0 +1,146 @@
+#ifndef TEXTURE_CACHE_H
+#define TEXTURE_CACHE_H
+
+#include <GL/glew.h>
+
+#include <cctype>
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// The textures of all models in the process, each decoded and uploaded once: found by the
+// canonical path of the file (canonicalTexturePath) and, for a path seen the first time,
+// by the hash of the file's contents (meshCacheHashFile), so copies of a file under other
+// names share it too. Every model holds a reference per texture it uses (acquire/insert)
+// and drops it when destroyed (release); textures nobody references are deleted by
+// collect(), which the application calls on the GL thread (releasing can happen after
+// the context is gone). All calls on the GL thread.
+class TextureCache
+{
+public:
+    static TextureCache &global()
+    {
+        static TextureCache cache;
+        return cache;
+    }
+
+    // the texture of the file at path (canonical) with a reference added, 0 if not loaded.
+    unsigned int acquire(const std::string &path)
+    {
+        std::unordered_map<std::string, unsigned int>::const_iterator found = byPath.find(path);
+        if (found == byPath.end())
+            return 0;
+        return addReference(found->second);
+    }
+
+    // the texture with these contents with a reference added, 0 if none; it is found
+    // under path from now on.
+    unsigned int acquire(uint64_t contentHash, const std::string &path)
+    {
+        std::unordered_map<uint64_t, unsigned int>::const_iterator found = byContent.find(contentHash);
+        if (found == byContent.end())
+            return 0;
+        addPath(found->second, path);
+        return addReference(found->second);
+    }
+
+    // a newly uploaded texture, with one reference, taking bytes of video memory. without
+    // contents (hashed false, the file couldn't be read) it is only found by its path.
+    void insert(const std::string &path, bool hashed, uint64_t contentHash, unsigned int texture, size_t bytes = 0)
+    {
+        Entry &entry = entries[texture];
+        entry.references = 1;
+        entry.hashed = hashed;
+        entry.contentHash = contentHash;
+        entry.bytes = bytes;
+        if (hashed)
+            byContent[contentHash] = texture;
+        addPath(texture, path);
+    }
+
+    void release(unsigned int texture)
+    {
+        std::unordered_map<unsigned int, Entry>::iterator found = entries.find(texture);
+        if (found != entries.end() && found->second.references > 0 && --found->second.references == 0)
+            unused.push_back(texture);
+    }
+
+    // deletes the textures no one references any more.
+    void collect()
+    {
+        for (size_t i = 0; i < unused.size(); ++i)
+        {
+            std::unordered_map<unsigned int, Entry>::iterator found = entries.find(unused[i]);
+            if (found == entries.end() || found->second.references > 0)
+                continue; // acquired again since
+            for (size_t p = 0; p < found->second.paths.size(); ++p)
+                byPath.erase(found->second.paths[p]);
+            if (found->second.hashed)
+                byContent.erase(found->second.contentHash);
+            entries.erase(found);
+            glDeleteTextures(1, &unused[i]);
+        }
+        unused.clear();
+    }
+
+    size_t textureCount() const { return entries.size(); }
+
+    // video memory of a texture, as given to insert
+    size_t textureBytes(unsigned int texture) const
+    {
+        std::unordered_map<unsigned int, Entry>::const_iterator found = entries.find(texture);
+        return found == entries.end() ? 0 : found->second.bytes;
+    }
+
+private:
+    struct Entry
+    {
+        unsigned int references = 0;
+        bool hashed = false;
+        uint64_t contentHash = 0;
+        size_t bytes = 0;
+        std::vector<std::string> paths;
+    };
+
+    std::unordered_map<std::string, unsigned int> byPath;
+    std::unordered_map<uint64_t, unsigned int> byContent;
+    std::unordered_map<unsigned int, Entry> entries;
+    std::vector<unsigned int> unused;
+
+    unsigned int addReference(unsigned int texture)
+    {
+        ++entries[texture].references;
+        return texture;
+    }
+
+    void addPath(unsigned int texture, const std::string &path)
+    {
+        if (byPath.insert(std::make_pair(path, texture)).second)
+            entries[texture].paths.push_back(path);
+    }
+};
+
+// path made absolute and normalized, so different spellings of a file compare equal
+// (and, on Windows, lower case); the path as it is if that fails.
+inline std::string canonicalTexturePath(const std::string &path)
+{
+    std::string canonical = path;
+#ifdef _WIN32
+    char full[_MAX_PATH];
+    if (_fullpath(full, path.c_str(), _MAX_PATH))
+        canonical = full;
+    for (size_t i = 0; i < canonical.size(); ++i)
+        canonical[i] = canonical[i] == '\\' ? '/' : (char)tolower((unsigned char)canonical[i]);
+#else
+    char *real = realpath(path.c_str(), NULL);
+    if (real)
+    {
+        canonical = real;
+        free(real);
+    }
+#endif
+    return canonical;
+}
+#endif
@@ -0,0 +1,157 @@
+#ifndef TEXTURE_LOADER_H
+#define TEXTURE_LOADER_H
+
+#include <GL/glew.h>
+// not twice: the includer may have STB_IMAGE_IMPLEMENTATION defined
+#ifndef STBI_INCLUDE_STB_IMAGE_H
+#include <stb_image.h>
+#endif
+
+#include <learnopengl/parallel.h>
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Texture files decoded on any thread and uploaded on the GL thread through a pixel
+// buffer, so the decoding of many textures runs in parallel and the copies to the driver
+// don't block on each glTexImage2D:
+//
+//     vector<TextureImage> images(files.size());
+//     parallel_for(0, n, [&](int i) { images[i].decode(files[i]); });
+//     vector<unsigned int> textures = uploadTextureImages(images);
+struct TextureImage
+{
+    std::string path;
+    unsigned char *data = nullptr;
+    int width = 0;
+    int height = 0;
+    int components = 0;
+
+    // thread safe; false (and no data) if the file can't be read
+    bool decode(const std::string &file)
+    {
+        path = file;
+        data = stbi_load(file.c_str(), &width, &height, &components, 0);
+        return data != nullptr;
+    }
+
+    size_t bytes() const { return data ? (size_t)width * height * components : 0; }
+
+    void release()
+    {
+        stbi_image_free(data);
+        data = nullptr;
+    }
+};
+
+// the pixel buffer an upload goes through holds at most this much (or the largest image)
+const size_t TEXTURE_UPLOAD_BUFFER_BYTES = 64 << 20;
+
+inline GLenum textureImageFormat(int components)
+{
+    if (components == 1)
+        return GL_RED;
+    if (components == 2)
+        return GL_RG;
+    if (components == 3)
+        return GL_RGB;
+    return GL_RGBA;
+}
+
+// creates a mipmapped, repeating 2D texture of each image (an empty one if it failed to
+// decode) and frees the images. Batches of images are copied into the mapped pixel
+// buffer on all cores, then the textures are specified from it.
+inline std::vector<unsigned int> uploadTextureImages(std::vector<TextureImage> &images)
+{
+    std::vector<unsigned int> textures(images.size(), 0);
+    if (images.empty())
+        return textures;
+    glGenTextures((GLsizei)textures.size(), &textures[0]);
+
+    size_t total = 0, largest = 0;
+    for (size_t i = 0; i < images.size(); ++i)
+    {
+        total += images[i].bytes();
+        largest = std::max(largest, images[i].bytes());
+        if (!images[i].data)
+            std::cout << "Texture failed to load at path: " << images[i].path << std::endl;
+    }
+    size_t capacity = std::min(total, std::max(TEXTURE_UPLOAD_BUFFER_BYTES, largest));
+
+    // rows are tightly packed (stb_image), not 4 byte aligned
+    GLint alignment;
+    glGetIntegerv(GL_UNPACK_ALIGNMENT, &alignment);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    unsigned int pixelBuffer = 0;
+    if (capacity)
+    {
+        glGenBuffers(1, &pixelBuffer);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pixelBuffer);
+    }
+
+    std::vector<size_t> offsets(images.size(), 0);
+    for (size_t first = 0; first < images.size(); )
+    {
+        size_t end = first, bytes = 0;
+        while (end < images.size() && (end == first || bytes + images[end].bytes() <= capacity))
+        {
+            offsets[end] = bytes;
+            bytes += images[end].bytes();
+            ++end;
+        }
+
+        // a new store each batch, so the driver never waits for the previous one
+        unsigned char *mapped = nullptr;
+        if (bytes)
+        {
+            glBufferData(GL_PIXEL_UNPACK_BUFFER, capacity, NULL, GL_STREAM_DRAW);
+            mapped = (unsigned char *)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, bytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+            if (mapped)
+            {
+                parallel_for((int)first, (int)end, [&](int i)
+                {
+                    if (images[i].data)
+                        memcpy(mapped + offsets[i], images[i].data, images[i].bytes());
+                });
+                if (!glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER))
+                    mapped = nullptr; // the store was lost, specify from the images
+            }
+            if (!mapped)
+                glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        }
+
+        for (size_t i = first; i < end; ++i)
+        {
+            TextureImage &image = images[i];
+            glBindTexture(GL_TEXTURE_2D, textures[i]);
+            if (image.data)
+            {
+                GLenum format = textureImageFormat(image.components);
+                const void *pixels = mapped ? (const void *)offsets[i] : (const void *)image.data;
+                glTexImage2D(GL_TEXTURE_2D, 0, format, image.width, image.height, 0, format, GL_UNSIGNED_BYTE, pixels);
+                glGenerateMipmap(GL_TEXTURE_2D);
+            }
+
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            image.release();
+        }
+        if (pixelBuffer)
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pixelBuffer);
+        first = end;
+    }
+
+    if (pixelBuffer)
+    {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        glDeleteBuffers(1, &pixelBuffer);
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, alignment);
+    return textures;
+}
+#endif
@@ -3,10 +3,16 @@ out vec4 FragColor;
 in vec3 WorldPos;
 
 uniform samplerCube environmentMap;
+uniform bool linearOutput; // no tonemapping/gamma, HDR output for the probe captures
 
 void main()
 {		
     vec3 envColor = textureLod(environmentMap, WorldPos, 0.0).rgb;
+    if(linearOutput)
+    {
+        FragColor = vec4(envColor, 1.0);
+        return;
+    }
     
     // HDR tonemap and gamma correct
     envColor = envColor / (envColor + vec3(1.0));
@@ -1,8 +1,10 @@
 #version 330 core
+#ifdef GL_SPIRV
+#extension GL_GOOGLE_include_directive : require
+#endif
 layout (location = 0) in vec3 aPos;
 
-uniform mat4 projection;
-uniform mat4 view;
+#include "2.2.1.frame_uniforms.glsl"
 
 out vec3 WorldPos;
 
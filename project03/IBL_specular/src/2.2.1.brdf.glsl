@@ -0,0 +1,101 @@
+// GGX microfacet and sampling functions shared by 2.2.1.pbr.fs, the pre-filter and
+// irradiance bakes and 2.2.1.brdf.fs; registered as "2.2.1.brdf.glsl" (learnopengl/shader_source.h),
+// the name glslangValidator resolves next to the includer for the SPIR-V build.
+// The including shader declares the #version.
+
+const float PI = 3.14159265359;
+// ----------------------------------------------------------------------------
+// Լ
+// ̼ halfway Ϳ 󸶳 ĵǾ ִ Ÿ Լ
+// Normal  distribution function
+float DistributionGGX(float NdotH, float roughness)
+{
+    float a = roughness*roughness;
+    float a2 = a*a;
+    float NdotH2 = NdotH*NdotH;
+
+    float nom   = a2;
+    float denom = (NdotH2 * (a2 - 1.0) + 1.0);
+    denom = PI * denom * denom;
+
+    return nom / denom;
+}
+float DistributionGGX(vec3 N, vec3 H, float roughness)
+{
+    return DistributionGGX(max(dot(N, H), 0.0), roughness);
+}
+// ----------------------------------------------------------------------------
+// k of the Schlick-GGX geometry term: remapped for analytic lights, roughness^2 / 2 for IBL
+float GeometryKDirect(float roughness)
+{
+    float r = (roughness + 1.0);
+    return (r*r) / 8.0;
+}
+float GeometryKIBL(float roughness)
+{
+    return (roughness * roughness) / 2.0;
+}
+// ----------------------------------------------------------------------------
+// ̼ ģ  ߻ϴ self-shadow 
+float GeometrySchlickGGX(float NdotV, float k)
+{
+    float nom   = NdotV;
+    float denom = NdotV * (1.0 - k) + k;
+
+    return nom / denom;
+}
+// ----------------------------------------------------------------------------
+//    ü  θ  geometry function
+// geometry function
+float GeometrySmith(vec3 N, vec3 V, vec3 L, float k)
+{
+    float NdotV = max(dot(N, V), 0.0);
+    float NdotL = max(dot(N, L), 0.0);
+    float ggx2 = GeometrySchlickGGX(NdotV, k);
+    float ggx1 = GeometrySchlickGGX(NdotL, k);
+
+    return ggx1 * ggx2;
+}
+// ----------------------------------------------------------------------------
+// http://holger.dammertz.org/stuff/notes_HammersleyOnHemisphere.html
+// efficient VanDerCorpus calculation.
+float RadicalInverse_VdC(uint bits) 
+{
+     bits = (bits << 16u) | (bits >> 16u);
+     bits = ((bits & 0x55555555u) << 1u) | ((bits & 0xAAAAAAAAu) >> 1u);
+     bits = ((bits & 0x33333333u) << 2u) | ((bits & 0xCCCCCCCCu) >> 2u);
+     bits = ((bits & 0x0F0F0F0Fu) << 4u) | ((bits & 0xF0F0F0F0u) >> 4u);
+     bits = ((bits & 0x00FF00FFu) << 8u) | ((bits & 0xFF00FF00u) >> 8u);
+     return float(bits) * 2.3283064365386963e-10; // / 0x100000000
+}
+// ----------------------------------------------------------------------------
+vec2 Hammersley(uint i, uint N)
+{
+	return vec2(float(i)/float(N), RadicalInverse_VdC(i));
+}
+// ----------------------------------------------------------------------------
+// tangent space (N = +Z) variant of ImportanceSampleGGX.
+vec3 ImportanceSampleGGXTangent(vec2 Xi, float roughness)
+{
+	float a = roughness*roughness;
+	
+	float phi = 2.0 * PI * Xi.x;
+	float cosTheta = sqrt((1.0 - Xi.y) / (1.0 + (a*a - 1.0) * Xi.y));
+	float sinTheta = sqrt(1.0 - cosTheta*cosTheta);
+	
+	return vec3(cos(phi) * sinTheta, sin(phi) * sinTheta, cosTheta);
+}
+// ----------------------------------------------------------------------------
+vec3 ImportanceSampleGGX(vec2 Xi, vec3 N, float roughness)
+{
+	// from spherical coordinates to cartesian coordinates - halfway vector
+	vec3 H = ImportanceSampleGGXTangent(Xi, roughness);
+	
+	// from tangent-space H vector to world-space sample vector
+	vec3 up          = abs(N.z) < 0.999 ? vec3(0.0, 0.0, 1.0) : vec3(1.0, 0.0, 0.0);
+	vec3 tangent   = normalize(cross(up, N));
+	vec3 bitangent = cross(N, tangent);
+	
+	vec3 sampleVec = tangent * H.x + bitangent * H.y + N * H.z;
+	return normalize(sampleVec);
+}
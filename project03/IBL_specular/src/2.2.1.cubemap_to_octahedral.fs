@@ -0,0 +1,26 @@
+#version 330 core
+out vec4 FragColor;
+in vec2 TexCoords;
+
+uniform samplerCube environmentMap;
+uniform float mipLevel;
+
+// ----------------------------------------------------------------------------
+// inverse of OctahedralEncode in 2.2.1.pbr.fs (+Z hemisphere in the inner diamond).
+vec3 OctahedralDecode(vec2 uv)
+{
+    vec2 p = uv * 2.0 - 1.0;
+    vec3 n = vec3(p, 1.0 - abs(p.x) - abs(p.y));
+    if(n.z < 0.0)
+    {
+        vec2 s = vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+        n.xy = (1.0 - abs(n.yx)) * s;
+    }
+    return normalize(n);
+}
+// ----------------------------------------------------------------------------
+void main()
+{
+    vec3 N = OctahedralDecode(TexCoords);
+    FragColor = vec4(textureLod(environmentMap, N, mipLevel).rgb, 1.0);
+}
@@ -0,0 +1,24 @@
+#version 430 core
+#ifdef GL_SPIRV
+#extension GL_GOOGLE_include_directive : require
+#endif
+layout (local_size_x = 8, local_size_y = 8, local_size_z = 1) in;
+
+// one dispatch per mip level, writing the level from the one above through the sampler;
+// faceOffset + gl_GlobalInvocationID.z selects the cubemap face.
+layout (rgba16f, binding = 0) uniform writeonly imageCube cubemap;
+
+uniform int faceSize;   // size of the level being written
+uniform int faceOffset; // first face of this dispatch
+
+#include "2.2.1.downsample.glsl"
+
+// ----------------------------------------------------------------------------
+void main()
+{
+    ivec3 texel = ivec3(gl_GlobalInvocationID) + ivec3(0, 0, faceOffset);
+    if(texel.x >= faceSize || texel.y >= faceSize)
+        return;
+
+    imageStore(cubemap, texel, vec4(Downsample(texel.z, texel.xy, faceSize), 1.0));
+}
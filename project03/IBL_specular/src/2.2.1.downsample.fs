@@ -0,0 +1,18 @@
+#version 330 core
+#ifdef GL_SPIRV
+#extension GL_GOOGLE_include_directive : require
+#endif
+out vec4 FragColor;
+in vec3 WorldPos;
+
+// writes one mip level of environmentMap from the one above (see ibl_baker.h)
+uniform int face;     // cubemap face being rendered
+uniform int faceSize; // size of the level being written
+
+#include "2.2.1.downsample.glsl"
+
+// ----------------------------------------------------------------------------
+void main()
+{
+    FragColor = vec4(Downsample(face, ivec2(gl_FragCoord.xy), faceSize), 1.0);
+}
@@ -0,0 +1,46 @@
+// The mip downsample of a cubemap shared by 2.2.1.downsample.fs and .cs (see ibl_baker.h);
+// registered as "2.2.1.downsample.glsl" like 2.2.1.brdf.glsl. The including shader
+// declares the #version.
+
+// the level range of environmentMap is limited to the source level meanwhile
+uniform samplerCube environmentMap;
+uniform float sourceLevel;
+
+// ----------------------------------------------------------------------------
+// direction of the point st in [-1,1]^2 of a face (any st, also off the face), in the
+// GL face orientation; unnormalized, so |dir|^2 = 1 + s^2 + t^2.
+vec3 FaceDirection(int face, vec2 st)
+{
+    if(face == 0)      return vec3( 1.0, -st.y, -st.x);
+    else if(face == 1) return vec3(-1.0, -st.y,  st.x);
+    else if(face == 2) return vec3( st.x,  1.0,  st.y);
+    else if(face == 3) return vec3( st.x, -1.0, -st.y);
+    else if(face == 4) return vec3( st.x, -st.y,  1.0);
+    else               return vec3(-st.x, -st.y, -1.0);
+}
+// ----------------------------------------------------------------------------
+// one texel of the level being written from the level above. 3x3 bilinear taps one
+// source texel apart with 1-2-1 weights cover the 4x4 source texels around it with a
+// (1,3,3,1)/8 kernel per axis, instead of the 2x2 box of glGenerateMipmap. the taps go
+// through the cube lookup, so at a face edge they read the neighbouring face (seamless
+// cubemap filtering does the rest), and every tap is weighted by the solid angle it
+// covers, so the mean radiance of the sphere is preserved from level to level.
+vec3 Downsample(int face, ivec2 texel, int size)
+{
+    vec2 st = (vec2(texel) + 0.5) / float(size) * 2.0 - 1.0;
+    float sourceTexel = 1.0 / float(size); // in st units
+    vec3 color = vec3(0.0);
+    float totalWeight = 0.0;
+    for(int j = -1; j <= 1; ++j)
+    {
+        for(int i = -1; i <= 1; ++i)
+        {
+            vec3 dir = FaceDirection(face, st + vec2(i, j) * sourceTexel);
+            float r2 = dot(dir, dir);
+            float weight = (2.0 - abs(float(i))) * (2.0 - abs(float(j))) / (r2 * sqrt(r2));
+            color += textureLod(environmentMap, dir, sourceLevel).rgb * weight;
+            totalWeight += weight;
+        }
+    }
+    return color / totalWeight;
+}
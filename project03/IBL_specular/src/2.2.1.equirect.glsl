@@ -0,0 +1,25 @@
+// Sampling of the equirectangular panorama shared by 2.2.1.equirectangular_to_cubemap.fs
+// and .cs; registered as "2.2.1.equirect.glsl" like 2.2.1.brdf.glsl. The including shader
+// declares the #version.
+
+uniform sampler2D equirectangularMap;
+uniform bool areaFilter;                // EQUIRECT_AREA, needs the equirectangularMap mips
+
+// ----------------------------------------------------------------------------
+// the panorama under a cube texel; lookup is its entry of the direction table
+// (equirect_lookup.h): xy the UV of the texel center, zw the texel's extent in UV.
+vec3 SampleEquirect(vec4 lookup)
+{
+    if(!areaFilter)
+        return textureLod(equirectangularMap, lookup.xy, 0.0).rgb;
+
+    // 2x2 taps at the centers of the footprint's quarters, each prefiltered over its quarter
+    vec2 quarter = lookup.zw * 0.5;
+    vec3 color = vec3(0.0);
+    for(int i = 0; i < 4; ++i)
+    {
+        vec2 offset = (vec2(i & 1, i >> 1) - 0.5) * quarter;
+        color += textureGrad(equirectangularMap, lookup.xy + offset, vec2(quarter.x, 0.0), vec2(0.0, quarter.y)).rgb;
+    }
+    return color * 0.25;
+}
@@ -0,0 +1,25 @@
+#version 430 core
+#ifdef GL_SPIRV
+#extension GL_GOOGLE_include_directive : require
+#endif
+layout (local_size_x = 8, local_size_y = 8, local_size_z = 1) in;
+
+// one invocation per texel; faceOffset + gl_GlobalInvocationID.z selects the cubemap face.
+layout (rgba16f, binding = 0) uniform writeonly imageCube cubemap;
+
+uniform sampler2DArray directionLookup; // direction -> UV table of faceSize (equirect_lookup.h)
+uniform int faceSize;
+uniform int faceOffset;
+
+#include "2.2.1.equirect.glsl"
+
+// ----------------------------------------------------------------------------
+void main()
+{
+    ivec3 texel = ivec3(gl_GlobalInvocationID) + ivec3(0, 0, faceOffset);
+    if(texel.x >= faceSize || texel.y >= faceSize)
+        return;
+
+    vec4 lookup = texelFetch(directionLookup, texel, 0);
+    imageStore(cubemap, texel, vec4(SampleEquirect(lookup), 1.0));
+}
@@ -1,22 +1,19 @@
 #version 330 core
+#ifdef GL_SPIRV
+#extension GL_GOOGLE_include_directive : require
+#endif
 out vec4 FragColor;
 in vec3 WorldPos;
 
-uniform sampler2D equirectangularMap;
+uniform sampler2DArray directionLookup; // direction -> UV table of the face size
+uniform int face;                       // cubemap face being rendered
 
-const vec2 invAtan = vec2(0.1591, 0.3183);
-vec2 SampleSphericalMap(vec3 v)
-{
-    vec2 uv = vec2(atan(v.z, v.x), asin(v.y));
-    uv *= invAtan;
-    uv += 0.5;
-    return uv;
-}
+#include "2.2.1.equirect.glsl"
 
+// ----------------------------------------------------------------------------
 void main()
 {		
-    vec2 uv = SampleSphericalMap(normalize(WorldPos));
-    vec3 color = texture(equirectangularMap, uv).rgb;
-    
-    FragColor = vec4(color, 1.0);
+    // the fragment's texel of the face is the table entry, no atan/asin per texel
+    vec4 lookup = texelFetch(directionLookup, ivec3(ivec2(gl_FragCoord.xy), face), 0);
+    FragColor = vec4(SampleEquirect(lookup), 1.0);
 }
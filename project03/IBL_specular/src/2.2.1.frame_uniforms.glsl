@@ -0,0 +1,19 @@
+// The per-frame camera and lights every program shares (learnopengl/frame_uniforms.h),
+// declared once for 2.2.1.pbr.vs/.fs and 2.2.1.background.vs; registered as
+// "2.2.1.frame_uniforms.glsl" like 2.2.1.brdf.glsl. The including shader declares the
+// #version.
+
+// the lights the block holds, FrameUniforms' MAX_FRAME_LIGHTS: set by the application
+// (ShaderDefines), the fallback has to match the C++ constant
+#ifndef MAX_FRAME_LIGHTS
+#define MAX_FRAME_LIGHTS 4
+#endif
+
+layout (std140) uniform FrameUniforms
+{
+    mat4 projection;
+    mat4 view;
+    vec4 camPos;                            // xyz
+    vec4 lightPositions[MAX_FRAME_LIGHTS];  // xyz
+    vec4 lightColors[MAX_FRAME_LIGHTS];     // rgb
+};
@@ -0,0 +1,77 @@
+#version 430 core
+layout (local_size_x = 8, local_size_y = 8, local_size_z = 1) in;
+
+// one invocation per irradiance texel; faceOffset + gl_GlobalInvocationID.z selects the cubemap face.
+layout (rgba16f, binding = 0) uniform writeonly imageCube irradianceMap;
+
+uniform samplerCube environmentMap;
+uniform int faceSize;
+uniform int faceOffset;
+
+const float PI = 3.14159265359;
+
+// same uniform phi/theta sweep as 2.2.1.irradiance_convolution.fs (sampleDelta = 0.025).
+const float sampleDelta = 0.025;
+const uint PHI_STEPS   = 252u; // ceil(2 PI / sampleDelta)
+const uint THETA_STEPS = 63u;  // ceil(PI / 2 / sampleDelta)
+const uint TOTAL_SAMPLES = PHI_STEPS * THETA_STEPS;
+
+// the sample set is identical for every texel, so the work group builds it once per
+// tile in shared memory instead of every invocation evaluating sin/cos per sample.
+const uint TILE_SIZE = gl_WorkGroupSize.x * gl_WorkGroupSize.y;
+shared vec4 sampleTile[TILE_SIZE]; // xyz: tangent space direction, w: cos(theta) * sin(theta)
+
+// ----------------------------------------------------------------------------
+vec3 CubeTexelDirection(ivec3 texel, int size)
+{
+    vec2 uv = (vec2(texel.xy) + 0.5) / float(size) * 2.0 - 1.0;
+    vec3 dir;
+    if(texel.z == 0)      dir = vec3( 1.0, -uv.y, -uv.x);
+    else if(texel.z == 1) dir = vec3(-1.0, -uv.y,  uv.x);
+    else if(texel.z == 2) dir = vec3( uv.x,  1.0,  uv.y);
+    else if(texel.z == 3) dir = vec3( uv.x, -1.0, -uv.y);
+    else if(texel.z == 4) dir = vec3( uv.x, -uv.y,  1.0);
+    else                  dir = vec3(-uv.x, -uv.y, -1.0);
+    return normalize(dir);
+}
+// ----------------------------------------------------------------------------
+void main()
+{
+    ivec3 texel = ivec3(gl_GlobalInvocationID) + ivec3(0, 0, faceOffset);
+    // out of range invocations still help fill the shared tiles, so no early return.
+    bool inside = texel.x < faceSize && texel.y < faceSize;
+
+    vec3 N = CubeTexelDirection(texel, faceSize);
+
+    // tangent space calculation from origin point
+    vec3 up    = vec3(0.0, 1.0, 0.0);
+    vec3 right = cross(up, N);
+    up         = cross(N, right);
+
+    vec3 irradiance = vec3(0.0);
+    for(uint base = 0u; base < TOTAL_SAMPLES; base += TILE_SIZE)
+    {
+        uint i = base + gl_LocalInvocationIndex;
+        if(i < TOTAL_SAMPLES)
+        {
+            float phi   = float(i / THETA_STEPS) * sampleDelta;
+            float theta = float(i % THETA_STEPS) * sampleDelta;
+            sampleTile[gl_LocalInvocationIndex] = vec4(sin(theta) * cos(phi), sin(theta) * sin(phi), cos(theta), cos(theta) * sin(theta));
+        }
+        barrier();
+
+        uint count = min(TILE_SIZE, TOTAL_SAMPLES - base);
+        for(uint s = 0u; s < count; ++s)
+        {
+            vec4 tangentSample = sampleTile[s];
+            // tangent space to world
+            vec3 sampleVec = tangentSample.x * right + tangentSample.y * up + tangentSample.z * N;
+            irradiance += textureLod(environmentMap, sampleVec, 0.0).rgb * tangentSample.w;
+        }
+        barrier();
+    }
+    irradiance = PI * irradiance * (1.0 / float(TOTAL_SAMPLES));
+
+    if(inside)
+        imageStore(irradianceMap, texel, vec4(irradiance, 1.0));
+}
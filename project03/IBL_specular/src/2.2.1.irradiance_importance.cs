@@ -0,0 +1,83 @@
+#version 430 core
+#ifdef GL_SPIRV
+#extension GL_GOOGLE_include_directive : require
+#endif
+layout (local_size_x = 8, local_size_y = 8, local_size_z = 1) in;
+
+// compute version of 2.2.1.irradiance_importance.fs; faceOffset + gl_GlobalInvocationID.z selects the cubemap face.
+layout (rgba16f, binding = 0) uniform writeonly imageCube irradianceMap;
+
+uniform samplerCube environmentMap;
+uniform int faceSize;
+uniform int faceOffset;
+uniform float envResolution;   // resolution of source cubemap (per face)
+
+// 256 fetches per texel instead of the 252 x 63 = 15876 of irradiance_convolution.cs.
+#ifdef GL_SPIRV
+layout (constant_id = 0) const uint SAMPLE_COUNT = 256u;
+#elif !defined(SAMPLE_COUNT)
+#define SAMPLE_COUNT 256u
+#endif
+const uint TILE_SIZE = gl_WorkGroupSize.x * gl_WorkGroupSize.y;
+
+// the tangent space sample set (and its mip levels) is identical for every texel.
+shared vec4 sampleTable[SAMPLE_COUNT]; // xyz: tangent space direction, w: source mip level
+
+#include "2.2.1.brdf.glsl"
+// ----------------------------------------------------------------------------
+vec3 CubeTexelDirection(ivec3 texel, int size)
+{
+    vec2 uv = (vec2(texel.xy) + 0.5) / float(size) * 2.0 - 1.0;
+    vec3 dir;
+    if(texel.z == 0)      dir = vec3( 1.0, -uv.y, -uv.x);
+    else if(texel.z == 1) dir = vec3(-1.0, -uv.y,  uv.x);
+    else if(texel.z == 2) dir = vec3( uv.x,  1.0,  uv.y);
+    else if(texel.z == 3) dir = vec3( uv.x, -1.0, -uv.y);
+    else if(texel.z == 4) dir = vec3( uv.x, -uv.y,  1.0);
+    else                  dir = vec3(-uv.x, -uv.y, -1.0);
+    return normalize(dir);
+}
+// ----------------------------------------------------------------------------
+void main()
+{
+    // 1. build the shared sample table, each invocation fills SAMPLE_COUNT / TILE_SIZE entries.
+    float saTexel = 4.0 * PI / (6.0 * envResolution * envResolution);
+    for(uint i = gl_LocalInvocationIndex; i < SAMPLE_COUNT; i += TILE_SIZE)
+    {
+        // cosine-weighted hemisphere sample, pdf = cos(theta) / PI
+        vec2 Xi = Hammersley(i, SAMPLE_COUNT);
+        float phi = 2.0 * PI * Xi.x;
+        float cosTheta = sqrt(1.0 - Xi.y);
+        float sinTheta = sqrt(Xi.y);
+
+        // mip whose texels cover the solid angle of the sample (+1 to blur across neighbours)
+        float pdf = cosTheta / PI;
+        float saSample = 1.0 / (float(SAMPLE_COUNT) * pdf + 0.0001);
+        float mipLevel = 0.5 * log2(saSample / saTexel) + 1.0;
+
+        sampleTable[i] = vec4(sinTheta * cos(phi), sinTheta * sin(phi), cosTheta, mipLevel);
+    }
+    barrier();
+
+    ivec3 texel = ivec3(gl_GlobalInvocationID) + ivec3(0, 0, faceOffset);
+    if(texel.x >= faceSize || texel.y >= faceSize)
+        return;
+
+    // 2. integrate with the shared table rotated into this texel's frame.
+    vec3 N = CubeTexelDirection(texel, faceSize);
+    vec3 up    = abs(N.z) < 0.999 ? vec3(0.0, 0.0, 1.0) : vec3(1.0, 0.0, 0.0);
+    vec3 right = normalize(cross(up, N));
+    up         = cross(N, right);
+
+    vec3 irradiance = vec3(0.0);
+    for(uint i = 0u; i < SAMPLE_COUNT; ++i)
+    {
+        vec4 s = sampleTable[i];
+        vec3 sampleVec = s.x * right + s.y * up + s.z * N;
+        irradiance += textureLod(environmentMap, sampleVec, s.w).rgb;
+    }
+    // pdf cancels the cosine term and PI: same scale as irradiance_convolution.cs.
+    irradiance = irradiance * (1.0 / float(SAMPLE_COUNT));
+
+    imageStore(irradianceMap, texel, vec4(irradiance, 1.0));
+}
@@ -0,0 +1,57 @@
+#version 330 core
+#ifdef GL_SPIRV
+#extension GL_GOOGLE_include_directive : require
+#endif
+out vec4 FragColor;
+in vec3 WorldPos;
+
+uniform samplerCube environmentMap;
+uniform float envResolution; // resolution of source cubemap (per face)
+
+// 256 fetches per texel instead of the 252 x 63 = 15876 of the uniform sweep in
+// 2.2.1.irradiance_convolution.fs; the mip-filtered lookups make up for the low count.
+#ifdef GL_SPIRV
+layout (constant_id = 0) const uint SAMPLE_COUNT = 256u;
+#elif !defined(SAMPLE_COUNT)
+#define SAMPLE_COUNT 256u
+#endif
+
+#include "2.2.1.brdf.glsl"
+// ----------------------------------------------------------------------------
+void main()
+{		
+    vec3 N = normalize(WorldPos);
+
+    // tangent space calculation from origin point
+    vec3 up    = abs(N.z) < 0.999 ? vec3(0.0, 0.0, 1.0) : vec3(1.0, 0.0, 0.0);
+    vec3 right = normalize(cross(up, N));
+    up         = cross(N, right);
+
+    float saTexel = 4.0 * PI / (6.0 * envResolution * envResolution);
+
+    vec3 irradiance = vec3(0.0);
+    for(uint i = 0u; i < SAMPLE_COUNT; ++i)
+    {
+        // cosine-weighted hemisphere sample, pdf = cos(theta) / PI
+        vec2 Xi = Hammersley(i, SAMPLE_COUNT);
+        float phi = 2.0 * PI * Xi.x;
+        float cosTheta = sqrt(1.0 - Xi.y);
+        float sinTheta = sqrt(Xi.y);
+        vec3 tangentSample = vec3(sinTheta * cos(phi), sinTheta * sin(phi), cosTheta);
+        // tangent space to world
+        vec3 sampleVec = tangentSample.x * right + tangentSample.y * up + tangentSample.z * N;
+
+        // read the mip whose texels cover the solid angle this sample stands for
+        // (+1 to blur across neighbouring samples), so nothing between samples is skipped.
+        float pdf = cosTheta / PI;
+        float saSample = 1.0 / (float(SAMPLE_COUNT) * pdf + 0.0001);
+        float mipLevel = 0.5 * log2(saSample / saTexel) + 1.0;
+
+        irradiance += textureLod(environmentMap, sampleVec, mipLevel).rgb;
+    }
+    // the cos(theta) / PI of the pdf cancels the cosine term and the PI of the uniform
+    // version, leaving the plain average (same scale as irradiance_convolution.fs).
+    irradiance = irradiance * (1.0 / float(SAMPLE_COUNT));
+    
+    FragColor = vec4(irradiance, 1.0);
+}
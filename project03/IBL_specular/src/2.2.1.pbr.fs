@@ -1,4 +1,8 @@
 #version 330 core
+#extension GL_ARB_texture_cube_map_array : enable
+#ifdef GL_SPIRV
+#extension GL_GOOGLE_include_directive : require
+#endif
 out vec4 FragColor;
 in vec2 TexCoords;
 in vec3 WorldPos;
@@ -19,15 +23,39 @@ uniform sampler2D aoMap;
 // IBL
 uniform samplerCube irradianceMap;
 uniform samplerCube prefilterMap;
+uniform sampler2D prefilterOctMap;  // octahedral layout of the pre-filter chain (see ibl_storage.h)
+uniform bool octahedralPrefilter;   // sample prefilterOctMap instead of prefilterMap
 uniform sampler2D brdfLUT;
-
-// lights
-uniform vec3 lightPositions[4];
-uniform vec3 lightColors[4];
-
-uniform vec3 camPos;
-
-const float PI = 3.14159265359;
+uniform bool analyticBRDF; // use EnvBRDFApprox instead of the brdfLUT texture
+
+// compile-time constants, set per program by the application (ShaderDefines); in the SPIR-V
+// build the ones with a constant_id are specialization constants (shaderConstantIds)
+#include "2.2.1.frame_uniforms.glsl"
+#ifdef GL_SPIRV
+layout (constant_id = 1) const int LIGHT_COUNT = MAX_FRAME_LIGHTS;
+#elif !defined(LIGHT_COUNT)
+#define LIGHT_COUNT MAX_FRAME_LIGHTS
+#endif
+#ifndef MAX_REFLECTION_PROBES
+#define MAX_REFLECTION_PROBES 8
+#endif
+#ifdef GL_SPIRV
+layout (constant_id = 2) const float MAX_REFLECTION_LOD = 4.0; // last mip of the pre-filter map
+#elif !defined(MAX_REFLECTION_LOD)
+#define MAX_REFLECTION_LOD 4.0
+#endif
+
+// local reflection probes (see reflection_probes.h); xyz: capture position, w: influence radius
+uniform int probeCount;
+uniform vec4 probeSpheres[MAX_REFLECTION_PROBES];
+uniform float probeMaxLod; // last mip of the probe array, which has its own chain
+#ifdef GL_ARB_texture_cube_map_array
+uniform samplerCubeArray probePrefilterMaps;
+#endif
+
+uniform bool linearOutput; // no tonemapping/gamma, HDR output for the probe captures
+
+#include "2.2.1.brdf.glsl"
 // ----------------------------------------------------------------------------
 
 vec3 getNormalFromMap()
@@ -47,47 +75,6 @@ vec3 getNormalFromMap()
     return normalize(TBN * tangentSpaceNormal);
 }
 // ----------------------------------------------------------------------------
-// Լ
-// ̼ halfway Ϳ 󸶳 ĵǾ ִ Ÿ Լ
-// Normal  distribution function
-float DistributionGGX(vec3 N, vec3 H, float roughness)
-{
-    float a = roughness*roughness;
-    float a2 = a*a;
-    float NdotH = max(dot(N, H), 0.0);
-    float NdotH2 = NdotH*NdotH;
-
-    float nom   = a2;
-    float denom = (NdotH2 * (a2 - 1.0) + 1.0);
-    denom = PI * denom * denom;
-
-    return nom / denom;
-}
-// ----------------------------------------------------------------------------
-// ̼ ģ  ߻ϴ self-shadow 
-float GeometrySchlickGGX(float NdotV, float roughness)
-{
-    float r = (roughness + 1.0);
-    float k = (r*r) / 8.0;
-
-    float nom   = NdotV;
-    float denom = NdotV * (1.0 - k) + k;
-
-    return nom / denom;
-}
-// ----------------------------------------------------------------------------
-//    ü  θ  geometry function
-// geometry function
-float GeometrySmith(vec3 N, vec3 V, vec3 L, float roughness)
-{
-    float NdotV = max(dot(N, V), 0.0);
-    float NdotL = max(dot(N, L), 0.0);
-    float ggx2 = GeometrySchlickGGX(NdotV, roughness);
-    float ggx1 = GeometrySchlickGGX(NdotL, roughness);
-
-    return ggx1 * ggx2;
-}
-// ----------------------------------------------------------------------------
 //  ݼ  F0 0.04 linear interpolation   Ŀ 
 // fresnel equation approximation
 vec3 fresnelSchlick(float cosTheta, vec3 F0)
@@ -102,6 +89,60 @@ vec3 fresnelSchlickRoughness(float cosTheta, vec3 F0, float roughness)
     return F0 + (max(vec3(1.0 - roughness), F0) - F0) * pow(1.0 - cosTheta, 5.0);
 }   
 // ----------------------------------------------------------------------------
+// analytic fit of the split-sum BRDF LUT (Karis, "Physically Based Shading on Mobile")
+vec2 EnvBRDFApprox(float NdotV, float roughness)
+{
+    const vec4 c0 = vec4(-1.0, -0.0275, -0.572, 0.022);
+    const vec4 c1 = vec4(1.0, 0.0425, 1.04, -0.04);
+    vec4 r = roughness * c0 + c1;
+    float a004 = min(r.x * r.x, exp2(-9.28 * NdotV)) * r.x + r.y;
+    return vec2(-1.04, 1.04) * a004 + r.zw;
+}
+// ----------------------------------------------------------------------------
+// sphere -> [0,1]^2, +Z hemisphere in the inner diamond (same as octahedralEncode in ibl_storage.h)
+vec2 OctahedralEncode(vec3 n)
+{
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    vec2 p = n.xy;
+    if(n.z < 0.0)
+        p = (1.0 - abs(p.yx)) * vec2(p.x >= 0.0 ? 1.0 : -1.0, p.y >= 0.0 ? 1.0 : -1.0);
+    return p * 0.5 + 0.5;
+}
+// ----------------------------------------------------------------------------
+// blends the pre-filtered probes whose influence sphere contains WorldPos, weighted
+// linearly towards the sphere's border. R is corrected for parallax against the sphere
+// (the point it hits is looked up from the probe's center). The global pre-filter map
+// covers the weight the probes leave.
+vec3 SampleReflectionProbes(vec3 R, float lod, vec3 globalColor)
+{
+#ifdef GL_ARB_texture_cube_map_array
+    vec3 color = vec3(0.0);
+    float totalWeight = 0.0;
+    for(int i = 0; i < probeCount; ++i)
+    {
+        vec3 fromProbe = WorldPos - probeSpheres[i].xyz;
+        float radius = probeSpheres[i].w;
+        float dist = length(fromProbe);
+        if(dist >= radius)
+            continue;
+        float weight = 1.0 - dist / radius;
+
+        // inside the sphere, so R always leaves it: the positive root of |fromProbe + t*R| = radius
+        float b = dot(fromProbe, R);
+        float c = dot(fromProbe, fromProbe) - radius * radius;
+        vec3 hit = fromProbe + (-b + sqrt(b * b - c)) * R;
+
+        color += textureLod(probePrefilterMaps, vec4(hit, float(i)), lod).rgb * weight;
+        totalWeight += weight;
+    }
+    if(totalWeight > 1.0)
+        return color / totalWeight;
+    return color + globalColor * (1.0 - totalWeight);
+#else
+    return globalColor;
+#endif
+}
+// ----------------------------------------------------------------------------
 void main()
 {		
     // ü 
@@ -112,7 +153,7 @@ void main()
        
     // input lighting data
     vec3 N = getNormalFromMap();
-    vec3 V = normalize(camPos - WorldPos);
+    vec3 V = normalize(camPos.xyz - WorldPos);
     vec3 R = reflect(-V, N); 
 
     // calculate reflectance at normal incidence; if dia-electric (like plastic) use F0 
@@ -124,20 +165,20 @@ void main()
     // reflectance equation
     // ݻ 
     vec3 Lo = vec3(0.0);
-    for(int i = 0; i < 4; ++i) 
+    for(int i = 0; i < LIGHT_COUNT; ++i) 
     {
         // calculate per-light radiance
-        vec3 L = normalize(lightPositions[i] - WorldPos);
+        vec3 L = normalize(lightPositions[i].xyz - WorldPos);
         vec3 H = normalize(V + L);
-        float distance = length(lightPositions[i] - WorldPos);
+        float distance = length(lightPositions[i].xyz - WorldPos);
         // Ÿ   
         float attenuation = 1.0 / (distance * distance);
-        vec3 radiance = lightColors[i] * attenuation;
+        vec3 radiance = lightColors[i].rgb * attenuation;
 
         // Cook-Torrance BRDF
         //    DFG  
         float NDF = DistributionGGX(N, H, roughness);   
-        float G   = GeometrySmith(N, V, L, roughness);    
+        float G   = GeometrySmith(N, V, L, GeometryKDirect(roughness));    
         vec3 F    = fresnelSchlick(max(dot(H, V), 0.0), F0);        
         
         vec3 numerator    = NDF * G * F;
@@ -175,14 +216,21 @@ void main()
     vec3 diffuse      = irradiance * albedo;
     
     // sample both the pre-filter map and the BRDF lut and combine them together as per the Split-Sum approximation to get the IBL specular part.
-    const float MAX_REFLECTION_LOD = 4.0;
-    vec3 prefilteredColor = textureLod(prefilterMap, R,  roughness * MAX_REFLECTION_LOD).rgb;    
-    vec2 brdf  = texture(brdfLUT, vec2(max(dot(N, V), 0.0), roughness)).rg;
+    vec3 prefilteredColor = octahedralPrefilter ? textureLod(prefilterOctMap, OctahedralEncode(R), roughness * MAX_REFLECTION_LOD).rgb
+                                                : textureLod(prefilterMap, R,  roughness * MAX_REFLECTION_LOD).rgb;    
+    prefilteredColor = SampleReflectionProbes(R, roughness * probeMaxLod, prefilteredColor);
+    vec2 brdf  = analyticBRDF ? EnvBRDFApprox(max(dot(N, V), 0.0), roughness)
+                              : texture(brdfLUT, vec2(max(dot(N, V), 0.0), roughness)).rg;
     vec3 specular = prefilteredColor * (F * brdf.x + brdf.y);
 
     vec3 ambient = (kD * diffuse + specular) * ao;
     
     vec3 color = ambient + Lo;
+    if(linearOutput)
+    {
+        FragColor = vec4(color, 1.0);
+        return;
+    }
 
     // HDR tonemapping
     color = color / (color + vec3(1.0));
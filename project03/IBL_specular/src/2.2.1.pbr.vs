@@ -1,21 +1,43 @@
 #version 330 core
+#ifdef GL_SPIRV
+#extension GL_GOOGLE_include_directive : require
+#endif
+
+// the model's vertex format (learnopengl/mesh.h): 1 for the packed ones, 0 for Vertex.
+// The SPIR-V build keeps this default.
+#ifndef PACKED_VERTICES
+#define PACKED_VERTICES 1
+#endif
+
+#if PACKED_VERTICES
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec2 aNormal;
+layout (location = 2) in vec2 aTexCoords;
+
+#include "2.2.1.vertex_packing.glsl"
+#else
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoords;
+#endif
 
 out vec2 TexCoords;
 out vec3 WorldPos;
 out vec3 Normal;
 
-uniform mat4 projection;
-uniform mat4 view;
+#include "2.2.1.frame_uniforms.glsl"
 uniform mat4 model;
 
 void main()
 {
     TexCoords = aTexCoords;
+#if PACKED_VERTICES
+    WorldPos = vec3(model * vec4(decodePosition(aPos), 1.0));
+    Normal = mat3(model) * decodeNormal(aNormal);
+#else
     WorldPos = vec3(model * vec4(aPos, 1.0));
     Normal = mat3(model) * aNormal;   
+#endif
 
     gl_Position =  projection * view * vec4(WorldPos, 1.0);
 }
\ No newline at end of file
@@ -0,0 +1,89 @@
+#version 430 core
+#ifdef GL_SPIRV
+#extension GL_GOOGLE_include_directive : require
+#endif
+layout (local_size_x = 8, local_size_y = 8, local_size_z = 1) in;
+
+// one dispatch per mip level; faceOffset + gl_GlobalInvocationID.z selects the cubemap face.
+layout (rgba16f, binding = 0) uniform writeonly imageCube prefilterMap;
+
+uniform samplerCube environmentMap;
+uniform float roughness;
+uniform int faceSize;          // size of the mip level being written
+uniform int faceOffset;        // first face of this dispatch
+uniform float envResolution;   // resolution of source cubemap (per face)
+
+#ifdef GL_SPIRV
+layout (constant_id = 0) const uint SAMPLE_COUNT = 256u; // enough with the filtered envCubemap mips (2.2.1.downsample.*)
+#elif !defined(SAMPLE_COUNT)
+#define SAMPLE_COUNT 256u
+#endif
+const uint TILE_SIZE = gl_WorkGroupSize.x * gl_WorkGroupSize.y;
+
+// with V = R = N every texel uses the same tangent space light directions and
+// source mip levels, so the work group computes the table once and shares it.
+shared vec4 sampleTable[SAMPLE_COUNT]; // xyz: tangent space L, w: source mip level
+
+#include "2.2.1.brdf.glsl"
+// ----------------------------------------------------------------------------
+vec3 CubeTexelDirection(ivec3 texel, int size)
+{
+    vec2 uv = (vec2(texel.xy) + 0.5) / float(size) * 2.0 - 1.0;
+    vec3 dir;
+    if(texel.z == 0)      dir = vec3( 1.0, -uv.y, -uv.x);
+    else if(texel.z == 1) dir = vec3(-1.0, -uv.y,  uv.x);
+    else if(texel.z == 2) dir = vec3( uv.x,  1.0,  uv.y);
+    else if(texel.z == 3) dir = vec3( uv.x, -1.0, -uv.y);
+    else if(texel.z == 4) dir = vec3( uv.x, -uv.y,  1.0);
+    else                  dir = vec3(-uv.x, -uv.y, -1.0);
+    return normalize(dir);
+}
+// ----------------------------------------------------------------------------
+void main()
+{
+    // 1. build the shared sample table, each invocation fills SAMPLE_COUNT / TILE_SIZE entries.
+    float saTexel = 4.0 * PI / (6.0 * envResolution * envResolution);
+    for(uint i = gl_LocalInvocationIndex; i < SAMPLE_COUNT; i += TILE_SIZE)
+    {
+        vec2 Xi = Hammersley(i, SAMPLE_COUNT);
+        vec3 H = ImportanceSampleGGXTangent(Xi, roughness);
+        // V = N = +Z in tangent space
+        vec3 L = normalize(2.0 * H.z * H - vec3(0.0, 0.0, 1.0));
+
+        // sample from the environment's mip level based on roughness/pdf (NdotH == HdotV as V == N)
+        float D   = DistributionGGX(H.z, roughness);
+        float pdf = D * H.z / (4.0 * H.z) + 0.0001;
+        float saSample = 1.0 / (float(SAMPLE_COUNT) * pdf + 0.0001);
+        float mipLevel = roughness == 0.0 ? 0.0 : 0.5 * log2(saSample / saTexel);
+
+        sampleTable[i] = vec4(L, mipLevel);
+    }
+    barrier();
+
+    ivec3 texel = ivec3(gl_GlobalInvocationID) + ivec3(0, 0, faceOffset);
+    if(texel.x >= faceSize || texel.y >= faceSize)
+        return;
+
+    // 2. integrate with the shared table rotated into this texel's frame.
+    vec3 N = CubeTexelDirection(texel, faceSize);
+    vec3 up        = abs(N.z) < 0.999 ? vec3(0.0, 0.0, 1.0) : vec3(1.0, 0.0, 0.0);
+    vec3 tangent   = normalize(cross(up, N));
+    vec3 bitangent = cross(N, tangent);
+
+    vec3 prefilteredColor = vec3(0.0);
+    float totalWeight = 0.0;
+    for(uint i = 0u; i < SAMPLE_COUNT; ++i)
+    {
+        vec4 s = sampleTable[i];
+        float NdotL = s.z;
+        if(NdotL > 0.0)
+        {
+            vec3 L = tangent * s.x + bitangent * s.y + N * s.z;
+            prefilteredColor += textureLod(environmentMap, L, s.w).rgb * NdotL;
+            totalWeight      += NdotL;
+        }
+    }
+    prefilteredColor = prefilteredColor / totalWeight;
+
+    imageStore(prefilterMap, texel, vec4(prefilteredColor, 1.0));
+}
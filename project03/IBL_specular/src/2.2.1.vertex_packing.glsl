@@ -0,0 +1,38 @@
+// Decode of the packed vertex formats of learnopengl/mesh.h (VERTEX_PACKED and
+// VERTEX_QUANTIZED); registered as "2.2.1.vertex_packing.glsl" like 2.2.1.brdf.glsl.
+// The including shader declares the #version and the attributes:
+//   location 0  vec3   position (float, or unorm16 within the mesh bounds)
+//   location 1  vec2   octahedral normal (snorm16)
+//   location 2  vec2   texture coordinates (half)
+//   location 3  ivec2  octahedral tangent in the upper 15 bits, bitangent sign in bit 0 of x
+
+// quantized positions are scaled back to the mesh bounds; float positions come with the
+// identity (0, 1). Constant attributes for Mesh::Draw, per draw ones in a GeometryBuffer
+// (POSITION_OFFSET_ATTRIBUTE and POSITION_SCALE_ATTRIBUTE).
+layout (location = 5) in vec3 aPositionOffset;
+layout (location = 6) in vec3 aPositionScale;
+
+vec3 decodePosition(vec3 position)
+{
+    return aPositionOffset + position * aPositionScale;
+}
+
+vec3 octahedralDecode(vec2 e)
+{
+    vec3 v = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (v.z < 0.0)
+        v.xy = (1.0 - abs(v.yx)) * vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+    return normalize(v);
+}
+
+vec3 decodeNormal(vec2 normal)
+{
+    return octahedralDecode(normal);
+}
+
+// the tangent; the bitangent is cross(N, T) * handedness.
+vec3 decodeTangent(ivec2 tangent, out float handedness)
+{
+    handedness = (tangent.x & 1) != 0 ? -1.0 : 1.0;
+    return octahedralDecode(vec2(tangent >> 1) / 16383.0);
+}
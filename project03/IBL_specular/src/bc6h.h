@@ -0,0 +1,245 @@
+#ifndef _BC6H_H_
+#define _BC6H_H_
+
+#pragma once
+
+#include <glm/glm.hpp>
+#include <learnopengl/parallel.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// Small BC6H (GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT) encoder for the IBL maps.
+//
+// Every block is written in mode 11: one subset, two 10-bit endpoints per channel
+// and a 4-bit index per texel. The prefiltered/irradiance maps are smooth, so the
+// single line through each 4x4 block fits them well and the partitioned modes
+// aren't worth the search. BC6H interpolates the raw half-float bit patterns, so
+// the fit is done in that (roughly logarithmic) space, like the hardware decoder.
+//
+// input is RGB half floats (as read back with GL_HALF_FLOAT); negative values are clamped to 0.
+
+const unsigned int BC6H_BLOCK_BYTES = 16;
+
+// interpolation weights of the 4-bit indices (out of 64)
+const int BC6H_WEIGHTS[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+// 10-bit endpoint -> 16-bit interpolation value (unsigned unquantize)
+inline int bc6hUnquantize(int q)
+{
+	if (q == 0)
+		return 0;
+	if (q == 1023)
+		return 0xFFFF;
+	return ((q << 16) + 0x8000) >> 10;
+}
+
+// half bits produced by the decoder for two unquantized endpoints and a weight
+inline int bc6hInterpolate(int a, int b, int weight)
+{
+	int value = ((64 - weight) * a + weight * b + 32) >> 6;
+	return (value * 31) >> 6; // finish unquantize (unsigned)
+}
+
+// half bits as the encoder sees them: negatives become 0, infinity/NaN the largest finite half
+inline int bc6hClampHalf(uint16_t half)
+{
+	return (half & 0x8000) ? 0 : std::min((int)half, 0x7BFF);
+}
+
+// the 16-bit interpolation value a decoded half came from, and the endpoint closest to it
+inline float bc6hFromHalf(uint16_t half)
+{
+	return bc6hClampHalf(half) * (64.0f / 31.0f);
+}
+inline int bc6hQuantize(float value)
+{
+	return glm::clamp((int)((value - 32.0f) / 64.0f + 0.5f), 0, 1023);
+}
+
+class BC6HBitWriter {
+public:
+	explicit BC6HBitWriter(uint8_t* out) : out(out) { memset(out, 0, BC6H_BLOCK_BYTES); }
+	void write(unsigned int value, int bits)
+	{
+		for (int i = 0; i < bits; ++i, ++pos)
+			if (value & (1u << i))
+				out[pos >> 3] |= (uint8_t)(1u << (pos & 7));
+	}
+private:
+	uint8_t* out;
+	int pos = 0;
+};
+
+// pick the index with the smallest error in the decoder's own output space for every
+// texel, returns the total squared error (in half-bit units).
+inline int bc6hAssignIndices(const uint16_t* texels, const int* e0, const int* e1, int* indices)
+{
+	int u0[3], u1[3];
+	for (int c = 0; c < 3; ++c)
+	{
+		u0[c] = bc6hUnquantize(e0[c]);
+		u1[c] = bc6hUnquantize(e1[c]);
+	}
+	int total = 0;
+	for (int i = 0; i < 16; ++i)
+	{
+		int best = 0;
+		int bestError = 0x7FFFFFFF;
+		for (int w = 0; w < 16; ++w)
+		{
+			int error = 0;
+			for (int c = 0; c < 3; ++c)
+			{
+				int diff = bc6hInterpolate(u0[c], u1[c], BC6H_WEIGHTS[w]) - bc6hClampHalf(texels[i * 3 + c]);
+				error += diff * diff;
+			}
+			if (error < bestError)
+			{
+				bestError = error;
+				best = w;
+			}
+		}
+		indices[i] = best;
+		total += bestError;
+	}
+	return total;
+}
+
+// encode one 4x4 block; texels are 16 RGB half triples in row-major order.
+inline void encodeBC6HBlock(const uint16_t* texels, uint8_t* out)
+{
+	glm::vec3 points[16];
+	glm::vec3 mean(0.0f);
+	for (int i = 0; i < 16; ++i)
+	{
+		points[i] = glm::vec3(bc6hFromHalf(texels[i * 3]), bc6hFromHalf(texels[i * 3 + 1]), bc6hFromHalf(texels[i * 3 + 2]));
+		mean += points[i];
+	}
+	mean /= 16.0f;
+
+	// principal axis of the block by power iteration on the covariance matrix
+	glm::mat3 covariance(0.0f);
+	for (int i = 0; i < 16; ++i)
+	{
+		glm::vec3 d = points[i] - mean;
+		covariance += glm::outerProduct(d, d);
+	}
+	glm::vec3 axis(1.0f, 1.0f, 1.0f);
+	for (int iteration = 0; iteration < 8; ++iteration)
+	{
+		glm::vec3 next = covariance * axis;
+		float length = glm::length(next);
+		if (length < 1e-6f)
+			break;
+		axis = next / length;
+	}
+	axis = glm::normalize(axis);
+
+	float minT = 0.0f, maxT = 0.0f;
+	for (int i = 0; i < 16; ++i)
+	{
+		float t = glm::dot(points[i] - mean, axis);
+		minT = std::min(minT, t);
+		maxT = std::max(maxT, t);
+	}
+	glm::vec3 lo = mean + axis * minT;
+	glm::vec3 hi = mean + axis * maxT;
+
+	int e0[3], e1[3];
+	for (int c = 0; c < 3; ++c)
+	{
+		e0[c] = bc6hQuantize(lo[c]);
+		e1[c] = bc6hQuantize(hi[c]);
+	}
+	int indices[16];
+	int error = bc6hAssignIndices(texels, e0, e1, indices);
+
+	// refit the endpoints to the chosen weights (least squares per channel) and keep
+	// the result if it decodes closer; a couple of rounds are enough for smooth blocks.
+	for (int round = 0; round < 2 && error > 0; ++round)
+	{
+		float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+		glm::vec3 ax(0.0f), bx(0.0f);
+		for (int i = 0; i < 16; ++i)
+		{
+			float beta = BC6H_WEIGHTS[indices[i]] / 64.0f;
+			float alpha = 1.0f - beta;
+			aa += alpha * alpha;
+			ab += alpha * beta;
+			bb += beta * beta;
+			ax += alpha * points[i];
+			bx += beta * points[i];
+		}
+		float det = aa * bb - ab * ab;
+		if (std::abs(det) < 1e-6f)
+			break;
+		int f0[3], f1[3], refit[16];
+		for (int c = 0; c < 3; ++c)
+		{
+			f0[c] = bc6hQuantize((bb * ax[c] - ab * bx[c]) / det);
+			f1[c] = bc6hQuantize((aa * bx[c] - ab * ax[c]) / det);
+		}
+		int refitError = bc6hAssignIndices(texels, f0, f1, refit);
+		if (refitError >= error)
+			break;
+		error = refitError;
+		std::copy(f0, f0 + 3, e0);
+		std::copy(f1, f1 + 3, e1);
+		std::copy(refit, refit + 16, indices);
+	}
+
+	// the first index is stored with 3 bits, so its top bit must be 0: swap the endpoints
+	// (the weights are symmetric, index i becomes 15 - i)
+	if (indices[0] & 8)
+	{
+		for (int c = 0; c < 3; ++c)
+			std::swap(e0[c], e1[c]);
+		for (int i = 0; i < 16; ++i)
+			indices[i] = 15 - indices[i];
+	}
+
+	BC6HBitWriter bits(out);
+	bits.write(0x03, 5); // mode 11
+	for (int c = 0; c < 3; ++c)
+		bits.write(e0[c], 10);
+	for (int c = 0; c < 3; ++c)
+		bits.write(e1[c], 10);
+	bits.write(indices[0], 3);
+	for (int i = 1; i < 16; ++i)
+		bits.write(indices[i], 4);
+}
+
+inline size_t bc6hSize(int width, int height)
+{
+	return (size_t)((width + 3) / 4) * ((height + 3) / 4) * BC6H_BLOCK_BYTES;
+}
+
+// compress a width x height RGB half image (rows in GL order), one block row per task.
+// edge blocks of images that aren't a multiple of 4 repeat the last row/column.
+inline std::vector<uint8_t> encodeBC6H(const uint16_t* rgb, int width, int height)
+{
+	int blocksX = (width + 3) / 4;
+	int blocksY = (height + 3) / 4;
+	std::vector<uint8_t> out(bc6hSize(width, height));
+	parallel_for(0, blocksY, [&](int by)
+	{
+		uint16_t texels[16 * 3];
+		for (int bx = 0; bx < blocksX; ++bx)
+		{
+			for (int y = 0; y < 4; ++y)
+				for (int x = 0; x < 4; ++x)
+				{
+					int sx = std::min(bx * 4 + x, width - 1);
+					int sy = std::min(by * 4 + y, height - 1);
+					memcpy(&texels[(y * 4 + x) * 3], &rgb[((size_t)sy * width + sx) * 3], 3 * sizeof(uint16_t));
+				}
+			encodeBC6HBlock(texels, &out[((size_t)by * blocksX + bx) * BC6H_BLOCK_BYTES]);
+		}
+	});
+	return out;
+}
+
+#endif
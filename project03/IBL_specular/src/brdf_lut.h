@@ -0,0 +1,143 @@
+#ifndef _BRDF_LUT_H_
+#define _BRDF_LUT_H_
+
+#pragma once
+
+#include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
+#include <learnopengl/parallel.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Split-sum BRDF integration LUT (scale, bias) computed on the CPU.
+// This is the same integral as 2.2.1.brdf.fs; the result never changes, so it is
+// generated once by tools/brdf_lut_gen.cpp and stored next to the other resources
+// as RG half floats: resources/textures/brdf_lut_<size>.bin
+//
+// file layout (little endian):
+//   char[4]  magic "BLUT"
+//   uint32   size (width == height)
+//   uint32   sample count per texel
+//   uint16   size * size * 2 half floats, row 0 = roughness ~ 0, texel x = NdotV
+
+const char BRDF_LUT_MAGIC[4] = { 'B', 'L', 'U', 'T' };
+
+inline std::string brdfLUTPath(unsigned int size)
+{
+	return "resources/textures/brdf_lut_" + std::to_string(size) + ".bin";
+}
+
+// ----------------------------------------------------------------------------
+// efficient VanDerCorpus calculation.
+inline float radicalInverseVdC(uint32_t bits)
+{
+	bits = (bits << 16u) | (bits >> 16u);
+	bits = ((bits & 0x55555555u) << 1u) | ((bits & 0xAAAAAAAAu) >> 1u);
+	bits = ((bits & 0x33333333u) << 2u) | ((bits & 0xCCCCCCCCu) >> 2u);
+	bits = ((bits & 0x0F0F0F0Fu) << 4u) | ((bits & 0xF0F0F0F0u) >> 4u);
+	bits = ((bits & 0x00FF00FFu) << 8u) | ((bits & 0xFF00FF00u) >> 8u);
+	return float(bits) * 2.3283064365386963e-10f; // / 0x100000000
+}
+
+inline float geometrySchlickGGXIBL(float NdotV, float roughness)
+{
+	// note that we use a different k for IBL
+	float k = (roughness * roughness) / 2.0f;
+	return NdotV / (NdotV * (1.0f - k) + k);
+}
+
+// CPU version of IntegrateBRDF() in 2.2.1.brdf.fs (N = +Z).
+inline glm::vec2 integrateBRDF(float NdotV, float roughness, unsigned int sampleCount)
+{
+	const float PI = 3.14159265359f;
+	glm::vec3 V(std::sqrt(1.0f - NdotV * NdotV), 0.0f, NdotV);
+
+	float a = roughness * roughness;
+	float A = 0.0f;
+	float B = 0.0f;
+	for (unsigned int i = 0; i < sampleCount; ++i)
+	{
+		// importance sample the GGX lobe around N
+		float xi1 = float(i) / float(sampleCount);
+		float xi2 = radicalInverseVdC(i);
+		float phi = 2.0f * PI * xi1;
+		float cosTheta = std::sqrt((1.0f - xi2) / (1.0f + (a * a - 1.0f) * xi2));
+		float sinTheta = std::sqrt(1.0f - cosTheta * cosTheta);
+		glm::vec3 H(std::cos(phi) * sinTheta, std::sin(phi) * sinTheta, cosTheta);
+		glm::vec3 L = glm::normalize(2.0f * glm::dot(V, H) * H - V);
+
+		float NdotL = glm::max(L.z, 0.0f);
+		float NdotH = glm::max(H.z, 0.0f);
+		float VdotH = glm::max(glm::dot(V, H), 0.0f);
+		if (NdotL > 0.0f)
+		{
+			float G = geometrySchlickGGXIBL(NdotL, roughness) * geometrySchlickGGXIBL(NdotV, roughness);
+			float G_Vis = (G * VdotH) / (NdotH * NdotV);
+			float Fc = std::pow(1.0f - VdotH, 5.0f);
+
+			A += (1.0f - Fc) * G_Vis;
+			B += Fc * G_Vis;
+		}
+	}
+	return glm::vec2(A, B) / float(sampleCount);
+}
+
+// integrate every texel of a size x size LUT, one row per task across all cores.
+// returns RG half floats ready for glTexImage2D(GL_RG16F, GL_RG, GL_HALF_FLOAT).
+inline std::vector<uint16_t> generateBRDFLUT(unsigned int size, unsigned int sampleCount = 1024)
+{
+	std::vector<uint16_t> lut(size * size * 2);
+	parallel_for(0, (int)size, [&](int y)
+	{
+		// sample texel centers, as the fragment shader did for the screen-space quad
+		float roughness = (float(y) + 0.5f) / float(size);
+		for (unsigned int x = 0; x < size; ++x)
+		{
+			float NdotV = (float(x) + 0.5f) / float(size);
+			glm::vec2 brdf = integrateBRDF(NdotV, roughness, sampleCount);
+			lut[(y * size + x) * 2 + 0] = glm::packHalf1x16(brdf.x);
+			lut[(y * size + x) * 2 + 1] = glm::packHalf1x16(brdf.y);
+		}
+	});
+	return lut;
+}
+
+inline bool saveBRDFLUT(const std::string& path, unsigned int size, unsigned int sampleCount, const std::vector<uint16_t>& lut)
+{
+	FILE* file = fopen(path.c_str(), "wb");
+	if (!file)
+		return false;
+	uint32_t header[2] = { size, sampleCount };
+	bool ok = fwrite(BRDF_LUT_MAGIC, 1, 4, file) == 4
+		&& fwrite(header, sizeof(uint32_t), 2, file) == 2
+		&& fwrite(lut.data(), sizeof(uint16_t), lut.size(), file) == lut.size();
+	fclose(file);
+	return ok;
+}
+
+// returns an empty vector if the file is missing, malformed or has a different size.
+inline std::vector<uint16_t> loadBRDFLUT(const std::string& path, unsigned int size)
+{
+	std::vector<uint16_t> lut;
+	FILE* file = fopen(path.c_str(), "rb");
+	if (!file)
+		return lut;
+	char magic[4];
+	uint32_t header[2];
+	if (fread(magic, 1, 4, file) == 4 && std::equal(magic, magic + 4, BRDF_LUT_MAGIC)
+		&& fread(header, sizeof(uint32_t), 2, file) == 2 && header[0] == size)
+	{
+		lut.resize(size * size * 2);
+		if (fread(lut.data(), sizeof(uint16_t), lut.size(), file) != lut.size())
+			lut.clear();
+	}
+	fclose(file);
+	return lut;
+}
+
+#endif
@@ -0,0 +1,109 @@
+#ifndef _EQUIRECT_LOOKUP_H_
+#define _EQUIRECT_LOOKUP_H_
+
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <learnopengl/parallel.h>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+// how the equirectangular map is sampled for a cubemap texel.
+enum EquirectFilter {
+	// one bilinear tap of mip 0 at the texel center; aliases when the source has more
+	// texels than the face (e.g. an 8K panorama into 512^2 faces).
+	EQUIRECT_BILINEAR,
+	// 2x2 taps spread over the texel's footprint in the panorama, each reading the source
+	// mip that matches a quarter of it (textureGrad), so every source texel under the cube
+	// texel contributes about equally. needs the mip chain of the equirectangular texture.
+	EQUIRECT_AREA
+};
+
+// direction of the point (s, t) in [-1,1]^2 of a cubemap face, in the GL face orientation
+// (the same as cubeTexelDirection and the captureViews of the raster bake). not normalized.
+inline glm::vec3 cubeFaceDirection(unsigned int face, float s, float t)
+{
+	switch (face)
+	{
+	case 0: return glm::vec3(1.0f, -t, -s);
+	case 1: return glm::vec3(-1.0f, -t, s);
+	case 2: return glm::vec3(s, 1.0f, t);
+	case 3: return glm::vec3(s, -1.0f, -t);
+	case 4: return glm::vec3(s, -t, 1.0f);
+	default: return glm::vec3(-s, -t, -1.0f);
+	}
+}
+
+// SampleSphericalMap of the shaders: longitude/latitude of a direction in [0,1]^2.
+inline glm::vec2 equirectUV(glm::vec3 dir)
+{
+	dir = glm::normalize(dir);
+	const float PI = 3.14159265359f;
+	return glm::vec2(std::atan2(dir.z, dir.x) / (2.0f * PI) + 0.5f, std::asin(glm::clamp(dir.y, -1.0f, 1.0f)) / PI + 0.5f);
+}
+
+// The direction -> UV table of the equirectangular conversion: for every texel of the six
+// size x size faces (layer = face, rows in GL order) the panorama UV of the texel center
+// (xy) and the extent of the texel in UV (zw, longitude wrapping around). The conversion
+// shaders fetch it instead of running atan/asin per texel.
+inline std::vector<float> buildEquirectLookup(unsigned int size)
+{
+	std::vector<float> table((size_t)6 * size * size * 4);
+	parallel_for(0, (int)(6 * size), [&](int row)
+	{
+		unsigned int face = row / size;
+		unsigned int y = row % size;
+		for (unsigned int x = 0; x < size; ++x)
+		{
+			float s = ((float)x + 0.5f) / size * 2.0f - 1.0f;
+			float t = ((float)y + 0.5f) / size * 2.0f - 1.0f;
+			float halfTexel = 1.0f / size;
+			glm::vec2 center = equirectUV(cubeFaceDirection(face, s, t));
+			glm::vec2 extent(0.0f);
+			for (int corner = 0; corner < 4; ++corner)
+			{
+				float cs = s + ((corner & 1) ? halfTexel : -halfTexel);
+				float ct = t + ((corner & 2) ? halfTexel : -halfTexel);
+				glm::vec2 d = glm::abs(equirectUV(cubeFaceDirection(face, cs, ct)) - center);
+				d.x = std::min(d.x, 1.0f - d.x);
+				extent = glm::max(extent, d * 2.0f);
+			}
+			float* out = &table[(((size_t)face * size + y) * size + x) * 4];
+			out[0] = center.x;
+			out[1] = center.y;
+			out[2] = extent.x;
+			out[3] = extent.y;
+		}
+	});
+	return table;
+}
+
+// the lookup as a GL_TEXTURE_2D_ARRAY (RGBA32F, one layer per face, 16 bytes per cube texel),
+// built on the first use and again only when the face size changes.
+class EquirectLookup {
+public:
+	unsigned int texture(unsigned int size)
+	{
+		if (size == builtSize)
+			return lookup;
+		if (!lookup)
+			glGenTextures(1, &lookup);
+		std::vector<float> table = buildEquirectLookup(size);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, lookup);
+		glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA32F, size, size, 6, 0, GL_RGBA, GL_FLOAT, table.data());
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, 0);
+		builtSize = size;
+		return lookup;
+	}
+
+private:
+	unsigned int lookup = 0;
+	unsigned int builtSize = 0;
+};
+
+#endif
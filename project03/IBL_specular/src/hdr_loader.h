@@ -0,0 +1,291 @@
+#ifndef _HDR_LOADER_H_
+#define _HDR_LOADER_H_
+
+#pragma once
+
+#include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
+#include <learnopengl/parallel.h>
+#include <stb_image.h>
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define HDR_LOADER_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+// Radiance (.hdr, RGBE) loader that decodes straight to half floats.
+//
+// stbi_loadf decodes on one thread into 32-bit floats and the RGB16F upload then
+// has the driver convert them. HDRFile instead indexes the RLE scanlines once,
+// decodes them on all cores and converts RGBE -> half (F16C when the CPU has it)
+// into the caller's buffer, typically a mapped pixel unpack buffer, so the only
+// full-size copy is the one GL needs anyway. Files the fast path doesn't handle
+// (old-style RLE, rotated/flipped orientations, XYZE) are decoded by stb_image
+// instead and converted the same way. Both steps are thread safe, so open() and
+// decodeHalf() can run on a worker thread.
+class HDRFile {
+public:
+	int width = 0;
+	int height = 0;
+
+	// reads the file, parses the header and finds where every scanline starts.
+	// returns false if the file can't be read or decoded at all.
+	bool open(const char* path)
+	{
+		FILE* file = fopen(path, "rb");
+		if (!file)
+			return false;
+		fseek(file, 0, SEEK_END);
+		long size = ftell(file);
+		fseek(file, 0, SEEK_SET);
+		bytes.resize(size > 0 ? (size_t)size : 0);
+		size_t read = fread(bytes.data(), 1, bytes.size(), file);
+		fclose(file);
+		if (read != bytes.size())
+			return false;
+		if (parseHeader() && indexScanlines())
+			return true;
+
+		// slow path; note stb's (global) flip flag must be left off, decodeHalf flips.
+		int components;
+		float* data = stbi_loadf_from_memory(bytes.data(), (int)bytes.size(), &width, &height, &components, 3);
+		bytes.clear();
+		if (!data)
+			return false;
+		fallback.assign(data, data + halfCount());
+		stbi_image_free(data);
+		return true;
+	}
+
+	size_t halfCount() const { return (size_t)width * height * 3; }
+
+	// decode every scanline into dst (width * height * 3 halves, RGB). rows are
+	// written bottom-up when flipVertically is set, like stbi_set_flip_vertically_on_load.
+	void decodeHalf(uint16_t* dst, bool flipVertically) const
+	{
+		bool f16c = cpuHasF16C();
+		if (!fallback.empty())
+		{
+			parallel_for(0, height, [&](int y)
+			{
+				int row = flipVertically ? height - 1 - y : y;
+				floatToHalf(&fallback[(size_t)y * width * 3], dst + (size_t)row * width * 3, width * 3, f16c);
+			});
+			return;
+		}
+		parallel_for(0, height, [&](int y)
+		{
+			std::vector<unsigned char> rgbe(width * 4);
+			std::vector<float> rgb(width * 3 + 8);
+			decodeScanline(y, rgbe.data());
+			rgbeToFloat(rgbe.data(), rgb.data());
+			int row = flipVertically ? height - 1 - y : y;
+			floatToHalf(rgb.data(), dst + (size_t)row * width * 3, width * 3, f16c);
+		});
+	}
+
+private:
+	std::vector<unsigned char> bytes;
+	std::vector<size_t> scanlineOffsets;
+	size_t dataStart = 0;
+	std::vector<float> fallback; // stb_image result when the fast path doesn't apply
+
+	bool parseHeader()
+	{
+		// header lines up to an empty line, then the resolution string
+		size_t pos = 0;
+		std::string line;
+		bool formatOk = false;
+		bool first = true;
+		while (readLine(pos, line))
+		{
+			if (first && line.compare(0, 2, "#?") != 0)
+				return false;
+			first = false;
+			if (line.empty())
+				break;
+			if (line.compare(0, 7, "FORMAT=") == 0)
+				formatOk = line == "FORMAT=32-bit_rle_rgbe";
+		}
+		if (!formatOk || !readLine(pos, line))
+			return false;
+		// only the standard orientation, which is also the only one stb_image accepts
+		if (sscanf(line.c_str(), "-Y %d +X %d", &height, &width) != 2 || width <= 0 || height <= 0)
+			return false;
+		dataStart = pos;
+		return true;
+	}
+
+	bool readLine(size_t& pos, std::string& line) const
+	{
+		line.clear();
+		while (pos < bytes.size() && bytes[pos] != '\n')
+			line += (char)bytes[pos++];
+		if (pos >= bytes.size())
+			return false;
+		++pos; // skip '\n'
+		return true;
+	}
+
+	// RLE scanlines are variable length, so one cheap serial pass records where each
+	// starts; the expensive part (expanding runs and converting) then runs in parallel.
+	bool indexScanlines()
+	{
+		scanlineOffsets.resize(height);
+		size_t pos = dataStart;
+		for (int y = 0; y < height; ++y)
+		{
+			scanlineOffsets[y] = pos;
+			if (pos + 4 > bytes.size())
+				return false;
+			const unsigned char* p = &bytes[pos];
+			bool rle = width >= 8 && width < 32768 && p[0] == 2 && p[1] == 2 && !(p[2] & 0x80);
+			if (!rle)
+			{
+				// flat scanline; old-style run markers are not supported here
+				if (p[0] == 1 && p[1] == 1 && p[2] == 1)
+					return false;
+				pos += (size_t)width * 4;
+				continue;
+			}
+			if (((p[2] << 8) | p[3]) != width)
+				return false;
+			pos += 4;
+			for (int c = 0; c < 4; ++c)
+			{
+				int x = 0;
+				while (x < width)
+				{
+					if (pos >= bytes.size())
+						return false;
+					int count = bytes[pos++];
+					if (count > 128)
+					{
+						count -= 128;
+						pos += 1;
+					}
+					else
+						pos += count;
+					if (count == 0 || x + count > width)
+						return false;
+					x += count;
+				}
+			}
+		}
+		return pos <= bytes.size();
+	}
+
+	void decodeScanline(int y, unsigned char* rgbe) const
+	{
+		const unsigned char* p = &bytes[scanlineOffsets[y]];
+		bool rle = width >= 8 && width < 32768 && p[0] == 2 && p[1] == 2 && !(p[2] & 0x80);
+		if (!rle)
+		{
+			memcpy(rgbe, p, (size_t)width * 4);
+			return;
+		}
+		p += 4;
+		// channels are stored planar within a scanline
+		for (int c = 0; c < 4; ++c)
+		{
+			int x = 0;
+			while (x < width)
+			{
+				int count = *p++;
+				if (count > 128)
+				{
+					count -= 128;
+					unsigned char value = *p++;
+					for (int i = 0; i < count; ++i)
+						rgbe[(x + i) * 4 + c] = value;
+				}
+				else
+				{
+					for (int i = 0; i < count; ++i)
+						rgbe[(x + i) * 4 + c] = *p++;
+				}
+				x += count;
+			}
+		}
+	}
+
+	// same conversion as stb_image's hdr loader: value * 2^(exponent - 136)
+	void rgbeToFloat(const unsigned char* rgbe, float* rgb) const
+	{
+		static const std::vector<float> scale = []()
+		{
+			std::vector<float> table(256);
+			table[0] = 0.0f;
+			for (int e = 1; e < 256; ++e)
+				table[e] = std::ldexp(1.0f, e - (128 + 8));
+			return table;
+		}();
+		for (int x = 0; x < width; ++x)
+		{
+			float f = scale[rgbe[x * 4 + 3]];
+			rgb[x * 3 + 0] = rgbe[x * 4 + 0] * f;
+			rgb[x * 3 + 1] = rgbe[x * 4 + 1] * f;
+			rgb[x * 3 + 2] = rgbe[x * 4 + 2] * f;
+		}
+	}
+
+	static void floatToHalf(const float* src, uint16_t* dst, int count, bool f16c)
+	{
+		int i = 0;
+#ifdef HDR_LOADER_X86
+		if (f16c)
+			i = floatToHalfF16C(src, dst, count);
+#endif
+		for (; i < count; ++i)
+			dst[i] = glm::packHalf1x16(glm::min(src[i], 65504.0f));
+	}
+
+#ifdef HDR_LOADER_X86
+	// converts 8 floats per iteration, returns how many were converted.
+#if !defined(_MSC_VER)
+	__attribute__((target("avx,f16c")))
+#endif
+	static int floatToHalfF16C(const float* src, uint16_t* dst, int count)
+	{
+		const __m256 maxHalf = _mm256_set1_ps(65504.0f);
+		int i = 0;
+		for (; i + 8 <= count; i += 8)
+		{
+			__m256 v = _mm256_min_ps(_mm256_loadu_ps(src + i), maxHalf);
+			_mm_storeu_si128((__m128i*)(dst + i), _mm256_cvtps_ph(v, 0)); // round to nearest even
+		}
+		return i;
+	}
+
+	static bool cpuHasF16C()
+	{
+#ifdef _MSC_VER
+		int info[4];
+		__cpuid(info, 1);
+		// F16C (bit 29) and AVX + OS support for the ymm state (bits 28 and 27)
+		return (info[2] & (1 << 29)) && (info[2] & (1 << 28)) && (info[2] & (1 << 27)) && (_xgetbv(0) & 6) == 6;
+#else
+		unsigned int a, b, c, d;
+		if (!__get_cpuid(1, &a, &b, &c, &d))
+			return false;
+		return (c & bit_F16C) && (c & bit_AVX) && (c & bit_OSXSAVE);
+#endif
+	}
+#else
+	static bool cpuHasF16C() { return false; }
+#endif
+};
+
+#endif
@@ -0,0 +1,270 @@
+#ifndef _IBL_BAKER_H_
+#define _IBL_BAKER_H_
+
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <learnopengl/shader.h>
+
+#include "equirect_lookup.h"
+#include "shader_compiler.h"
+#include "shader_hot_reload.h"
+
+#include <algorithm>
+#include <functional>
+
+// defined in proj03.cpp
+void renderCube();
+
+// how the irradiance map is integrated.
+enum IrradianceMode {
+	// uniform 252 x 63 phi/theta sweep of envCubemap mip 0 (15876 fetches per texel), the reference.
+	IRRADIANCE_UNIFORM,
+	// 256 cosine-weighted Hammersley samples read from the envCubemap mip matching each
+	// sample's solid angle; needs the envCubemap mip chain.
+	IRRADIANCE_IMPORTANCE
+};
+
+// the stages of a bake in the order they run; every one reads the result of the ones
+// before (irradiance and pre-filter only that of downsample).
+enum IBLBakeStage {
+	IBL_BAKE_CONVERT,
+	IBL_BAKE_DOWNSAMPLE,
+	IBL_BAKE_IRRADIANCE,
+	IBL_BAKE_PREFILTER
+};
+
+// sample counts of the Monte Carlo bakes, compiled into the programs (SAMPLE_COUNT of
+// 2.2.1.prefilter.* and 2.2.1.irradiance_importance.*). more is smoother and slower; the
+// compute versions keep the samples in shared memory, so at most 2048.
+struct IBLBakeQuality {
+	unsigned int prefilterSamples = 256;
+	unsigned int irradianceSamples = 256;
+};
+
+// The GPU stages of the IBL precompute. Every call works on a range of
+// cubemap faces so a bake can be split into small pieces (see IBLEnvironment);
+// passing faces 0..5 does a whole stage at once.
+class IBLBaker {
+public:
+	virtual ~IBLBaker() {}
+
+	void setIrradianceMode(IrradianceMode mode) { irradianceMode = mode; }
+	IrradianceMode getIrradianceMode() const { return irradianceMode; }
+	void setEquirectFilter(EquirectFilter filter) { equirectFilter = filter; }
+	EquirectFilter getEquirectFilter() const { return equirectFilter; }
+
+	// true once the programs are built and set up; no stage may run before.
+	virtual bool ready() = 0;
+
+	// reload the programs when their sources change; changed is told the stage whose
+	// program was replaced, so the maps can be baked again from there.
+	virtual void watchShaders(ShaderHotReload& hotReload, const std::function<void(IBLBakeStage)>& changed) = 0;
+
+	// internal format the cubemaps have to be allocated with for this baker.
+	virtual GLenum cubemapFormat() const = 0;
+
+	// convert the HDR equirectangular map into mip 0 of envCubemap through the direction
+	// lookup of size. with EQUIRECT_AREA hdrTexture must have its mip chain.
+	virtual void equirectangularToCubemap(unsigned int hdrTexture, unsigned int envCubemap, unsigned int size,
+		unsigned int firstFace = 0, unsigned int faceCount = 6) = 0;
+	// write mip level of envCubemap (size is the mip 0 size) from level - 1 with a seam-aware,
+	// solid angle weighted 4x4 kernel (2.2.1.downsample.*). call for levels 1, 2, ... in order.
+	virtual void downsample(unsigned int envCubemap, unsigned int size, unsigned int level,
+		unsigned int firstFace = 0, unsigned int faceCount = 6) = 0;
+	// solve the diffuse integral for every texel of irradianceMap.
+	virtual void irradiance(unsigned int envCubemap, unsigned int envSize, unsigned int irradianceMap, unsigned int size,
+		unsigned int firstFace = 0, unsigned int faceCount = 6) = 0;
+	// run the GGX quasi monte-carlo integration for one mip of prefilterMap (size is the mip 0 size).
+	virtual void prefilter(unsigned int envCubemap, unsigned int envSize, unsigned int prefilterMap, unsigned int size,
+		unsigned int mip, unsigned int mipLevels, unsigned int firstFace = 0, unsigned int faceCount = 6) = 0;
+
+protected:
+	IrradianceMode irradianceMode = IRRADIANCE_IMPORTANCE;
+	EquirectFilter equirectFilter = EQUIRECT_AREA;
+	EquirectLookup equirectLookup;
+	// the programs' samplers etc. are set (by ready())
+	bool configured = false;
+
+	// a reloaded program has to be set up again before its stage runs
+	template <typename Program>
+	void watchStage(ShaderHotReload& hotReload, Program& program, IBLBakeStage stage, const std::function<void(IBLBakeStage)>& changed)
+	{
+		hotReload.watch(program, [this, stage, changed]()
+		{
+			configured = false;
+			changed(stage);
+		});
+	}
+};
+
+// The original bake: render a unit cube into each face through a capture FBO.
+class IBLRasterBaker : public IBLBaker {
+public:
+	// with a compiler the programs are built in the background (see ready()).
+	IBLRasterBaker(ShaderCompiler* compiler = nullptr, const IBLBakeQuality& quality = IBLBakeQuality())
+		: equirectangularToCubemapShader("src/2.2.1.cubemap.vs", "src/2.2.1.equirectangular_to_cubemap.fs", nullptr, compiler ? BUILD_LATER : BUILD_NOW),
+		  irradianceShader("src/2.2.1.cubemap.vs", "src/2.2.1.irradiance_convolution.fs", nullptr, compiler ? BUILD_LATER : BUILD_NOW),
+		  irradianceImportanceShader("src/2.2.1.cubemap.vs", "src/2.2.1.irradiance_importance.fs", nullptr, compiler ? BUILD_LATER : BUILD_NOW,
+			ShaderDefines().set("SAMPLE_COUNT", quality.irradianceSamples)),
+		  prefilterShader("src/2.2.1.cubemap.vs", "src/2.2.1.prefilter.fs", nullptr, compiler ? BUILD_LATER : BUILD_NOW,
+			ShaderDefines().set("SAMPLE_COUNT", quality.prefilterSamples)),
+		  downsampleShader("src/2.2.1.cubemap.vs", "src/2.2.1.downsample.fs", nullptr, compiler ? BUILD_LATER : BUILD_NOW)
+	{
+		// pbr: setup framebuffer
+		glGenFramebuffers(1, &captureFBO);
+		glGenRenderbuffers(1, &captureRBO);
+
+		// pbr: set up projection and view matrices for capturing data onto the 6 cubemap face directions
+		captureProjection = glm::perspective(glm::radians(90.0f), 1.0f, 0.1f, 10.0f);
+		captureViews[0] = glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(1.0f,  0.0f,  0.0f), glm::vec3(0.0f, -1.0f,  0.0f));
+		captureViews[1] = glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(-1.0f,  0.0f,  0.0f), glm::vec3(0.0f, -1.0f,  0.0f));
+		captureViews[2] = glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f,  1.0f,  0.0f), glm::vec3(0.0f,  0.0f,  1.0f));
+		captureViews[3] = glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, -1.0f,  0.0f), glm::vec3(0.0f,  0.0f, -1.0f));
+		captureViews[4] = glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f,  0.0f,  1.0f), glm::vec3(0.0f, -1.0f,  0.0f));
+		captureViews[5] = glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f,  0.0f, -1.0f), glm::vec3(0.0f, -1.0f,  0.0f));
+
+		if (compiler)
+		{
+			compiler->compile(equirectangularToCubemapShader);
+			compiler->compile(irradianceShader);
+			compiler->compile(irradianceImportanceShader);
+			compiler->compile(prefilterShader);
+			compiler->compile(downsampleShader);
+		}
+		ready();
+	}
+
+	bool ready()
+	{
+		if (configured)
+			return true;
+		if (!equirectangularToCubemapShader.ready() || !irradianceShader.ready() || !irradianceImportanceShader.ready()
+			|| !prefilterShader.ready() || !downsampleShader.ready())
+			return false;
+		equirectangularToCubemapShader.use();
+		equirectangularToCubemapShader.setInt("equirectangularMap", 0);
+		equirectangularToCubemapShader.setInt("directionLookup", 1);
+		equirectangularToCubemapShader.setMat4("projection", captureProjection);
+		irradianceShader.use();
+		irradianceShader.setInt("environmentMap", 0);
+		irradianceShader.setMat4("projection", captureProjection);
+		irradianceImportanceShader.use();
+		irradianceImportanceShader.setInt("environmentMap", 0);
+		irradianceImportanceShader.setMat4("projection", captureProjection);
+		prefilterShader.use();
+		prefilterShader.setInt("environmentMap", 0);
+		prefilterShader.setMat4("projection", captureProjection);
+		downsampleShader.use();
+		downsampleShader.setInt("environmentMap", 0);
+		downsampleShader.setMat4("projection", captureProjection);
+		configured = true;
+		return true;
+	}
+
+	void watchShaders(ShaderHotReload& hotReload, const std::function<void(IBLBakeStage)>& changed)
+	{
+		watchStage(hotReload, equirectangularToCubemapShader, IBL_BAKE_CONVERT, changed);
+		watchStage(hotReload, downsampleShader, IBL_BAKE_DOWNSAMPLE, changed);
+		watchStage(hotReload, irradianceShader, IBL_BAKE_IRRADIANCE, changed);
+		watchStage(hotReload, irradianceImportanceShader, IBL_BAKE_IRRADIANCE, changed);
+		watchStage(hotReload, prefilterShader, IBL_BAKE_PREFILTER, changed);
+	}
+
+	GLenum cubemapFormat() const { return GL_RGB16F; }
+
+	void equirectangularToCubemap(unsigned int hdrTexture, unsigned int envCubemap, unsigned int size,
+		unsigned int firstFace = 0, unsigned int faceCount = 6)
+	{
+		unsigned int lookup = equirectLookup.texture(size);
+		equirectangularToCubemapShader.use();
+		equirectangularToCubemapShader.setBool("areaFilter", equirectFilter == EQUIRECT_AREA);
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D, hdrTexture);
+		glActiveTexture(GL_TEXTURE1);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, lookup);
+		renderFaces(equirectangularToCubemapShader, envCubemap, size, 0, firstFace, faceCount);
+	}
+
+	void downsample(unsigned int envCubemap, unsigned int size, unsigned int level,
+		unsigned int firstFace = 0, unsigned int faceCount = 6)
+	{
+		// sample only the source level (base level, no mipmapping) while level is attached,
+		// so the pass is not a feedback loop
+		GLint baseLevel, minFilter;
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_CUBE_MAP, envCubemap);
+		glGetTexParameteriv(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_BASE_LEVEL, &baseLevel);
+		glGetTexParameteriv(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, &minFilter);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_BASE_LEVEL, level - 1);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+
+		unsigned int levelSize = std::max(size >> level, 1u);
+		downsampleShader.use();
+		downsampleShader.setFloat("sourceLevel", 0.0f);
+		downsampleShader.setInt("faceSize", levelSize);
+		renderFaces(downsampleShader, envCubemap, levelSize, level, firstFace, faceCount);
+
+		glBindTexture(GL_TEXTURE_CUBE_MAP, envCubemap);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_BASE_LEVEL, baseLevel);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, minFilter);
+	}
+
+	void irradiance(unsigned int envCubemap, unsigned int envSize, unsigned int irradianceMap, unsigned int size,
+		unsigned int firstFace = 0, unsigned int faceCount = 6)
+	{
+		Shader& shader = irradianceMode == IRRADIANCE_IMPORTANCE ? irradianceImportanceShader : irradianceShader;
+		shader.use();
+		shader.setFloat("envResolution", (float)envSize);
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_CUBE_MAP, envCubemap);
+		renderFaces(shader, irradianceMap, size, 0, firstFace, faceCount);
+	}
+
+	void prefilter(unsigned int envCubemap, unsigned int envSize, unsigned int prefilterMap, unsigned int size,
+		unsigned int mip, unsigned int mipLevels, unsigned int firstFace = 0, unsigned int faceCount = 6)
+	{
+		prefilterShader.use();
+		prefilterShader.setFloat("envResolution", (float)envSize);
+		float roughness = (float)mip / (float)(mipLevels - 1);
+		prefilterShader.setFloat("roughness", roughness);
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_CUBE_MAP, envCubemap);
+		renderFaces(prefilterShader, prefilterMap, size >> mip, mip, firstFace, faceCount);
+	}
+
+private:
+	Shader equirectangularToCubemapShader;
+	Shader irradianceShader;
+	Shader irradianceImportanceShader;
+	Shader prefilterShader;
+	Shader downsampleShader;
+	unsigned int captureFBO;
+	unsigned int captureRBO;
+	glm::mat4 captureProjection;
+	glm::mat4 captureViews[6];
+
+	void renderFaces(Shader& shader, unsigned int cubemap, unsigned int size, unsigned int mip, unsigned int firstFace, unsigned int faceCount)
+	{
+		// resize framebuffer according to the target size.
+		glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
+		glBindRenderbuffer(GL_RENDERBUFFER, captureRBO);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, size, size);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, captureRBO);
+		glViewport(0, 0, size, size); // don't forget to configure the viewport to the capture dimensions.
+		for (unsigned int i = firstFace; i < firstFace + faceCount; ++i)
+		{
+			shader.setMat4("view", captureViews[i]);
+			shader.setInt("face", i);
+			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, cubemap, mip);
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+			renderCube();
+		}
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	}
+};
+
+#endif
@@ -0,0 +1,178 @@
+#ifndef _IBL_CACHE_H_
+#define _IBL_CACHE_H_
+
+#pragma once
+
+#include <GL/glew.h>
+
+#include <learnopengl/hash.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <future>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// On-disk cache of baked cubemaps (resources/cache). A file is a 4 character magic, a
+// few uint32 header words describing the layout, then the texels as RGB half floats:
+// every level (largest first) as its six faces, the order glGetTexImage writes them in
+// and glTexSubImage3D on a cubemap array reads them in. Files are named by a hash of
+// everything the bake depends on, so a stale entry is never found instead of replaced.
+
+// resources/cache/<prefix>_<FNV-1a of key>.bin
+inline std::string iblCachePath(const char* prefix, const std::string& key)
+{
+	uint64_t hash = fnv1aHash(key.data(), key.size());
+	char name[96];
+	snprintf(name, sizeof(name), "resources/cache/%s_%016llx.bin", prefix, (unsigned long long)hash);
+	return name;
+}
+
+// halves of a size x size cube with the given levels.
+inline size_t iblCacheHalfCount(unsigned int size, unsigned int levels)
+{
+	size_t count = 0;
+	for (unsigned int level = 0; level < levels; ++level)
+	{
+		size_t levelSize = std::max(size >> level, 1u);
+		count += levelSize * levelSize * 6 * 3;
+	}
+	return count;
+}
+
+// reads a cache file into halves (which has to be sized already). false if the file is
+// missing, truncated or was written for another magic/header.
+inline bool iblReadCache(const std::string& path, const char* magic, const std::vector<uint32_t>& header, std::vector<uint16_t>& halves)
+{
+	FILE* file = fopen(path.c_str(), "rb");
+	if (!file)
+		return false;
+	char fileMagic[4];
+	std::vector<uint32_t> fileHeader(header.size());
+	bool ok = fread(fileMagic, 1, 4, file) == 4 && memcmp(fileMagic, magic, 4) == 0
+		&& fread(fileHeader.data(), sizeof(uint32_t), fileHeader.size(), file) == fileHeader.size() && fileHeader == header
+		&& fread(halves.data(), sizeof(uint16_t), halves.size(), file) == halves.size();
+	fclose(file);
+	return ok;
+}
+
+// Writes cubemaps to the cache without stalling: write() queues a readback of the texture
+// into a pixel pack buffer, poll() (once per frame) maps the ones the GPU has finished and
+// hands the file writes to worker threads.
+class IBLCacheWriter {
+public:
+	// levels 0..levels-1 of a size x size cubemap.
+	void write(const std::string& path, const char* magic, const std::vector<uint32_t>& header,
+		unsigned int cubemap, unsigned int size, unsigned int levels)
+	{
+		PendingWrite write;
+		write.path = path;
+		memcpy(write.magic, magic, 4);
+		write.header = header;
+		write.bytes = iblCacheHalfCount(size, levels) * sizeof(uint16_t);
+		glGenBuffers(1, &write.pbo);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, write.pbo);
+		glBufferData(GL_PIXEL_PACK_BUFFER, write.bytes, nullptr, GL_STREAM_READ);
+		glPixelStorei(GL_PACK_ALIGNMENT, 2); // rows are size * 6 bytes
+		glBindTexture(GL_TEXTURE_CUBE_MAP, cubemap);
+		size_t offset = 0;
+		for (unsigned int level = 0; level < levels; ++level)
+			for (unsigned int face = 0; face < 6; ++face)
+			{
+				glGetTexImage(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, level, GL_RGB, GL_HALF_FLOAT, (void*)offset);
+				size_t levelSize = std::max(size >> level, 1u);
+				offset += levelSize * levelSize * 3 * sizeof(uint16_t);
+			}
+		glPixelStorei(GL_PACK_ALIGNMENT, 4);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		write.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		writes.push_back(std::move(write));
+	}
+
+	void poll()
+	{
+		size_t kept = 0;
+		for (size_t i = 0; i < writes.size(); ++i)
+		{
+			PendingWrite& write = writes[i];
+			if (write.fence && glClientWaitSync(write.fence, 0, 0) != GL_TIMEOUT_EXPIRED)
+				startFileWrite(write);
+			bool finished = !write.fence
+				&& (!write.written.valid() || write.written.wait_for(std::chrono::seconds(0)) == std::future_status::ready);
+			if (!finished)
+			{
+				if (kept != i)
+					writes[kept] = std::move(write);
+				++kept;
+			}
+		}
+		writes.resize(kept);
+	}
+
+	// block until the queued files are written.
+	void wait()
+	{
+		for (size_t i = 0; i < writes.size(); ++i)
+		{
+			if (writes[i].fence)
+			{
+				glClientWaitSync(writes[i].fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+				startFileWrite(writes[i]);
+			}
+			if (writes[i].written.valid())
+				writes[i].written.wait();
+		}
+		writes.clear();
+	}
+
+private:
+	struct PendingWrite {
+		std::string path;
+		char magic[4];
+		std::vector<uint32_t> header;
+		unsigned int pbo = 0;
+		GLsync fence = 0;
+		size_t bytes = 0;
+		std::future<void> written;
+	};
+	std::vector<PendingWrite> writes;
+
+	void startFileWrite(PendingWrite& write)
+	{
+		glDeleteSync(write.fence);
+		write.fence = 0;
+		std::vector<uint16_t> halves(write.bytes / sizeof(uint16_t));
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, write.pbo);
+		const void* mapped = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, write.bytes, GL_MAP_READ_BIT);
+		if (mapped)
+			memcpy(halves.data(), mapped, write.bytes);
+		glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		glDeleteBuffers(1, &write.pbo);
+		write.pbo = 0;
+		if (!mapped)
+			return;
+
+		std::string path = write.path;
+		std::string magic(write.magic, 4);
+		std::vector<uint32_t> header = write.header;
+		write.written = std::async(std::launch::async, [path, magic, header, halves]()
+		{
+			FILE* file = fopen(path.c_str(), "wb");
+			bool ok = file
+				&& fwrite(magic.data(), 1, 4, file) == 4
+				&& fwrite(header.data(), sizeof(uint32_t), header.size(), file) == header.size()
+				&& fwrite(halves.data(), sizeof(uint16_t), halves.size(), file) == halves.size();
+			if (file)
+				fclose(file);
+			if (!ok)
+				std::cout << "Failed to write IBL cache file " << path << std::endl;
+		});
+	}
+};
+
+#endif
@@ -0,0 +1,149 @@
+#ifndef _IBL_COMPUTE_H_
+#define _IBL_COMPUTE_H_
+
+#pragma once
+
+#include <GL/glew.h>
+#include <learnopengl/shader_c.h>
+
+#include "ibl_baker.h"
+
+// Compute shader version of the IBL precompute. Every stage writes the cubemap
+// faces through imageStore instead of rasterizing renderCube() into the capture
+// FBO; a single dispatch covers all requested faces of a mip (the face is
+// faceOffset + gl_GlobalInvocationID.z). Requires a 4.3 context and GL_RGBA16F
+// cubemaps (image load/store has no three channel formats).
+class IBLComputeBaker : public IBLBaker {
+public:
+	// with a compiler the programs are built in the background (see ready()).
+	IBLComputeBaker(ShaderCompiler* compiler = nullptr, const IBLBakeQuality& quality = IBLBakeQuality())
+		: equirectangularToCubemapShader("src/2.2.1.equirectangular_to_cubemap.cs", compiler ? BUILD_LATER : BUILD_NOW),
+		  irradianceShader("src/2.2.1.irradiance_convolution.cs", compiler ? BUILD_LATER : BUILD_NOW),
+		  irradianceImportanceShader("src/2.2.1.irradiance_importance.cs", compiler ? BUILD_LATER : BUILD_NOW,
+			ShaderDefines().set("SAMPLE_COUNT", std::min(quality.irradianceSamples, 2048u))),
+		  prefilterShader("src/2.2.1.prefilter.cs", compiler ? BUILD_LATER : BUILD_NOW,
+			ShaderDefines().set("SAMPLE_COUNT", std::min(quality.prefilterSamples, 2048u))),
+		  downsampleShader("src/2.2.1.downsample.cs", compiler ? BUILD_LATER : BUILD_NOW)
+	{
+		if (compiler)
+		{
+			compiler->compile(equirectangularToCubemapShader);
+			compiler->compile(irradianceShader);
+			compiler->compile(irradianceImportanceShader);
+			compiler->compile(prefilterShader);
+			compiler->compile(downsampleShader);
+		}
+		ready();
+	}
+
+	bool ready()
+	{
+		if (configured)
+			return true;
+		if (!equirectangularToCubemapShader.ready() || !irradianceShader.ready() || !irradianceImportanceShader.ready()
+			|| !prefilterShader.ready() || !downsampleShader.ready())
+			return false;
+		equirectangularToCubemapShader.use();
+		equirectangularToCubemapShader.setInt("equirectangularMap", 0);
+		equirectangularToCubemapShader.setInt("directionLookup", 1);
+		irradianceShader.use();
+		irradianceShader.setInt("environmentMap", 0);
+		irradianceImportanceShader.use();
+		irradianceImportanceShader.setInt("environmentMap", 0);
+		prefilterShader.use();
+		prefilterShader.setInt("environmentMap", 0);
+		downsampleShader.use();
+		downsampleShader.setInt("environmentMap", 0);
+		configured = true;
+		return true;
+	}
+
+	void watchShaders(ShaderHotReload& hotReload, const std::function<void(IBLBakeStage)>& changed)
+	{
+		watchStage(hotReload, equirectangularToCubemapShader, IBL_BAKE_CONVERT, changed);
+		watchStage(hotReload, downsampleShader, IBL_BAKE_DOWNSAMPLE, changed);
+		watchStage(hotReload, irradianceShader, IBL_BAKE_IRRADIANCE, changed);
+		watchStage(hotReload, irradianceImportanceShader, IBL_BAKE_IRRADIANCE, changed);
+		watchStage(hotReload, prefilterShader, IBL_BAKE_PREFILTER, changed);
+	}
+
+	GLenum cubemapFormat() const { return GL_RGBA16F; }
+
+	void equirectangularToCubemap(unsigned int hdrTexture, unsigned int envCubemap, unsigned int size,
+		unsigned int firstFace = 0, unsigned int faceCount = 6)
+	{
+		unsigned int lookup = equirectLookup.texture(size);
+		equirectangularToCubemapShader.use();
+		equirectangularToCubemapShader.setInt("faceSize", size);
+		equirectangularToCubemapShader.setBool("areaFilter", equirectFilter == EQUIRECT_AREA);
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D, hdrTexture);
+		glActiveTexture(GL_TEXTURE1);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, lookup);
+		glBindImageTexture(0, envCubemap, 0, GL_TRUE, 0, GL_WRITE_ONLY, GL_RGBA16F);
+		dispatchFaces(equirectangularToCubemapShader, size, firstFace, faceCount);
+	}
+
+	void downsample(unsigned int envCubemap, unsigned int size, unsigned int level,
+		unsigned int firstFace = 0, unsigned int faceCount = 6)
+	{
+		// reads level - 1 through the sampler while level is written as an image
+		unsigned int levelSize = std::max(size >> level, 1u);
+		downsampleShader.use();
+		downsampleShader.setFloat("sourceLevel", (float)(level - 1));
+		downsampleShader.setInt("faceSize", levelSize);
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_CUBE_MAP, envCubemap);
+		glBindImageTexture(0, envCubemap, level, GL_TRUE, 0, GL_WRITE_ONLY, GL_RGBA16F);
+		dispatchFaces(downsampleShader, levelSize, firstFace, faceCount);
+	}
+
+	void irradiance(unsigned int envCubemap, unsigned int envSize, unsigned int irradianceMap, unsigned int size,
+		unsigned int firstFace = 0, unsigned int faceCount = 6)
+	{
+		ComputeShader& shader = irradianceMode == IRRADIANCE_IMPORTANCE ? irradianceImportanceShader : irradianceShader;
+		shader.use();
+		shader.setInt("faceSize", size);
+		shader.setFloat("envResolution", (float)envSize);
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_CUBE_MAP, envCubemap);
+		glBindImageTexture(0, irradianceMap, 0, GL_TRUE, 0, GL_WRITE_ONLY, GL_RGBA16F);
+		dispatchFaces(shader, size, firstFace, faceCount);
+	}
+
+	void prefilter(unsigned int envCubemap, unsigned int envSize, unsigned int prefilterMap, unsigned int size,
+		unsigned int mip, unsigned int mipLevels, unsigned int firstFace = 0, unsigned int faceCount = 6)
+	{
+		unsigned int mipSize = size >> mip;
+		float roughness = (float)mip / (float)(mipLevels - 1);
+		prefilterShader.use();
+		prefilterShader.setFloat("envResolution", (float)envSize);
+		prefilterShader.setFloat("roughness", roughness);
+		prefilterShader.setInt("faceSize", mipSize);
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_CUBE_MAP, envCubemap);
+		glBindImageTexture(0, prefilterMap, mip, GL_TRUE, 0, GL_WRITE_ONLY, GL_RGBA16F);
+		dispatchFaces(prefilterShader, mipSize, firstFace, faceCount);
+	}
+
+private:
+	ComputeShader equirectangularToCubemapShader;
+	ComputeShader irradianceShader;
+	ComputeShader irradianceImportanceShader;
+	ComputeShader prefilterShader;
+	ComputeShader downsampleShader;
+
+	// all IBL compute shaders use 8x8 work groups
+	static const unsigned int GROUP_SIZE = 8;
+
+	void dispatchFaces(ComputeShader& shader, unsigned int size, unsigned int firstFace, unsigned int faceCount)
+	{
+		shader.setInt("faceOffset", firstFace);
+		unsigned int groups = (size + GROUP_SIZE - 1) / GROUP_SIZE;
+		glDispatchCompute(groups, groups, faceCount);
+		// make the written texels visible to the texture fetches of the next stage (and mipmap generation).
+		glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_UPDATE_BARRIER_BIT);
+	}
+};
+
+#endif
@@ -0,0 +1,640 @@
+#ifndef _IBL_ENVIRONMENT_H_
+#define _IBL_ENVIRONMENT_H_
+
+#pragma once
+
+#include <GL/glew.h>
+
+#include "ibl_baker.h"
+#include "hdr_loader.h"
+#include "ibl_cache.h"
+#include "ibl_storage.h"
+
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <future>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+const char ENV_CACHE_MAGIC[] = "ENVC";
+
+// The active IBL environment (envCubemap, irradianceMap, prefilterMap) with
+// runtime switching that never stalls a frame:
+//  1. the .hdr file is read and decoded to half floats on worker threads, the
+//     decode writing straight into a mapped pixel unpack buffer. the converted
+//     envCubemap is kept in the IBL cache (ibl_cache.h), so a file converted
+//     before skips the decode and the conversion and only uploads its faces;
+//  2. the bake is split into small steps (one cubemap face of one stage / mip)
+//     and update() runs only as many as fit the per-frame GPU budget, using
+//     GL_TIME_ELAPSED queries from earlier frames to estimate each step's cost;
+//  3. the baked maps are stored in the configured IBLStorage formats (BC6H is
+//     compressed on a worker thread from an asynchronous readback);
+//  4. the previous maps stay current until the new set is complete, then they
+//     are swapped and the old textures deleted.
+// rebake() runs the bake of the current file again from one stage on, when a bake
+// program was reloaded (see IBLBaker::watchShaders).
+// Call update() once per frame before rendering.
+class IBLEnvironment {
+public:
+	IBLEnvironment(IBLBaker& baker, unsigned int envSize = 512, unsigned int irradianceSize = 32,
+		unsigned int prefilterSize = 128, unsigned int prefilterMips = 5)
+		: baker(baker), envSize(envSize), irradianceSize(irradianceSize),
+		  prefilterSize(prefilterSize), prefilterMips(prefilterMips)
+	{
+	}
+	~IBLEnvironment()
+	{
+		wait();
+	}
+
+	// storage of the maps baked from now on (the current set is not converted).
+	void setStorage(const IBLStorage& settings)
+	{
+		storage = settings;
+		if (storage.environment == IBL_STORAGE_BC6H || storage.irradiance == IBL_STORAGE_BC6H || storage.prefilter == IBL_STORAGE_BC6H)
+		{
+			if (!iblBC6HSupported())
+			{
+				std::cout << "BC6H is not supported, storing the IBL maps as R11G11B10F instead." << std::endl;
+				if (storage.environment == IBL_STORAGE_BC6H)
+					storage.environment = IBL_STORAGE_R11G11B10F;
+				if (storage.irradiance == IBL_STORAGE_BC6H)
+					storage.irradiance = IBL_STORAGE_R11G11B10F;
+				if (storage.prefilter == IBL_STORAGE_BC6H)
+					storage.prefilter = IBL_STORAGE_R11G11B10F;
+			}
+		}
+	}
+
+	// print the error and memory of the stored maps against the baked RGB16F ones
+	// the next time a set is completed (reads back, debugging only).
+	void requestStorageReport()
+	{
+		storageReportRequested = true;
+	}
+
+	// start switching to the given .hdr file. if a switch is already in progress
+	// the path is queued and picked up once that one is done (only the latest is kept).
+	void load(const std::string& path)
+	{
+		pendingPath = path;
+	}
+
+	// keep the working envCubemap (the RGB16F one with its mips) of the current set, so a
+	// rebake() of the irradiance or pre-filter stage can read it instead of starting over
+	// from the file. costs its memory in addition to the stored maps; set before load().
+	void setKeepBakeSource(bool keep)
+	{
+		keepBakeSource = keep;
+	}
+
+	// bake the current file again from stage on (its program changed). the maps of the
+	// other stages are kept: irradiance and pre-filter redo only themselves when the bake
+	// source is kept, downsample starts from the cached envCubemap, and convert decodes
+	// the file again. during a switch the switch is done again once it is finished.
+	void rebake(IBLBakeStage stage)
+	{
+		if (stage == IBL_BAKE_CONVERT)
+			envCacheStale = true;
+		if (!rebakePending || stage < rebakeStage)
+			rebakeStage = stage;
+		rebakePending = true;
+	}
+
+	// advance the current switch, spending roughly budgetMs of GPU time on bake steps.
+	void update(float budgetMs)
+	{
+		collectTimings();
+		cacheWriter.poll();
+		if (state == IDLE && rebakePending)
+			startRebake();
+		if (state == IDLE && !pendingPath.empty())
+			startLoading();
+		if (state == OPENING && isReady(openTask))
+			startDecoding();
+		else if (state == DECODING && isReady(decodeTask))
+			uploadAndPlan();
+		else if (state == BAKING && baker.ready())
+			bake(budgetMs);
+		else if (state == STORING)
+			store();
+	}
+
+	// block until no worker thread is touching the mapped upload buffer
+	// (call before the GL context is destroyed).
+	void wait()
+	{
+		if (openTask.valid())
+			openTask.wait();
+		if (decodeTask.valid())
+			decodeTask.wait();
+		for (int i = 0; i < 3; ++i)
+			bc6hJobs[i].wait();
+		cacheWriter.wait();
+	}
+
+	bool busy() const { return state != IDLE || !pendingPath.empty() || rebakePending; }
+
+	unsigned int envResolution() const { return envSize; }
+	unsigned int irradianceResolution() const { return irradianceSize; }
+	unsigned int prefilterLevels() const { return prefilterMips; }
+
+	// 0 until the first environment has been baked.
+	unsigned int envCubemap() const { return current.envCubemap.texture; }
+	// the file the current maps were baked from, empty until the first bake.
+	const std::string& currentPath() const { return currentFile; }
+	unsigned int irradianceMap() const { return current.irradianceMap.texture; }
+	// a GL_TEXTURE_2D in the octahedral layout if prefilterOctahedral(), else a cubemap.
+	unsigned int prefilterMap() const { return current.prefilterMap.texture; }
+	bool prefilterOctahedral() const { return current.prefilterMap.target == GL_TEXTURE_2D; }
+
+	// (nominal) video memory of the current maps (and the kept bake source).
+	size_t memoryBytes() const
+	{
+		size_t bytes = iblMapBytes(current.envCubemap) + iblMapBytes(current.irradianceMap) + iblMapBytes(current.prefilterMap);
+		if (bakeSource.texture && bakeSource.texture != current.envCubemap.texture)
+			bytes += iblMapBytes(bakeSource);
+		return bytes;
+	}
+
+private:
+	enum State { IDLE, OPENING, DECODING, BAKING, STORING };
+
+	struct Maps {
+		IBLStoredMap envCubemap;
+		IBLStoredMap irradianceMap;
+		IBLStoredMap prefilterMap;
+	};
+	struct Step {
+		IBLBakeStage stage;
+		unsigned int mip;
+		unsigned int face;
+	};
+	struct PendingQuery {
+		unsigned int query;
+		int kind;
+	};
+
+	IBLBaker& baker;
+	unsigned int envSize;
+	unsigned int irradianceSize;
+	unsigned int prefilterSize;
+	unsigned int prefilterMips;
+
+	State state = IDLE;
+	std::string pendingPath;
+	std::string loadingPath;
+	Maps current;
+	std::string currentFile;
+	Maps next;   // the working maps being baked
+	Maps stored; // next converted to the storage formats
+	IBLStoredMap bakeSource; // working envCubemap of current, if kept
+
+	// rebake
+	bool keepBakeSource = false;
+	bool rebakePending = false;
+	IBLBakeStage rebakeStage = IBL_BAKE_CONVERT;
+	bool partialBake = false;  // only rebakeStage, from bakeSource
+	bool envCacheStale = false; // the convert program changed since the env cache was written
+
+	// loading
+	std::shared_ptr<HDRFile> hdrFile;
+	std::future<bool> openTask;
+	std::string envCachePath;
+	std::shared_ptr<std::vector<uint16_t>> cachedFaces; // envCubemap mip 0 if it was in the cache
+	IBLCacheWriter cacheWriter;
+	std::future<void> decodeTask;
+	unsigned int uploadPBO = 0;
+	unsigned int hdrTexture = 0;
+
+	// baking
+	std::deque<Step> steps;
+	std::map<int, double> stepCostMs; // moving average GPU time per step kind
+	std::vector<PendingQuery> pendingQueries;
+	std::vector<unsigned int> freeQueries;
+
+	// storing
+	IBLStorage storage;
+	IBLStorageConverter converter;
+	IBLBC6HJob bc6hJobs[3];
+	bool storing[3] = { false, false, false }; // the maps of stored converted this time
+	std::vector<unsigned int> intermediates; // textures only needed until the stored set is done
+	bool storageReportRequested = false;
+
+	template<typename T>
+	static bool isReady(const std::future<T>& task)
+	{
+		return task.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+	}
+
+	void startLoading()
+	{
+		loadingPath = pendingPath;
+		pendingPath.clear();
+		hdrFile = std::make_shared<HDRFile>();
+		std::shared_ptr<HDRFile> file = hdrFile;
+		std::string path = loadingPath;
+		envCachePath = cachePath(path);
+		cachedFaces = std::make_shared<std::vector<uint16_t>>();
+		std::shared_ptr<std::vector<uint16_t>> cached = cachedFaces;
+		std::string cacheFile = envCachePath;
+		unsigned int size = envSize;
+		bool readCache = !envCacheStale;
+		envCacheStale = false;
+		openTask = std::async(std::launch::async, [file, path, cached, cacheFile, size, readCache]()
+		{
+			cached->resize(iblCacheHalfCount(size, 1));
+			if (readCache && iblReadCache(cacheFile, ENV_CACHE_MAGIC, { size, 1 }, *cached))
+				return true;
+			cached->clear();
+			return file->open(path.c_str());
+		});
+		state = OPENING;
+	}
+
+	// everything the converted envCubemap depends on: the file (by path, size and
+	// modification time), the face size and the conversion filter.
+	std::string cachePath(const std::string& path) const
+	{
+		struct stat info;
+		std::ostringstream key;
+		key << path << ',' << envSize << ',' << baker.getEquirectFilter();
+		if (stat(path.c_str(), &info) == 0)
+			key << ',' << (long long)info.st_size << ',' << (long long)info.st_mtime;
+		return iblCachePath("env", key.str());
+	}
+
+	void startDecoding()
+	{
+		if (!openTask.get())
+		{
+			std::cout << "Failed to load HDR image " << loadingPath << std::endl;
+			hdrFile.reset();
+			state = IDLE;
+			return;
+		}
+		if (!cachedFaces->empty())
+		{
+			uploadCached();
+			return;
+		}
+		// the buffer has to be mapped here (GL thread); the worker only writes into it
+		GLsizeiptr size = (GLsizeiptr)(hdrFile->halfCount() * sizeof(uint16_t));
+		glGenBuffers(1, &uploadPBO);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, uploadPBO);
+		glBufferData(GL_PIXEL_UNPACK_BUFFER, size, nullptr, GL_STREAM_DRAW);
+		uint16_t* dst = (uint16_t*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		if (!dst)
+		{
+			std::cout << "Failed to map the HDR upload buffer." << std::endl;
+			glDeleteBuffers(1, &uploadPBO);
+			uploadPBO = 0;
+			hdrFile.reset();
+			state = IDLE;
+			return;
+		}
+		std::shared_ptr<HDRFile> file = hdrFile;
+		decodeTask = std::async(std::launch::async, [file, dst]() { file->decodeHalf(dst, true); });
+		state = DECODING;
+	}
+
+	void uploadAndPlan()
+	{
+		decodeTask.get();
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, uploadPBO);
+		glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+		glGenTextures(1, &hdrTexture);
+		glBindTexture(GL_TEXTURE_2D, hdrTexture);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 2); // rows are width * 6 bytes
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, hdrFile->width, hdrFile->height, 0, GL_RGB, GL_HALF_FLOAT, 0);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		// longitude wraps around; the area filter reads the panorama's mips
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		if (baker.getEquirectFilter() == EQUIRECT_AREA)
+		{
+			glGenerateMipmap(GL_TEXTURE_2D);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		}
+		else
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glDeleteBuffers(1, &uploadPBO);
+		uploadPBO = 0;
+		hdrFile.reset();
+
+		allocateMaps();
+		plan(IBL_BAKE_CONVERT);
+	}
+
+	// cache hit: mip 0 of envCubemap comes from the file, the bake starts at the mipmaps.
+	void uploadCached()
+	{
+		hdrFile.reset();
+		allocateMaps();
+		glBindTexture(GL_TEXTURE_CUBE_MAP, next.envCubemap.texture);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 2);
+		size_t faceHalves = (size_t)envSize * envSize * 3;
+		for (unsigned int i = 0; i < 6; ++i)
+			glTexSubImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, 0, 0, envSize, envSize, GL_RGB, GL_HALF_FLOAT, &(*cachedFaces)[i * faceHalves]);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		cachedFaces.reset();
+		plan(IBL_BAKE_DOWNSAMPLE);
+	}
+
+	// irradiance or pre-filter only, reading bakeSource; the rest goes through load().
+	void startRebake()
+	{
+		rebakePending = false;
+		if (currentFile.empty() && loadingPath.empty())
+			return; // nothing baked or being baked yet
+		if (!pendingPath.empty())
+			return; // a switch is queued, it bakes everything anyway
+		bool partial = (rebakeStage == IBL_BAKE_IRRADIANCE || rebakeStage == IBL_BAKE_PREFILTER) && bakeSource.texture != 0;
+		if (!partial)
+		{
+			load(currentFile.empty() ? loadingPath : currentFile);
+			return;
+		}
+		loadingPath = currentFile;
+		partialBake = true;
+		next = current;
+		next.envCubemap = bakeSource;
+		if (rebakeStage == IBL_BAKE_IRRADIANCE)
+			next.irradianceMap = iblAllocateMap(GL_TEXTURE_CUBE_MAP, baker.cubemapFormat(), irradianceSize, 1);
+		else
+			next.prefilterMap = iblAllocateMap(GL_TEXTURE_CUBE_MAP, baker.cubemapFormat(), prefilterSize, prefilterMips);
+		plan(rebakeStage);
+	}
+
+	void allocateMaps()
+	{
+		unsigned int envLevels = 1;
+		while ((envSize >> envLevels) > 0)
+			++envLevels;
+		next.envCubemap = iblAllocateMap(GL_TEXTURE_CUBE_MAP, baker.cubemapFormat(), envSize, envLevels);
+		next.irradianceMap = iblAllocateMap(GL_TEXTURE_CUBE_MAP, baker.cubemapFormat(), irradianceSize, 1);
+		next.prefilterMap = iblAllocateMap(GL_TEXTURE_CUBE_MAP, baker.cubemapFormat(), prefilterSize, prefilterMips);
+	}
+
+	// the steps of the stages from first on (of first only in a partial bake).
+	void plan(IBLBakeStage first)
+	{
+		steps.clear();
+		if (first == IBL_BAKE_CONVERT)
+			for (unsigned int i = 0; i < 6; ++i)
+				steps.push_back({ IBL_BAKE_CONVERT, 0, i });
+		if (first <= IBL_BAKE_DOWNSAMPLE)
+			for (unsigned int level = 1; level < next.envCubemap.levels; ++level)
+				steps.push_back({ IBL_BAKE_DOWNSAMPLE, level, 0 });
+		if (first <= IBL_BAKE_IRRADIANCE && !(partialBake && first != IBL_BAKE_IRRADIANCE))
+			for (unsigned int i = 0; i < 6; ++i)
+				steps.push_back({ IBL_BAKE_IRRADIANCE, 0, i });
+		if (first <= IBL_BAKE_PREFILTER && !(partialBake && first != IBL_BAKE_PREFILTER))
+			for (unsigned int mip = 0; mip < prefilterMips; ++mip)
+				for (unsigned int i = 0; i < 6; ++i)
+					steps.push_back({ IBL_BAKE_PREFILTER, mip, i });
+		state = BAKING;
+	}
+
+	void bake(float budgetMs)
+	{
+		GLint viewport[4];
+		glGetIntegerv(GL_VIEWPORT, viewport);
+
+		// always make progress, then keep going while the estimated cost fits
+		double spentMs = 0.0;
+		do
+		{
+			Step step = steps.front();
+			steps.pop_front();
+			spentMs += estimateMs(step, budgetMs);
+			runStep(step);
+		} while (!steps.empty() && spentMs + estimateMs(steps.front(), budgetMs) <= budgetMs);
+
+		glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+
+		if (steps.empty())
+		{
+			// every step is issued; anything reading the new maps from now on is ordered after them.
+			glDeleteTextures(1, &hdrTexture);
+			hdrTexture = 0;
+			startStoring();
+			state = STORING;
+			store();
+		}
+	}
+
+	void startStoring()
+	{
+		stored = next;
+		intermediates.clear();
+		storing[0] = !partialBake;
+		storing[1] = !partialBake || rebakeStage == IBL_BAKE_IRRADIANCE;
+		storing[2] = !partialBake || rebakeStage == IBL_BAKE_PREFILTER;
+		if (partialBake)
+		{
+			// the maps that were not baked again are current's, already stored
+			stored.envCubemap = current.envCubemap;
+			if (rebakeStage == IBL_BAKE_IRRADIANCE)
+				storeMap(1, stored.irradianceMap, storage.irradiance);
+			else
+				storePrefilter();
+			return;
+		}
+		storeMap(0, stored.envCubemap, storage.environment);
+		storeMap(1, stored.irradianceMap, storage.irradiance);
+		storePrefilter();
+	}
+
+	void storePrefilter()
+	{
+		// the octahedral map is not a working map: storeMap and store() free it once
+		// it is compressed or blitted, and with RGB16F it is the stored map itself
+		if (storage.octahedralPrefilter)
+			stored.prefilterMap = converter.toOctahedral(next.prefilterMap);
+		storeMap(2, stored.prefilterMap, storage.prefilter);
+	}
+
+	// RGB16F keeps the 16-bit float map as it is, R11G11B10F is blitted right away
+	// and BC6H goes through bc6hJobs[job].
+	void storeMap(int job, IBLStoredMap& map, IBLStorageFormat format)
+	{
+		if (format == IBL_STORAGE_BC6H)
+			bc6hJobs[job].start(map);
+		else if (format == IBL_STORAGE_R11G11B10F)
+		{
+			IBLStoredMap copy = converter.copyAs(map, GL_R11F_G11F_B10F);
+			if (!isWorkingMap(map.texture))
+				intermediates.push_back(map.texture);
+			map = copy;
+		}
+	}
+
+	// swaps in the stored set once the BC6H jobs (if any) have finished.
+	void store()
+	{
+		IBLStoredMap* maps[3] = { &stored.envCubemap, &stored.irradianceMap, &stored.prefilterMap };
+		IBLStorageFormat formats[3] = { storage.environment, storage.irradiance, storage.prefilter };
+		bool done = true;
+		for (int i = 0; i < 3; ++i)
+		{
+			if (!storing[i] || formats[i] != IBL_STORAGE_BC6H)
+				continue;
+			if (!bc6hJobs[i].poll())
+				done = false;
+		}
+		if (!done)
+			return;
+		for (int i = 0; i < 3; ++i)
+		{
+			if (!storing[i] || formats[i] != IBL_STORAGE_BC6H)
+				continue;
+			if (!isWorkingMap(maps[i]->texture))
+				intermediates.push_back(maps[i]->texture);
+			*maps[i] = bc6hJobs[i].result;
+		}
+
+		if (storageReportRequested)
+		{
+			std::cout << "IBL storage of " << loadingPath << ":" << std::endl;
+			reportIBLStorageError("environment", next.envCubemap, stored.envCubemap);
+			reportIBLStorageError("irradiance ", next.irradianceMap, stored.irradianceMap);
+			reportIBLStorageError("prefilter  ", next.prefilterMap, stored.prefilterMap);
+			storageReportRequested = false;
+		}
+
+		// the working maps the stored set doesn't reuse (but the kept bake source), and the
+		// conversion steps in between
+		IBLStoredMap working[3] = { next.envCubemap, next.irradianceMap, next.prefilterMap };
+		for (int i = keepBakeSource ? 1 : 0; i < 3; ++i)
+			if (working[i].texture != maps[0]->texture && working[i].texture != maps[1]->texture && working[i].texture != maps[2]->texture)
+				intermediates.push_back(working[i].texture);
+		if (!intermediates.empty())
+			glDeleteTextures((GLsizei)intermediates.size(), intermediates.data());
+		intermediates.clear();
+
+		Maps old = current;
+		IBLStoredMap oldSource = bakeSource;
+		current = stored;
+		bakeSource = keepBakeSource ? next.envCubemap : IBLStoredMap();
+		currentFile = loadingPath;
+		next = Maps();
+		stored = Maps();
+		partialBake = false;
+		deleteReplaced(old, oldSource);
+		state = IDLE;
+	}
+
+	void runStep(const Step& step)
+	{
+		beginQuery(stepKind(step));
+		switch (step.stage)
+		{
+		case IBL_BAKE_CONVERT:
+			baker.equirectangularToCubemap(hdrTexture, next.envCubemap.texture, envSize, step.face, 1);
+			break;
+		case IBL_BAKE_DOWNSAMPLE:
+			// mip 0 is final once converted, keep it for the next start
+			if (hdrTexture && step.mip == 1)
+				cacheWriter.write(envCachePath, ENV_CACHE_MAGIC, { envSize, 1 }, next.envCubemap.texture, envSize, 1);
+			// the mip chain the irradiance/prefilter samples read (combatting visible dots artifact)
+			baker.downsample(next.envCubemap.texture, envSize, step.mip);
+			break;
+		case IBL_BAKE_IRRADIANCE:
+			baker.irradiance(next.envCubemap.texture, envSize, next.irradianceMap.texture, irradianceSize, step.face, 1);
+			break;
+		case IBL_BAKE_PREFILTER:
+			baker.prefilter(next.envCubemap.texture, envSize, next.prefilterMap.texture, prefilterSize, step.mip, prefilterMips, step.face, 1);
+			break;
+		}
+		glEndQuery(GL_TIME_ELAPSED);
+	}
+
+	static int stepKind(const Step& step)
+	{
+		return step.stage * 16 + step.mip;
+	}
+
+	// a step kind that has never been measured counts as the whole budget, so it runs on its own.
+	double estimateMs(const Step& step, float budgetMs) const
+	{
+		std::map<int, double>::const_iterator it = stepCostMs.find(stepKind(step));
+		return it != stepCostMs.end() ? it->second : budgetMs;
+	}
+
+	// starts timing a step of this kind; collectTimings reads it back once it is available.
+	void beginQuery(int kind)
+	{
+		unsigned int query;
+		if (freeQueries.empty())
+			glGenQueries(1, &query);
+		else
+		{
+			query = freeQueries.back();
+			freeQueries.pop_back();
+		}
+		glBeginQuery(GL_TIME_ELAPSED, query);
+		pendingQueries.push_back({ query, kind });
+	}
+
+	// read back the timer queries that have finished (without waiting for the rest).
+	void collectTimings()
+	{
+		size_t kept = 0;
+		for (size_t i = 0; i < pendingQueries.size(); ++i)
+		{
+			GLint available = 0;
+			glGetQueryObjectiv(pendingQueries[i].query, GL_QUERY_RESULT_AVAILABLE, &available);
+			if (!available)
+			{
+				pendingQueries[kept++] = pendingQueries[i];
+				continue;
+			}
+			GLuint64 elapsed = 0;
+			glGetQueryObjectui64v(pendingQueries[i].query, GL_QUERY_RESULT, &elapsed);
+			double ms = elapsed / 1.0e6;
+			std::map<int, double>::iterator it = stepCostMs.find(pendingQueries[i].kind);
+			if (it == stepCostMs.end())
+				stepCostMs[pendingQueries[i].kind] = ms;
+			else
+				it->second += 0.25 * (ms - it->second);
+			freeQueries.push_back(pendingQueries[i].query);
+		}
+		pendingQueries.resize(kept);
+	}
+
+	bool isWorkingMap(unsigned int texture) const
+	{
+		return texture == next.envCubemap.texture || texture == next.irradianceMap.texture || texture == next.prefilterMap.texture;
+	}
+
+	// delete the textures of the previous set and bake source the current ones don't share
+	// (a partial bake keeps some of them).
+	void deleteReplaced(const Maps& old, const IBLStoredMap& oldSource)
+	{
+		unsigned int textures[4] = { old.envCubemap.texture, old.irradianceMap.texture, old.prefilterMap.texture, oldSource.texture };
+		for (int i = 0; i < 4; ++i)
+		{
+			unsigned int texture = textures[i];
+			if (!texture || texture == current.envCubemap.texture || texture == current.irradianceMap.texture
+				|| texture == current.prefilterMap.texture || texture == bakeSource.texture)
+				continue;
+			if (std::find(textures, textures + i, texture) != textures + i)
+				continue;
+			glDeleteTextures(1, &texture);
+		}
+	}
+};
+
+#endif
@@ -0,0 +1,443 @@
+#ifndef _IBL_STORAGE_H_
+#define _IBL_STORAGE_H_
+
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <learnopengl/shader.h>
+
+#include "bc6h.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <future>
+#include <iostream>
+#include <vector>
+
+// defined in proj03.cpp
+void renderQuad();
+
+// Storage formats for the baked IBL maps. The bake always renders into RGB16F/RGBA16F
+// working maps; afterwards every map is stored in its configured format:
+//   IBL_STORAGE_RGB16F      6 bytes per texel, the working map as baked (the reference;
+//                           RGBA16F and 8 bytes on the compute path)
+//   IBL_STORAGE_R11G11B10F  4 bytes, packed floats with 6/6/5 bit mantissas, copied on the GPU
+//   IBL_STORAGE_BC6H        1 byte, compressed on the CPU (bc6h.h) from a PBO readback
+// and the prefilter chain can be stored as an octahedral 2D texture (2x the cube face
+// size per mip, a third fewer texels than the six faces).
+enum IBLStorageFormat {
+	IBL_STORAGE_RGB16F,
+	IBL_STORAGE_R11G11B10F,
+	IBL_STORAGE_BC6H
+};
+
+struct IBLStorage {
+	IBLStorageFormat environment = IBL_STORAGE_RGB16F;
+	IBLStorageFormat irradiance = IBL_STORAGE_RGB16F;
+	IBLStorageFormat prefilter = IBL_STORAGE_RGB16F;
+	bool octahedralPrefilter = false;
+};
+
+// a baked map: cubemap or (octahedral) 2D texture with levels mips of size >> level.
+struct IBLStoredMap {
+	unsigned int texture = 0;
+	GLenum target = GL_TEXTURE_CUBE_MAP;
+	GLenum internalFormat = GL_RGB16F;
+	unsigned int size = 0;
+	unsigned int levels = 1;
+};
+
+inline const char* iblFormatName(GLenum internalFormat)
+{
+	switch (internalFormat)
+	{
+	case GL_R11F_G11F_B10F:
+		return "R11G11B10F";
+	case GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT:
+		return "BC6H";
+	case GL_RGBA16F:
+		return "RGBA16F";
+	default:
+		return "RGB16F";
+	}
+}
+
+inline bool iblBC6HSupported()
+{
+	return GLEW_VERSION_4_2 || GLEW_ARB_texture_compression_bptc;
+}
+
+// nominal size of one size x size image (drivers may pad RGB16F to four channels).
+inline size_t iblImageBytes(GLenum internalFormat, unsigned int size)
+{
+	switch (internalFormat)
+	{
+	case GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT:
+		return bc6hSize(size, size);
+	case GL_R11F_G11F_B10F:
+		return (size_t)size * size * 4;
+	case GL_RGBA16F:
+		return (size_t)size * size * 8;
+	default:
+		return (size_t)size * size * 6;
+	}
+}
+
+inline unsigned int iblFaceCount(const IBLStoredMap& map)
+{
+	return map.target == GL_TEXTURE_CUBE_MAP ? 6 : 1;
+}
+
+inline GLenum iblImageTarget(const IBLStoredMap& map, unsigned int face)
+{
+	return map.target == GL_TEXTURE_CUBE_MAP ? GL_TEXTURE_CUBE_MAP_POSITIVE_X + face : GL_TEXTURE_2D;
+}
+
+inline unsigned int iblLevelSize(const IBLStoredMap& map, unsigned int level)
+{
+	return std::max(map.size >> level, 1u);
+}
+
+inline size_t iblMapBytes(const IBLStoredMap& map)
+{
+	size_t bytes = 0;
+	for (unsigned int level = 0; level < map.levels; ++level)
+		bytes += iblFaceCount(map) * iblImageBytes(map.internalFormat, iblLevelSize(map, level));
+	return bytes;
+}
+
+// texture with storage for every face and level, the sampler state of the IBL maps
+// and GL_TEXTURE_MAX_LEVEL limiting it to the levels that are written.
+inline IBLStoredMap iblAllocateMap(GLenum target, GLenum internalFormat, unsigned int size, unsigned int levels)
+{
+	IBLStoredMap map;
+	map.target = target;
+	map.internalFormat = internalFormat;
+	map.size = size;
+	map.levels = levels;
+	glGenTextures(1, &map.texture);
+	glBindTexture(target, map.texture);
+	if (internalFormat != GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT)
+	{
+		for (unsigned int level = 0; level < levels; ++level)
+			for (unsigned int face = 0; face < iblFaceCount(map); ++face)
+			{
+				unsigned int levelSize = iblLevelSize(map, level);
+				glTexImage2D(iblImageTarget(map, face), level, internalFormat, levelSize, levelSize, 0, GL_RGB, GL_FLOAT, nullptr);
+			}
+	}
+	glTexParameteri(target, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(target, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(target, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+	glTexParameteri(target, GL_TEXTURE_MIN_FILTER, levels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+	glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(target, GL_TEXTURE_MAX_LEVEL, levels - 1);
+	return map;
+}
+
+// ----------------------------------------------------------------------------
+// octahedral mapping of the unit sphere onto [0,1]^2 (+Z hemisphere in the inner diamond),
+// the same functions as in 2.2.1.cubemap_to_octahedral.fs and 2.2.1.pbr.fs.
+inline glm::vec2 octahedralEncode(glm::vec3 n)
+{
+	n /= std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+	glm::vec2 p(n.x, n.y);
+	if (n.z < 0.0f)
+	{
+		glm::vec2 s(p.x >= 0.0f ? 1.0f : -1.0f, p.y >= 0.0f ? 1.0f : -1.0f);
+		p = (1.0f - glm::abs(glm::vec2(p.y, p.x))) * s;
+	}
+	return p * 0.5f + 0.5f;
+}
+
+// direction of the center of texel (x, y) of face (GL order +X, -X, +Y, -Y, +Z, -Z)
+inline glm::vec3 cubeTexelDirection(unsigned int face, unsigned int x, unsigned int y, unsigned int size)
+{
+	float u = (x + 0.5f) / size * 2.0f - 1.0f;
+	float v = (y + 0.5f) / size * 2.0f - 1.0f;
+	glm::vec3 dir;
+	switch (face)
+	{
+	case 0: dir = glm::vec3(1.0f, -v, -u); break;
+	case 1: dir = glm::vec3(-1.0f, -v, u); break;
+	case 2: dir = glm::vec3(u, 1.0f, v); break;
+	case 3: dir = glm::vec3(u, -1.0f, -v); break;
+	case 4: dir = glm::vec3(u, -v, 1.0f); break;
+	default: dir = glm::vec3(-u, -v, -1.0f); break;
+	}
+	return glm::normalize(dir);
+}
+
+// ----------------------------------------------------------------------------
+// GPU side of the conversions: format copies by framebuffer blits and the
+// cubemap -> octahedral resampling pass.
+class IBLStorageConverter {
+public:
+	IBLStorageConverter()
+		: octahedralShader("src/2.2.1.brdf.vs", "src/2.2.1.cubemap_to_octahedral.fs")
+	{
+		glGenFramebuffers(1, &readFBO);
+		glGenFramebuffers(1, &drawFBO);
+		octahedralShader.use();
+		octahedralShader.setInt("environmentMap", 0);
+	}
+
+	// copy every face and level of src into a new texture of the given format.
+	IBLStoredMap copyAs(const IBLStoredMap& src, GLenum internalFormat)
+	{
+		IBLStoredMap dst = iblAllocateMap(src.target, internalFormat, src.size, src.levels);
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, readFBO);
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, drawFBO);
+		for (unsigned int level = 0; level < src.levels; ++level)
+			for (unsigned int face = 0; face < iblFaceCount(src); ++face)
+			{
+				int levelSize = iblLevelSize(src, level);
+				glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, iblImageTarget(src, face), src.texture, level);
+				glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, iblImageTarget(dst, face), dst.texture, level);
+				glBlitFramebuffer(0, 0, levelSize, levelSize, 0, 0, levelSize, levelSize, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+			}
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		return dst;
+	}
+
+	// resample the mips of a cubemap into an RGB16F octahedral 2D texture (2x the face size).
+	IBLStoredMap toOctahedral(const IBLStoredMap& cube)
+	{
+		IBLStoredMap oct = iblAllocateMap(GL_TEXTURE_2D, GL_RGB16F, cube.size * 2, cube.levels);
+		GLint viewport[4];
+		glGetIntegerv(GL_VIEWPORT, viewport);
+		octahedralShader.use();
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_CUBE_MAP, cube.texture);
+		glBindFramebuffer(GL_FRAMEBUFFER, drawFBO);
+		for (unsigned int level = 0; level < oct.levels; ++level)
+		{
+			unsigned int levelSize = iblLevelSize(oct, level);
+			octahedralShader.setFloat("mipLevel", (float)level);
+			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, oct.texture, level);
+			glViewport(0, 0, levelSize, levelSize);
+			// no depth attachment, so the depth test can't reject the quad
+			renderQuad();
+		}
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+		return oct;
+	}
+
+private:
+	Shader octahedralShader;
+	unsigned int readFBO;
+	unsigned int drawFBO;
+};
+
+// ----------------------------------------------------------------------------
+// BC6H compression of one map without stalling the frame: the faces/levels are read
+// back into a pixel pack buffer, a fence tells when the copy is done, the blocks are
+// encoded on a worker thread and uploaded with glCompressedTexImage2D.
+class IBLBC6HJob {
+public:
+	void start(const IBLStoredMap& src)
+	{
+		source = src;
+		size_t offset = 0;
+		offsets.clear();
+		for (unsigned int level = 0; level < source.levels; ++level)
+			for (unsigned int face = 0; face < iblFaceCount(source); ++face)
+			{
+				offsets.push_back(offset);
+				unsigned int levelSize = iblLevelSize(source, level);
+				offset += (size_t)levelSize * levelSize * 3 * sizeof(uint16_t);
+			}
+		glGenBuffers(1, &pbo);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, pbo);
+		glBufferData(GL_PIXEL_PACK_BUFFER, offset, nullptr, GL_STREAM_READ);
+		glPixelStorei(GL_PACK_ALIGNMENT, 2); // rows are size * 6 bytes
+		glBindTexture(source.target, source.texture);
+		size_t image = 0;
+		for (unsigned int level = 0; level < source.levels; ++level)
+			for (unsigned int face = 0; face < iblFaceCount(source); ++face)
+				glGetTexImage(iblImageTarget(source, face), level, GL_RGB, GL_HALF_FLOAT, (void*)offsets[image++]);
+		glPixelStorei(GL_PACK_ALIGNMENT, 4);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		done = false;
+	}
+
+	// advance the job, returns true once result holds the compressed texture.
+	bool poll()
+	{
+		if (done)
+			return true;
+		if (fence)
+		{
+			if (glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+				return false;
+			glDeleteSync(fence);
+			fence = 0;
+			startEncoding();
+			return false;
+		}
+		if (encoded.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+			return false;
+		upload(encoded.get());
+		done = true;
+		return true;
+	}
+
+	// block until the worker is done (before the context goes away)
+	void wait()
+	{
+		if (encoded.valid())
+			encoded.wait();
+	}
+
+	IBLStoredMap result;
+
+private:
+	IBLStoredMap source;
+	std::vector<size_t> offsets;
+	unsigned int pbo = 0;
+	GLsync fence = 0;
+	std::future<std::vector<std::vector<uint8_t>>> encoded;
+	bool done = true;
+
+	void startEncoding()
+	{
+		// copy out of the mapping so the buffer can go right away; the encode is the slow part
+		std::vector<uint16_t> halves;
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, pbo);
+		GLint64 size = 0;
+		glGetBufferParameteri64v(GL_PIXEL_PACK_BUFFER, GL_BUFFER_SIZE, &size);
+		const uint16_t* mapped = (const uint16_t*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, size, GL_MAP_READ_BIT);
+		if (mapped)
+			halves.assign(mapped, mapped + size / sizeof(uint16_t));
+		glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		glDeleteBuffers(1, &pbo);
+		pbo = 0;
+		if (halves.empty())
+			halves.resize(size / sizeof(uint16_t), 0);
+
+		IBLStoredMap layout = source;
+		std::vector<size_t> imageOffsets = offsets;
+		encoded = std::async(std::launch::async, [layout, imageOffsets, halves]()
+		{
+			std::vector<std::vector<uint8_t>> images;
+			size_t image = 0;
+			for (unsigned int level = 0; level < layout.levels; ++level)
+				for (unsigned int face = 0; face < iblFaceCount(layout); ++face)
+				{
+					int levelSize = iblLevelSize(layout, level);
+					images.push_back(encodeBC6H(&halves[imageOffsets[image++] / sizeof(uint16_t)], levelSize, levelSize));
+				}
+			return images;
+		});
+	}
+
+	void upload(const std::vector<std::vector<uint8_t>>& images)
+	{
+		result = iblAllocateMap(source.target, GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT, source.size, source.levels);
+		size_t image = 0;
+		for (unsigned int level = 0; level < result.levels; ++level)
+			for (unsigned int face = 0; face < iblFaceCount(result); ++face)
+			{
+				unsigned int levelSize = iblLevelSize(result, level);
+				const std::vector<uint8_t>& blocks = images[image++];
+				glCompressedTexImage2D(iblImageTarget(result, face), level, GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT,
+					levelSize, levelSize, 0, (GLsizei)blocks.size(), blocks.data());
+			}
+	}
+};
+
+// ----------------------------------------------------------------------------
+// reads every face and level of a map as RGB floats (level images in order, faces within a level).
+inline std::vector<std::vector<float>> iblReadMap(const IBLStoredMap& map)
+{
+	std::vector<std::vector<float>> images;
+	glBindTexture(map.target, map.texture);
+	for (unsigned int level = 0; level < map.levels; ++level)
+		for (unsigned int face = 0; face < iblFaceCount(map); ++face)
+		{
+			unsigned int levelSize = iblLevelSize(map, level);
+			images.push_back(std::vector<float>((size_t)levelSize * levelSize * 3));
+			glGetTexImage(iblImageTarget(map, face), level, GL_RGB, GL_FLOAT, images.back().data());
+		}
+	return images;
+}
+
+// bilinear lookup with clamp to edge, like the sampler of the stored map.
+inline glm::vec3 iblSampleBilinear(const std::vector<float>& image, unsigned int size, glm::vec2 uv)
+{
+	float x = uv.x * size - 0.5f;
+	float y = uv.y * size - 0.5f;
+	int x0 = (int)std::floor(x);
+	int y0 = (int)std::floor(y);
+	float fx = x - x0;
+	float fy = y - y0;
+	glm::vec3 texels[4];
+	for (int i = 0; i < 4; ++i)
+	{
+		int sx = glm::clamp(x0 + (i & 1), 0, (int)size - 1);
+		int sy = glm::clamp(y0 + (i >> 1), 0, (int)size - 1);
+		const float* t = &image[((size_t)sy * size + sx) * 3];
+		texels[i] = glm::vec3(t[0], t[1], t[2]);
+	}
+	return glm::mix(glm::mix(texels[0], texels[1], fx), glm::mix(texels[2], texels[3], fx), fy);
+}
+
+// prints the error of a stored map against the RGB16F/RGBA16F cubemap it was made from,
+// compared texel by texel over every face of every level (octahedral maps are looked up
+// in the reference texel's direction), and the memory of both.
+inline void reportIBLStorageError(const char* name, const IBLStoredMap& reference, const IBLStoredMap& stored)
+{
+	std::vector<std::vector<float>> referenceImages = iblReadMap(reference);
+	std::vector<std::vector<float>> storedImages = iblReadMap(stored);
+	bool octahedral = stored.target == GL_TEXTURE_2D;
+
+	const glm::vec3 toLuminance(0.2126f, 0.7152f, 0.0722f);
+	double squaredError = 0.0, referenceSum = 0.0, maxRelativeError = 0.0;
+	size_t count = 0;
+	size_t image = 0;
+	for (unsigned int level = 0; level < reference.levels; ++level)
+		for (unsigned int face = 0; face < 6; ++face, ++image)
+		{
+			unsigned int levelSize = iblLevelSize(reference, level);
+			for (unsigned int y = 0; y < levelSize; ++y)
+				for (unsigned int x = 0; x < levelSize; ++x)
+				{
+					const float* r = &referenceImages[image][((size_t)y * levelSize + x) * 3];
+					glm::vec3 ref(r[0], r[1], r[2]);
+					glm::vec3 test;
+					if (octahedral)
+					{
+						glm::vec2 uv = octahedralEncode(cubeTexelDirection(face, x, y, levelSize));
+						test = iblSampleBilinear(storedImages[level], iblLevelSize(stored, level), uv);
+					}
+					else
+					{
+						const float* s = &storedImages[image][((size_t)y * levelSize + x) * 3];
+						test = glm::vec3(s[0], s[1], s[2]);
+					}
+					glm::vec3 diff = test - ref;
+					double lumReference = glm::dot(ref, toLuminance);
+					squaredError += glm::dot(diff, diff) / 3.0;
+					referenceSum += lumReference;
+					maxRelativeError = std::max(maxRelativeError, std::abs(glm::dot(test, toLuminance) - lumReference) / std::max(lumReference, 1e-4));
+					++count;
+				}
+		}
+	double relativeRMSE = std::sqrt(squaredError / count) / std::max(referenceSum / count, 1e-6);
+
+	// memory relative to the same map as an RGB16F cubemap
+	IBLStoredMap rgb16f = reference;
+	rgb16f.internalFormat = GL_RGB16F;
+	std::cout << "  " << name << ": " << iblFormatName(stored.internalFormat) << (octahedral ? " octahedral " : " cube ")
+		<< stored.size << " x" << stored.levels << " mips, " << iblMapBytes(stored) / 1024 << " KB (RGB16F cube "
+		<< iblMapBytes(rgb16f) / 1024 << " KB), relative RMSE " << relativeRMSE * 100.0 << " %, max relative error "
+		<< maxRelativeError * 100.0 << " %" << std::endl;
+}
+
+#endif
@@ -0,0 +1,99 @@
+#ifndef _IRRADIANCE_COMPARE_H_
+#define _IRRADIANCE_COMPARE_H_
+
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "ibl_baker.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+// texture fetches per irradiance texel of each IrradianceMode (see the shaders).
+const unsigned int IRRADIANCE_UNIFORM_FETCHES = 252 * 63;
+const unsigned int IRRADIANCE_IMPORTANCE_FETCHES = 256;
+
+// bakes the irradiance map of envCubemap with IRRADIANCE_UNIFORM (the reference) and
+// IRRADIANCE_IMPORTANCE, reads both back and prints the error of the importance sampled
+// map together with the fetch counts and GPU times. blocks on the GPU, debugging only.
+// false, comparing nothing, while the baker's programs are still being built (a deferred
+// or parallel compile): call it again on a later frame.
+inline bool compareIrradianceModes(IBLBaker& baker, unsigned int envCubemap, unsigned int envSize, unsigned int size)
+{
+	if (!baker.ready())
+		return false;
+	GLint viewport[4];
+	glGetIntegerv(GL_VIEWPORT, viewport);
+	IrradianceMode previousMode = baker.getIrradianceMode();
+
+	const IrradianceMode modes[2] = { IRRADIANCE_UNIFORM, IRRADIANCE_IMPORTANCE };
+	std::vector<float> texels[2];
+	double gpuMs[2];
+	unsigned int query;
+	glGenQueries(1, &query);
+	for (int m = 0; m < 2; ++m)
+	{
+		unsigned int irradianceMap;
+		glGenTextures(1, &irradianceMap);
+		glBindTexture(GL_TEXTURE_CUBE_MAP, irradianceMap);
+		for (unsigned int i = 0; i < 6; ++i)
+		{
+			glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, baker.cubemapFormat(), size, size, 0, GL_RGB, GL_FLOAT, nullptr);
+		}
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+		baker.setIrradianceMode(modes[m]);
+		glBeginQuery(GL_TIME_ELAPSED, query);
+		baker.irradiance(envCubemap, envSize, irradianceMap, size);
+		glEndQuery(GL_TIME_ELAPSED);
+		GLuint64 elapsed = 0;
+		glGetQueryObjectui64v(query, GL_QUERY_RESULT, &elapsed);
+		gpuMs[m] = elapsed / 1.0e6;
+
+		texels[m].resize(size * size * 3 * 6);
+		glBindTexture(GL_TEXTURE_CUBE_MAP, irradianceMap);
+		for (unsigned int i = 0; i < 6; ++i)
+		{
+			glGetTexImage(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB, GL_FLOAT, &texels[m][i * size * size * 3]);
+		}
+		glDeleteTextures(1, &irradianceMap);
+	}
+	glDeleteQueries(1, &query);
+	baker.setIrradianceMode(previousMode);
+	glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+
+	// errors relative to the reference, on luminance so a dark texel doesn't dominate per channel
+	const glm::vec3 toLuminance(0.2126f, 0.7152f, 0.0722f);
+	double squaredError = 0.0, referenceSum = 0.0, testSum = 0.0, maxRelativeError = 0.0;
+	size_t texelCount = texels[0].size() / 3;
+	for (size_t t = 0; t < texelCount; ++t)
+	{
+		glm::vec3 reference(texels[0][t * 3], texels[0][t * 3 + 1], texels[0][t * 3 + 2]);
+		glm::vec3 test(texels[1][t * 3], texels[1][t * 3 + 1], texels[1][t * 3 + 2]);
+		double lumReference = glm::dot(reference, toLuminance);
+		double lumTest = glm::dot(test, toLuminance);
+		glm::vec3 diff = test - reference;
+		squaredError += glm::dot(diff, diff) / 3.0;
+		referenceSum += lumReference;
+		testSum += lumTest;
+		maxRelativeError = std::max(maxRelativeError, std::abs(lumTest - lumReference) / std::max(lumReference, 1e-4));
+	}
+	double meanReference = referenceSum / texelCount;
+	double relativeRMSE = std::sqrt(squaredError / texelCount) / std::max(meanReference, 1e-6);
+
+	std::cout << "irradiance " << size << "x" << size << " bake, uniform vs. importance sampled:" << std::endl;
+	std::cout << "  fetches per texel  " << IRRADIANCE_UNIFORM_FETCHES << " vs. " << IRRADIANCE_IMPORTANCE_FETCHES
+		<< " (" << (float)IRRADIANCE_UNIFORM_FETCHES / IRRADIANCE_IMPORTANCE_FETCHES << "x fewer)" << std::endl;
+	std::cout << "  GPU time           " << gpuMs[0] << " ms vs. " << gpuMs[1] << " ms" << std::endl;
+	std::cout << "  relative RMSE      " << relativeRMSE * 100.0 << " %" << std::endl;
+	std::cout << "  max relative error " << maxRelativeError * 100.0 << " % (luminance)" << std::endl;
+	std::cout << "  mean energy ratio  " << testSum / std::max(referenceSum, 1e-6) << std::endl;
+	return true;
+}
+
+#endif
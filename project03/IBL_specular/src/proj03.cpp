@@ -13,8 +13,20 @@
 #include <learnopengl/shader.h>
 #include <learnopengl/camera.h>
 #include <learnopengl/model.h>
+#include <learnopengl/frame_uniforms.h>
+
+#include "ibl_compute.h"
+#include "ibl_environment.h"
+#include "irradiance_compare.h"
+#include "brdf_lut.h"
+#include "hdr_loader.h"
+#include "reflection_probes.h"
+#include "shader_compiler.h"
+#include "shader_hot_reload.h"
 
 #include <iostream>
+#include <map>
+#include <memory>
 
 #pragma comment(lib, "opengl32.lib")
 #pragma comment(lib, "glew32.lib")
@@ -25,7 +37,10 @@ void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
 void processInput(GLFWwindow* window);
+bool keyPressedOnce(GLFWwindow* window, int key);
+void printUniformStats(const char* name, Shader& shader);
 unsigned int loadTex(const char* path);
+unsigned int loadBRDFLUTTexture(unsigned int size);
 void renderSphere();
 void renderCube();
 void renderQuad();
@@ -34,6 +49,63 @@ void renderQuad();
 const unsigned int SCR_WIDTH = 1280;
 const unsigned int SCR_HEIGHT = 720;
 
+// split-sum BRDF LUT: resolution of the pre-generated table (64, 128 or 256, see tools/brdf_lut_gen.cpp),
+// or the analytic fit in the pbr shader which needs no texture at all.
+const unsigned int BRDF_LUT_SIZE = 128;
+const bool useAnalyticBRDF = false;
+
+// HDR environments cycled with the E key; switching decodes on worker threads and spreads
+// the bake over several frames, spending at most IBL_BAKE_BUDGET_MS of GPU time per frame.
+// only newport_loft.hdr ships in resources/textures/hdr, so until more maps are listed
+// here E reloads it (from the IBL cache), which still exercises the switch.
+const char* environmentPaths[] = {
+	"resources/textures/hdr/newport_loft.hdr",
+};
+const float IBL_BAKE_BUDGET_MS = 2.0f;
+unsigned int environmentIndex = 0;
+bool environmentSwitchRequested = false;
+
+// irradiance bake: IRRADIANCE_IMPORTANCE (256 mip-filtered samples per texel) or the
+// IRRADIANCE_UNIFORM reference sweep. C prints a comparison of the two for the current environment.
+const IrradianceMode IRRADIANCE_MODE = IRRADIANCE_IMPORTANCE;
+bool irradianceCompareRequested = false;
+
+// Monte Carlo sample counts of the pre-filter and irradiance bakes (compiled into the
+// programs); trade bake time for noise here instead of in the shaders.
+const IBLBakeQuality IBL_BAKE_QUALITY = { 256, 256 };
+
+// equirectangular -> cubemap conversion: EQUIRECT_AREA averages the panorama over each cube
+// texel (no aliasing from 4K/8K sources), EQUIRECT_BILINEAR takes one tap. the result is
+// cached in resources/cache, so a panorama is only converted once.
+const EquirectFilter EQUIRECT_FILTER = EQUIRECT_AREA;
+
+// storage of the baked IBL maps (environment, irradiance, pre-filter, octahedral pre-filter):
+// RGB16F, R11G11B10F (2/3 of the memory) or BC6H (1/6). R re-bakes the current environment
+// and prints the error and memory of each map against the RGB16F bake.
+const IBLStorage IBL_STORAGE = { IBL_STORAGE_BC6H, IBL_STORAGE_R11G11B10F, IBL_STORAGE_R11G11B10F, false };
+bool storageReportRequested = false;
+
+// local reflection probes around the chair, PROBES_PER_FRAME of them baked per frame. bakes are
+// cached in resources/cache per probe and environment; P re-bakes all of them.
+const unsigned int PROBES_PER_FRAME = 1;
+bool probeRebakeRequested = false;
+
+// U prints (and resets) the uniform upload statistics of the scene shaders.
+bool uniformStatsRequested = false;
+
+// edits to the shader files are picked up while running: the changed programs are rebuilt
+// in the background and swapped in, then the bake stages that use them (and the probes)
+// run again. keeps the working envCubemap (~16 MB) so the irradiance and pre-filter
+// stages can be redone on their own.
+const bool SHADER_HOT_RELOAD = true;
+
+// vertex buffer layout of the model: positions quantized to the mesh bounds, octahedral
+// normal and tangent, half texture coordinates (20 bytes per vertex instead of 56).
+// 2.2.1.pbr.vs decodes it unless PACKED_VERTICES is 0 (VERTEX_FULL).
+const VertexFormat MODEL_VERTEX_FORMAT = VERTEX_QUANTIZED;
+// the chair is only drawn, its geometry needn't stay in system memory after the upload
+const bool MODEL_KEEP_CPU_GEOMETRY = false;
+
 // camera
 Camera camera(glm::vec3(0.0f, 0.0f, 3.0f));
 float lastX = 800.0f / 2.0;
@@ -49,7 +121,8 @@ int main()
 	// glfw: initialize and configure
 	// ------------------------------
 	glfwInit();
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+	// ask for 4.3 so the IBL maps can be baked with compute shaders
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
 	glfwWindowHint(GLFW_SAMPLES, 4);
 	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
@@ -61,6 +134,13 @@ int main()
 	// glfw window creation
 	// --------------------
 	GLFWwindow* window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "LearnOpenGL", NULL, NULL);
+	if (window == NULL)
+	{
+		// no 4.3 support (e.g. macOS), fall back to 3.3 and the raster bake
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+		window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "LearnOpenGL", NULL, NULL);
+	}
 	glfwMakeContextCurrent(window);
 	if (window == NULL)
 	{
@@ -87,39 +167,36 @@ int main()
 	// enable seamless cubemap sampling for lower mip levels in the pre-filter map.
 	glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
 
-	// build and compile shaders
+	// build and compile shaders: in the background, while the HDR map decodes and the
+	// model imports; the render loop draws with whichever programs are ready. the GGX
+	// functions are shared through #include "2.2.1.brdf.glsl", linked programs are cached in
+	// resources/cache by the hash of their preprocessed sources. on 4.6 / ARB_gl_spirv the
+	// modules of the SpirvShaders build target (spirv/) are loaded instead of the GLSL where
+	// they are up to date, the ShaderDefines below reaching them as specialization constants.
 	// -------------------------
-	Shader pbrShader("src/2.2.1.pbr.vs", "src/2.2.1.pbr.fs");
-	Shader equirectangularToCubemapShader("src/2.2.1.cubemap.vs", "src/2.2.1.equirectangular_to_cubemap.fs");
-	Shader irradianceShader("src/2.2.1.cubemap.vs", "src/2.2.1.irradiance_convolution.fs");
-	Shader prefilterShader("src/2.2.1.cubemap.vs", "src/2.2.1.prefilter.fs");
-	Shader brdfShader("src/2.2.1.brdf.vs", "src/2.2.1.brdf.fs");
-	Shader backgroundShader("src/2.2.1.background.vs", "src/2.2.1.background.fs");
-
-	// Model load
-	Model ourModel(FileSystem::getPath("../resources/chair/old chair.obj"));
-
-	pbrShader.use();
-	pbrShader.setInt("irradianceMap", 0);
-	pbrShader.setInt("prefilterMap", 1);
-	pbrShader.setInt("brdfLUT", 2);
-	pbrShader.setInt("albedoMap", 3);
-	pbrShader.setInt("normalMap", 4);
-	pbrShader.setInt("metallicMap", 5);
-	pbrShader.setInt("roughnessMap", 6);
-	pbrShader.setInt("aoMap", 7);
-
-	backgroundShader.use();
-	backgroundShader.setInt("environmentMap", 0);
-
-	// load PBR material textures
-	// --------------------------
-	// chair texture
-	unsigned int chairAlbedoMap = loadTex(FileSystem::getPath("../resources/chair/textures/old_chiar_BaseColor.png").c_str());
-	unsigned int chairNormalMap = loadTex(FileSystem::getPath("../resources/chair/textures/old_chiar_Normal.png").c_str());
-	unsigned int chairMetallicMap = loadTex(FileSystem::getPath("../resources/chair/textures/old_chiar_Metalness.png").c_str());
-	unsigned int chairRoughnessMap = loadTex(FileSystem::getPath("../resources/chair/textures/old_chiar_Roughness.png").c_str());
-	unsigned int chairAOMap = loadTex(FileSystem::getPath("../resources/chair/textures/old_chiar_AO.png").c_str());
+	ShaderSourceMap::global().addFile("2.2.1.brdf.glsl", "src/2.2.1.brdf.glsl");
+	ShaderSourceMap::global().addFile("2.2.1.downsample.glsl", "src/2.2.1.downsample.glsl");
+	ShaderSourceMap::global().addFile("2.2.1.equirect.glsl", "src/2.2.1.equirect.glsl");
+	ShaderSourceMap::global().addFile("2.2.1.vertex_packing.glsl", "src/2.2.1.vertex_packing.glsl");
+	ShaderSourceMap::global().addFile("2.2.1.frame_uniforms.glsl", "src/2.2.1.frame_uniforms.glsl");
+	shaderProgramCacheDirectory() = "resources/cache";
+	shaderSpirvDirectory() = "spirv";
+	shaderConstantIds()["SAMPLE_COUNT"] = 0;
+	shaderConstantIds()["LIGHT_COUNT"] = 1;
+	shaderConstantIds()["MAX_REFLECTION_LOD"] = 2;
+	ShaderCompiler shaderCompiler(window);
+
+	// IBL bake: compute shaders (imageStore into the cubemap faces) on 4.3, otherwise the capture FBO.
+	std::unique_ptr<IBLBaker> iblBaker;
+	if (GLEW_VERSION_4_3)
+		iblBaker.reset(new IBLComputeBaker(&shaderCompiler, IBL_BAKE_QUALITY));
+	else
+		iblBaker.reset(new IBLRasterBaker(&shaderCompiler, IBL_BAKE_QUALITY));
+	iblBaker->setIrradianceMode(IRRADIANCE_MODE);
+	iblBaker->setEquirectFilter(EQUIRECT_FILTER);
+	IBLEnvironment environment(*iblBaker);
+	environment.setStorage(IBL_STORAGE);
+	environment.setKeepBakeSource(SHADER_HOT_RELOAD);
 
 	// lights
 	// ------
@@ -135,221 +212,186 @@ int main()
 		glm::vec3(300.0f, 300.0f, 300.0f),
 		glm::vec3(300.0f, 300.0f, 300.0f)
 	};
+	const int lightCount = sizeof(lightPositions) / sizeof(lightPositions[0]);
+
+	// the scene programs, specialized for the scene's lights and the pre-filter chain
+	ShaderDefines pbrDefines;
+	pbrDefines.set("MAX_FRAME_LIGHTS", (int)MAX_FRAME_LIGHTS);
+	pbrDefines.set("LIGHT_COUNT", lightCount);
+	pbrDefines.set("MAX_REFLECTION_PROBES", (int)MAX_REFLECTION_PROBES);
+	pbrDefines.set("MAX_REFLECTION_LOD", (float)(environment.prefilterLevels() - 1));
+	pbrDefines.set("PACKED_VERTICES", MODEL_VERTEX_FORMAT == VERTEX_FULL ? 0 : 1);
+	Shader pbrShader("src/2.2.1.pbr.vs", "src/2.2.1.pbr.fs", nullptr, BUILD_LATER, pbrDefines);
+	Shader backgroundShader("src/2.2.1.background.vs", "src/2.2.1.background.fs", nullptr, BUILD_LATER);
+	shaderCompiler.compile(pbrShader);
+	shaderCompiler.compile(backgroundShader);
+
+	// pbr: load the HDR environment map; the file is read and decoded on worker threads
+	// (started here so it overlaps the model import), the cubemap conversion, irradiance
+	// and pre-filter maps are baked a few faces per frame by environment.update() in the
+	// render loop.
+	// ---------------------------------------------------------------------------------
+	environment.load(environmentPaths[environmentIndex]);
+	environment.update(IBL_BAKE_BUDGET_MS);
+
+	// Model load; owned through a pointer so it is destroyed (and gives its textures back to
+	// the texture cache) before the context, see the end of main
+	std::unique_ptr<Model> chair(new Model(FileSystem::getPath("../resources/chair/old chair.obj"), false, MODEL_VERTEX_FORMAT, MODEL_KEEP_CPU_GEOMETRY));
+	Model& ourModel = *chair;
+	MemoryStats chairMemory = ourModel.MemoryUsage();
+	std::cout << "Chair: " << chairMemory.cpuBytes / 1024 << " KB in system memory, " << chairMemory.gpuBytes / 1024 << " KB on the GPU" << std::endl;
+
+	// load PBR material textures
+	// --------------------------
+	// chair texture
+	unsigned int chairAlbedoMap = loadTex(FileSystem::getPath("../resources/chair/textures/old_chiar_BaseColor.png").c_str());
+	unsigned int chairNormalMap = loadTex(FileSystem::getPath("../resources/chair/textures/old_chiar_Normal.png").c_str());
+	unsigned int chairMetallicMap = loadTex(FileSystem::getPath("../resources/chair/textures/old_chiar_Metalness.png").c_str());
+	unsigned int chairRoughnessMap = loadTex(FileSystem::getPath("../resources/chair/textures/old_chiar_Roughness.png").c_str());
+	unsigned int chairAOMap = loadTex(FileSystem::getPath("../resources/chair/textures/old_chiar_AO.png").c_str());
+
 	int nrRows = 7;
 	int nrColumns = 7;
 	float spacing = 2.5;
 
-	// pbr: setup framebuffer
-	// ----------------------
-	unsigned int captureFBO;
-	unsigned int captureRBO;
-	glGenFramebuffers(1, &captureFBO);
-	glGenRenderbuffers(1, &captureRBO);
-
-	glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
-	glBindRenderbuffer(GL_RENDERBUFFER, captureRBO);
-	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, 512, 512);
-	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, captureRBO);
-
-	// pbr: load the HDR environment map
-	// ---------------------------------
-	stbi_set_flip_vertically_on_load(true);
-	int width, height, nrComponents;
-	float* data = stbi_loadf("resources/textures/hdr/newport_loft.hdr", &width, &height, &nrComponents, 0);
-	unsigned int hdrTexture;
-	if (data)
-	{
-		glGenTextures(1, &hdrTexture);
-		glBindTexture(GL_TEXTURE_2D, hdrTexture);
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, width, height, 0, GL_RGB, GL_FLOAT, data); // note how we specify the texture's data value to be float
+	// pbr: load the pre-generated 2D LUT of the BRDF equations used (no render pass at startup).
+	// ----------------------------------------------------------------------------------------
+	unsigned int brdfLUTTexture = useAnalyticBRDF ? 0 : loadBRDFLUTTexture(BRDF_LUT_SIZE);
 
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
-		stbi_image_free(data);
-	}
-	else
-	{
-		std::cout << "Failed to load HDR image." << std::endl;
-	}
+	// camera and lights of both scene shaders live in one uniform buffer
+	// -------------------------------------------------------------------
+	FrameUniforms frameUniforms;
 
-	// pbr: setup cubemap to render to and attach to framebuffer
-	// ---------------------------------------------------------
-	unsigned int envCubemap;
-	glGenTextures(1, &envCubemap);
-	glBindTexture(GL_TEXTURE_CUBE_MAP, envCubemap);
-	for (unsigned int i = 0; i < 6; ++i)
-	{
-		glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB16F, 512, 512, 0, GL_RGB, GL_FLOAT, nullptr);
-	}
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR); // enable pre-filter mipmap sampling (combatting visible dots artifact)
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-	// pbr: set up projection and view matrices for capturing data onto the 6 cubemap face directions
-	// ----------------------------------------------------------------------------------------------
-	glm::mat4 captureProjection = glm::perspective(glm::radians(90.0f), 1.0f, 0.1f, 10.0f);
-	glm::mat4 captureViews[] =
+	// samplers and the frame block of each scene program, set once it is ready; the
+	// passes of a program that isn't are skipped.
+	// ---------------------------------------------------------------------------------
+	bool pbrConfigured = false;
+	bool backgroundConfigured = false;
+	auto configureScenePrograms = [&]()
 	{
-		glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(1.0f,  0.0f,  0.0f), glm::vec3(0.0f, -1.0f,  0.0f)),
-		glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(-1.0f,  0.0f,  0.0f), glm::vec3(0.0f, -1.0f,  0.0f)),
-		glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f,  1.0f,  0.0f), glm::vec3(0.0f,  0.0f,  1.0f)),
-		glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, -1.0f,  0.0f), glm::vec3(0.0f,  0.0f, -1.0f)),
-		glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f,  0.0f,  1.0f), glm::vec3(0.0f, -1.0f,  0.0f)),
-		glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f,  0.0f, -1.0f), glm::vec3(0.0f, -1.0f,  0.0f))
+		if (!pbrConfigured && pbrShader.ready())
+		{
+			pbrShader.use();
+			pbrShader.setInt("irradianceMap", 0);
+			pbrShader.setInt("prefilterMap", 1);
+			pbrShader.setInt("brdfLUT", 2);
+			pbrShader.setInt("albedoMap", 3);
+			pbrShader.setInt("normalMap", 4);
+			pbrShader.setInt("metallicMap", 5);
+			pbrShader.setInt("roughnessMap", 6);
+			pbrShader.setInt("aoMap", 7);
+			pbrShader.setInt("prefilterOctMap", 8);
+			pbrShader.setInt("probePrefilterMaps", 9);
+			pbrShader.setBool("analyticBRDF", useAnalyticBRDF);
+			frameUniforms.attach(pbrShader.ID);
+			pbrConfigured = true;
+		}
+		if (!backgroundConfigured && backgroundShader.ready())
+		{
+			backgroundShader.use();
+			backgroundShader.setInt("environmentMap", 0);
+			frameUniforms.attach(backgroundShader.ID);
+			backgroundConfigured = true;
+		}
 	};
 
-	// pbr: convert HDR equirectangular environment map to cubemap equivalent
-	// ----------------------------------------------------------------------
-	equirectangularToCubemapShader.use();
-	equirectangularToCubemapShader.setInt("equirectangularMap", 0);
-	equirectangularToCubemapShader.setMat4("projection", captureProjection);
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, hdrTexture);
-
-	glViewport(0, 0, 512, 512); // don't forget to configure the viewport to the capture dimensions.
-	glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
-	for (unsigned int i = 0; i < 6; ++i)
+	// scene: the chair and the skybox. probeCapture renders linear HDR without the local
+	// probes, for the reflection probe bakes.
+	// ---------------------------------------------------------------------------------
+	auto drawScene = [&](const glm::mat4& view, const glm::mat4& projection, const glm::vec3& viewPos, bool probeCapture)
 	{
-		equirectangularToCubemapShader.setMat4("view", captureViews[i]);
-		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, envCubemap, 0);
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		// camera and lights for every program: one buffer write
+		frameUniforms.setCamera(projection, view, viewPos);
+		for (int i = 0; i < lightCount; ++i)
+			frameUniforms.setLight(i, lightPositions[i], lightColors[i]);
+		frameUniforms.upload();
+
+		configureScenePrograms();
+		if (pbrConfigured)
+		{
+			pbrShader.use();
+			pbrShader.setBool("linearOutput", probeCapture);
+			if (probeCapture)
+				pbrShader.setInt("probeCount", 0);
+
+			// bind pre-computed IBL data
+			glActiveTexture(GL_TEXTURE0);
+			glBindTexture(GL_TEXTURE_CUBE_MAP, environment.irradianceMap());
+			pbrShader.setBool("octahedralPrefilter", environment.prefilterOctahedral());
+			glActiveTexture(GL_TEXTURE1);
+			glBindTexture(GL_TEXTURE_CUBE_MAP, environment.prefilterOctahedral() ? 0 : environment.prefilterMap());
+			glActiveTexture(GL_TEXTURE8);
+			glBindTexture(GL_TEXTURE_2D, environment.prefilterOctahedral() ? environment.prefilterMap() : 0);
+			glActiveTexture(GL_TEXTURE2);
+			glBindTexture(GL_TEXTURE_2D, brdfLUTTexture);
+
+			// chair texture
+			glActiveTexture(GL_TEXTURE3);
+			glBindTexture(GL_TEXTURE_2D, chairAlbedoMap);
+			glActiveTexture(GL_TEXTURE4);
+			glBindTexture(GL_TEXTURE_2D, chairNormalMap);
+			glActiveTexture(GL_TEXTURE5);
+			glBindTexture(GL_TEXTURE_2D, chairMetallicMap);
+			glActiveTexture(GL_TEXTURE6);
+			glBindTexture(GL_TEXTURE_2D, chairRoughnessMap);
+			glActiveTexture(GL_TEXTURE7);
+			glBindTexture(GL_TEXTURE_2D, chairAOMap);
+
+			// Render model
+			glm::mat4 model = glm::mat4(1.0f);
+			model = glm::translate(model, glm::vec3(-10.0f, -10.0f, 10.0f)); // translate it down so it's at the center of the scene
+			model = glm::scale(model, glm::vec3(0.8f, 0.8f, 0.8f));	// it's a bit too big for our scene, so scale it down
+			pbrShader.setMat4("model", model);
+			// the level of detail follows the camera, probe captures reuse it; culled against
+			// every view drawn
+			if (!probeCapture)
+				ourModel.SelectLod(model, view, projection, (float)SCR_HEIGHT);
+			if (ourModel.Cull(model, view, projection))
+				ourModel.Draw(pbrShader);
+		}
 
-		renderCube();
-	}
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
-	// then let OpenGL generate mipmaps from first mip face (combatting visible dots artifact)
-	glBindTexture(GL_TEXTURE_CUBE_MAP, envCubemap);
-	glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
-
-	// pbr: create an irradiance cubemap, and re-scale capture FBO to irradiance scale.
-	// --------------------------------------------------------------------------------
-	unsigned int irradianceMap;
-	glGenTextures(1, &irradianceMap);
-	glBindTexture(GL_TEXTURE_CUBE_MAP, irradianceMap);
-	for (unsigned int i = 0; i < 6; ++i)
-	{
-		glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB16F, 32, 32, 0, GL_RGB, GL_FLOAT, nullptr);
-	}
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-	glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
-	glBindRenderbuffer(GL_RENDERBUFFER, captureRBO);
-	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, 32, 32);
-
-	// pbr: solve diffuse integral by convolution to create an irradiance (cube)map.
-	// -----------------------------------------------------------------------------
-	irradianceShader.use();
-	irradianceShader.setInt("environmentMap", 0);
-	irradianceShader.setMat4("projection", captureProjection);
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_CUBE_MAP, envCubemap);
-
-	glViewport(0, 0, 32, 32); // don't forget to configure the viewport to the capture dimensions.
-	glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
-	for (unsigned int i = 0; i < 6; ++i)
-	{
-		irradianceShader.setMat4("view", captureViews[i]);
-		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, irradianceMap, 0);
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		// render skybox (render as last to prevent overdraw)
+		if (backgroundConfigured)
+		{
+			backgroundShader.use();
+			backgroundShader.setBool("linearOutput", probeCapture);
+			glActiveTexture(GL_TEXTURE0);
+			glBindTexture(GL_TEXTURE_CUBE_MAP, environment.envCubemap());
+			//glBindTexture(GL_TEXTURE_CUBE_MAP, environment.irradianceMap()); // display irradiance map
+			//glBindTexture(GL_TEXTURE_CUBE_MAP, environment.prefilterMap()); // display prefilter map
+			renderCube();
+		}
+	};
 
-		renderCube();
-	}
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
-	// pbr: create a pre-filter cubemap, and re-scale capture FBO to pre-filter scale.
-	// --------------------------------------------------------------------------------
-	unsigned int prefilterMap;
-	glGenTextures(1, &prefilterMap);
-	glBindTexture(GL_TEXTURE_CUBE_MAP, prefilterMap);
-	for (unsigned int i = 0; i < 6; ++i)
+	// reflection probes: the captures reuse the environment's pre-filter bake.
+	// ------------------------------------------------------------------------
+	ReflectionProbes probes(*iblBaker, [&](const glm::mat4& view, const glm::mat4& projection, const glm::vec3& position)
 	{
-		glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB16F, 128, 128, 0, GL_RGB, GL_FLOAT, nullptr);
-	}
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR); // be sure to set minification filter to mip_linear 
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	// generate mipmaps for the cubemap so OpenGL automatically allocates the required memory.
-	glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
-
-	// pbr: run a quasi monte-carlo simulation on the environment lighting to create a prefilter (cube)map.
-	// ----------------------------------------------------------------------------------------------------
-	prefilterShader.use();
-	prefilterShader.setInt("environmentMap", 0);
-	prefilterShader.setMat4("projection", captureProjection);
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_CUBE_MAP, envCubemap);
-
-	glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
-	unsigned int maxMipLevels = 5;
-	for (unsigned int mip = 0; mip < maxMipLevels; ++mip)
+		drawScene(view, projection, position, true);
+	});
+	probes.addProbe(glm::vec3(-10.0f, -8.0f, 10.0f), 6.0f);
+	probes.addProbe(glm::vec3(-16.0f, -8.0f, 10.0f), 6.0f);
+	probes.addProbe(glm::vec3(-4.0f, -8.0f, 10.0f), 6.0f);
+	std::string probeCacheTag;
+
+	// shader hot reload: a reloaded bake program re-bakes its stage of the environment, the
+	// probes are captured again once that is done (or right away for the scene programs).
+	// ---------------------------------------------------------------------------------
+	ShaderHotReload shaderHotReload(shaderCompiler);
+	bool probesAfterRebake = false;
+	if (SHADER_HOT_RELOAD)
 	{
-		// reisze framebuffer according to mip-level size.
-		unsigned int mipWidth = 128 * std::pow(0.5, mip);
-		unsigned int mipHeight = 128 * std::pow(0.5, mip);
-		glBindRenderbuffer(GL_RENDERBUFFER, captureRBO);
-		glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, mipWidth, mipHeight);
-		glViewport(0, 0, mipWidth, mipHeight);
-
-		float roughness = (float)mip / (float)(maxMipLevels - 1);
-		prefilterShader.setFloat("roughness", roughness);
-		for (unsigned int i = 0; i < 6; ++i)
+		iblBaker->watchShaders(shaderHotReload, [&](IBLBakeStage stage)
 		{
-			prefilterShader.setMat4("view", captureViews[i]);
-			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, prefilterMap, mip);
-
-			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-			renderCube();
-		}
+			environment.rebake(stage);
+			probesAfterRebake = true;
+		});
+		shaderHotReload.watch(pbrShader, [&]() { probeRebakeRequested = true; });
+		shaderHotReload.watch(backgroundShader, [&]() { probeRebakeRequested = true; });
 	}
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
-	// pbr: generate a 2D LUT from the BRDF equations used.
-	// ----------------------------------------------------
-	unsigned int brdfLUTTexture;
-	glGenTextures(1, &brdfLUTTexture);
-
-	// pre-allocate enough memory for the LUT texture.
-	glBindTexture(GL_TEXTURE_2D, brdfLUTTexture);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RG16F, 512, 512, 0, GL_RG, GL_FLOAT, 0);
-	// be sure to set wrapping mode to GL_CLAMP_TO_EDGE
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-	// then re-configure capture framebuffer object and render screen-space quad with BRDF shader.
-	glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
-	glBindRenderbuffer(GL_RENDERBUFFER, captureRBO);
-	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, 512, 512);
-	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, brdfLUTTexture, 0);
-
-	glViewport(0, 0, 512, 512);
-	brdfShader.use();
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-	renderQuad();
-
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
-
-	// initialize static shader uniforms before rendering
-	// --------------------------------------------------
 	glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
-	pbrShader.use();
-	pbrShader.setMat4("projection", projection);
-	backgroundShader.use();
-	backgroundShader.setMat4("projection", projection);
 
 	// then before rendering, configure the viewport to the original framebuffer's screen dimensions
 	int scrWidth, scrHeight;
@@ -369,6 +411,58 @@ int main()
 		// input
 		// -----
 		processInput(window);
+		if (environmentSwitchRequested)
+		{
+			environmentIndex = (environmentIndex + 1) % (sizeof(environmentPaths) / sizeof(environmentPaths[0]));
+			environment.load(environmentPaths[environmentIndex]);
+			environmentSwitchRequested = false;
+		}
+
+		// swap in the programs rebuilt since their sources were saved
+		if (SHADER_HOT_RELOAD)
+			shaderHotReload.update();
+
+		// continue a pending environment switch within this frame's GPU budget
+		environment.update(IBL_BAKE_BUDGET_MS);
+		if (probesAfterRebake && !environment.busy())
+		{
+			probeRebakeRequested = true;
+			probesAfterRebake = false;
+		}
+		if (storageReportRequested)
+		{
+			environment.requestStorageReport();
+			environment.load(environmentPaths[environmentIndex]);
+			storageReportRequested = false;
+		}
+		// local probes: bake (or load from the cache) for the current environment, once
+		// the whole scene can be captured
+		configureScenePrograms();
+		if (environment.envCubemap() != 0 && pbrConfigured && backgroundConfigured && iblBaker->ready())
+		{
+			if (environment.currentPath() != probeCacheTag)
+			{
+				probeCacheTag = environment.currentPath();
+				// the captures go through the pre-filter program, whose sample count is a tuning knob
+				probes.setCacheTag(probeCacheTag + "," + std::to_string(IBL_BAKE_QUALITY.prefilterSamples));
+			}
+			if (probeRebakeRequested)
+			{
+				probes.invalidateAll();
+				probeRebakeRequested = false;
+			}
+			probes.update(PROBES_PER_FRAME);
+		}
+		if (uniformStatsRequested)
+		{
+			printUniformStats("pbr", pbrShader);
+			printUniformStats("background", backgroundShader);
+			uniformStatsRequested = false;
+		}
+		// kept requested until the bake programs are ready
+		if (irradianceCompareRequested && environment.envCubemap() != 0
+			&& compareIrradianceModes(*iblBaker, environment.envCubemap(), environment.envResolution(), environment.irradianceResolution()))
+			irradianceCompareRequested = false;
 
 		// render
 		// ------
@@ -377,62 +471,12 @@ int main()
 
 		// render scene, supplying the convoluted irradiance map to the final shader.
 		// ------------------------------------------------------------------------------------------
-		pbrShader.use();
-		glm::mat4 view = camera.GetViewMatrix();
-		pbrShader.setMat4("view", view);
-		pbrShader.setVec3("camPos", camera.Position);
-
-		// bind pre-computed IBL data
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_CUBE_MAP, irradianceMap);
-		glActiveTexture(GL_TEXTURE1);
-		glBindTexture(GL_TEXTURE_CUBE_MAP, prefilterMap);
-		glActiveTexture(GL_TEXTURE2);
-		glBindTexture(GL_TEXTURE_2D, brdfLUTTexture);
-
-		// chair texture
-		glActiveTexture(GL_TEXTURE3);
-		glBindTexture(GL_TEXTURE_2D, chairAlbedoMap);
-		glActiveTexture(GL_TEXTURE4);
-		glBindTexture(GL_TEXTURE_2D, chairNormalMap);
-		glActiveTexture(GL_TEXTURE5);
-		glBindTexture(GL_TEXTURE_2D, chairMetallicMap);
-		glActiveTexture(GL_TEXTURE6);
-		glBindTexture(GL_TEXTURE_2D, chairRoughnessMap);
-		glActiveTexture(GL_TEXTURE7);
-		glBindTexture(GL_TEXTURE_2D, chairAOMap);
-
-		// Render model
-		glm::mat4 model = glm::mat4(1.0f);
-		model = glm::translate(model, glm::vec3(-10.0f, -10.0f, 10.0f)); // translate it down so it's at the center of the scene
-		model = glm::scale(model, glm::vec3(0.8f, 0.8f, 0.8f));	// it's a bit too big for our scene, so scale it down
-		pbrShader.setMat4("model", model);
-		ourModel.Draw(pbrShader);
-
-		// render light source (simply re-render sphere at light positions)
-		// this looks a bit off as we use the same shader, but it'll make their positions obvious and 
-		// keeps the codeprint small.
-		for (unsigned int i = 0; i < sizeof(lightPositions) / sizeof(lightPositions[0]); ++i)
+		if (pbrConfigured)
 		{
-			glm::vec3 newPos = lightPositions[i] + glm::vec3(sin(glfwGetTime() * 5.0) * 5.0, 0.0, 0.0);
-			newPos = lightPositions[i];
-			pbrShader.setVec3("lightPositions[" + std::to_string(i) + "]", newPos);
-			pbrShader.setVec3("lightColors[" + std::to_string(i) + "]", lightColors[i]);
-
-			model = glm::mat4(1.0f);
-			model = glm::translate(model, newPos);
-			model = glm::scale(model, glm::vec3(0.5f));
-			pbrShader.setMat4("model", model);
+			pbrShader.use();
+			probes.bind(pbrShader, 9);
 		}
-
-		// render skybox (render as last to prevent overdraw)
-		backgroundShader.use();
-		backgroundShader.setMat4("view", view);
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_CUBE_MAP, envCubemap);
-		//glBindTexture(GL_TEXTURE_CUBE_MAP, irradianceMap); // display irradiance map
-		//glBindTexture(GL_TEXTURE_CUBE_MAP, prefilterMap); // display prefilter map
-		renderCube();
+		drawScene(camera.GetViewMatrix(), projection, camera.Position, false);
 
 
 		// render BRDF map to screen
@@ -446,6 +490,16 @@ int main()
 		glfwPollEvents();
 	}
 
+	// a decode may still be writing into a mapped buffer of this context
+	environment.wait();
+	probes.wait();
+	shaderCompiler.stop();
+
+	// while the context is still current: the chair's geometry buffer goes with it (~Model),
+	// its textures once the cache collects them
+	chair.reset();
+	TextureCache::global().collect();
+
 	// glfw: terminate, clearing all previously allocated GLFW resources.
 	// ------------------------------------------------------------------
 	glfwTerminate();
@@ -467,6 +521,42 @@ void processInput(GLFWwindow* window)
 		camera.ProcessKeyboard(LEFT, deltaTime * 20);
 	if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
 		camera.ProcessKeyboard(RIGHT, deltaTime * 20);
+	// E: switch to the next HDR environment (a reload while there is one, see
+	// environmentPaths), C: compare the irradiance bake modes, R: report the error of the
+	// IBL storage formats, P: re-bake the reflection probes, U: print the uniform upload
+	// statistics
+	if (keyPressedOnce(window, GLFW_KEY_E))
+		environmentSwitchRequested = true;
+	if (keyPressedOnce(window, GLFW_KEY_C))
+		irradianceCompareRequested = true;
+	if (keyPressedOnce(window, GLFW_KEY_R))
+		storageReportRequested = true;
+	if (keyPressedOnce(window, GLFW_KEY_P))
+		probeRebakeRequested = true;
+	if (keyPressedOnce(window, GLFW_KEY_U))
+		uniformStatsRequested = true;
+}
+
+// uniform setter calls of a shader since the last report, then start counting again
+// ---------------------------------------------------------------------------------
+void printUniformStats(const char* name, Shader& shader)
+{
+	const ShaderUniformStats& stats = shader.statistics();
+	unsigned long total = stats.uploads + stats.redundant + stats.unknown;
+	std::cout << name << " shader: " << shader.activeUniforms().size() << " active uniforms, " << total << " sets, "
+		<< stats.uploads << " uploaded, " << stats.redundant << " redundant (skipped), " << stats.unknown << " to inactive names" << std::endl;
+	shader.resetStatistics();
+}
+
+// true only on the frame the key goes down, for toggles that shouldn't repeat while held
+// ---------------------------------------------------------------------------------------
+bool keyPressedOnce(GLFWwindow* window, int key)
+{
+	static std::map<int, bool> keyWasDown;
+	bool down = glfwGetKey(window, key) == GLFW_PRESS;
+	bool pressed = down && !keyWasDown[key];
+	keyWasDown[key] = down;
+	return pressed;
 }
 
 // glfw: whenever the window size changed (by OS or user resize) this callback function executes
@@ -646,5 +736,33 @@ unsigned int loadTex(char const* path)
 		stbi_image_free(data);
 	}
 
+	return texID;
+}
+
+// loads the split-sum BRDF LUT generated by tools/brdf_lut_gen.cpp; if the asset is
+// missing it is integrated on the CPU (all cores) once and written back for next time.
+unsigned int loadBRDFLUTTexture(unsigned int size)
+{
+	std::string path = brdfLUTPath(size);
+	std::vector<uint16_t> lut = loadBRDFLUT(path, size);
+	if (lut.empty())
+	{
+		std::cout << "BRDF LUT " << path << " not found, generating it on the CPU." << std::endl;
+		lut = generateBRDFLUT(size);
+		if (!saveBRDFLUT(path, size, 1024, lut))
+			std::cout << "Failed to write BRDF LUT " << path << std::endl;
+	}
+
+	unsigned int texID;
+	glGenTextures(1, &texID);
+	glBindTexture(GL_TEXTURE_2D, texID);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RG16F, size, size, 0, GL_RG, GL_HALF_FLOAT, lut.data());
+	// be sure to set wrapping mode to GL_CLAMP_TO_EDGE
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
 	return texID;
 }
\ No newline at end of file
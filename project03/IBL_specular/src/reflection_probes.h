@@ -0,0 +1,325 @@
+#ifndef _REFLECTION_PROBES_H_
+#define _REFLECTION_PROBES_H_
+
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <learnopengl/shader.h>
+
+#include "ibl_baker.h"
+#include "ibl_cache.h"
+#include "ibl_storage.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// keep in sync with MAX_REFLECTION_PROBES in 2.2.1.pbr.fs
+const unsigned int MAX_REFLECTION_PROBES = 8;
+
+const char PROBE_CACHE_MAGIC[] = "PRBE";
+
+// Local reflection probes. Every probe captures the scene around its position into a
+// cubemap, which is pre-filtered with the same GGX kernel as the global prefilterMap
+// (IBLBaker::prefilter) and copied into its slot of one R11G11B10F cubemap array.
+// pbr.fs blends the probes whose influence sphere contains the shaded point, with
+// parallax correction against that sphere, and falls back to the global map.
+//
+// Baking is incremental: update() bakes at most N probes per frame, so the cost per
+// frame is fixed no matter how many are dirty. Every bake is read back asynchronously
+// and written to the IBL cache (ibl_cache.h); the key covers the probe, the map layout
+// and the cache tag (the environment), so unchanged probes load from disk instead of
+// being captured again.
+//
+// needs cubemap arrays (GL 4.0 / ARB_texture_cube_map_array), see supported().
+class ReflectionProbes {
+public:
+	// renders the scene with the given view/projection from the given position,
+	// writing linear HDR color (no tonemapping).
+	typedef std::function<void(const glm::mat4& view, const glm::mat4& projection, const glm::vec3& position)> SceneRenderer;
+
+	ReflectionProbes(IBLBaker& baker, SceneRenderer renderScene, unsigned int size = 128, unsigned int mips = 5, unsigned int cacheVersion = 1)
+		: baker(baker), renderScene(renderScene), size(size), mips(mips), cacheVersion(cacheVersion)
+	{
+		if (!supported())
+		{
+			std::cout << "Cubemap arrays are not supported, reflection probes are disabled." << std::endl;
+			return;
+		}
+		array = allocateArray(GL_R11F_G11F_B10F);
+
+		// capture cubemap (with mips for the prefilter's source lookups) and its depth buffer
+		unsigned int captureLevels = 1;
+		while ((size >> captureLevels) > 0)
+			++captureLevels;
+		capture = iblAllocateMap(GL_TEXTURE_CUBE_MAP, baker.cubemapFormat(), size, captureLevels);
+		prefiltered = iblAllocateMap(GL_TEXTURE_CUBE_MAP, baker.cubemapFormat(), size, mips);
+		glGenFramebuffers(1, &captureFBO);
+		glGenRenderbuffers(1, &captureRBO);
+		glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
+		glBindRenderbuffer(GL_RENDERBUFFER, captureRBO);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, size, size);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, captureRBO);
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		glGenFramebuffers(1, &readFBO);
+		glGenFramebuffers(1, &drawFBO);
+
+		captureProjection = glm::perspective(glm::radians(90.0f), 1.0f, 0.1f, 100.0f);
+	}
+
+	static bool supported()
+	{
+		return GLEW_VERSION_4_0 || GLEW_ARB_texture_cube_map_array;
+	}
+
+	// adds a probe capturing at position and influencing shading within radius.
+	// returns its index, or -1 if all MAX_REFLECTION_PROBES slots are taken.
+	int addProbe(const glm::vec3& position, float radius)
+	{
+		if (!supported() || probes.size() >= MAX_REFLECTION_PROBES)
+			return -1;
+		Probe probe;
+		probe.position = position;
+		probe.radius = radius;
+		probes.push_back(probe);
+		int index = (int)probes.size() - 1;
+		probes[index].dirty = !loadCached(index);
+		return index;
+	}
+
+	// tag hashed into every cache key; changing it (e.g. to the new environment's path)
+	// reloads each probe from its cache entry for that tag or queues it for a bake.
+	void setCacheTag(const std::string& tag)
+	{
+		cacheTag = tag;
+		for (size_t i = 0; i < probes.size(); ++i)
+			probes[i].dirty = !loadCached((int)i);
+	}
+
+	// the scene around a probe changed, bake it again (over the next frames).
+	void invalidate(int probe)
+	{
+		probes[probe].dirty = true;
+	}
+	void invalidateAll()
+	{
+		for (size_t i = 0; i < probes.size(); ++i)
+			probes[i].dirty = true;
+	}
+
+	// with continuous updates the stalest probe is re-baked whenever none is dirty (dynamic scenes).
+	void setContinuousUpdate(bool enabled)
+	{
+		continuousUpdate = enabled;
+	}
+
+	// bake up to probesPerFrame probes, dirty ones first, and finish pending cache writes.
+	void update(unsigned int probesPerFrame)
+	{
+		cacheWriter.poll();
+		if (!supported())
+			return;
+		for (unsigned int n = 0; n < probesPerFrame; ++n)
+		{
+			int next = -1;
+			for (size_t i = 0; i < probes.size() && next < 0; ++i)
+				if (probes[i].dirty)
+					next = (int)i;
+			if (next < 0 && continuousUpdate && !probes.empty())
+			{
+				next = roundRobin;
+				roundRobin = (roundRobin + 1) % probes.size();
+			}
+			if (next < 0)
+				return;
+			bake(next);
+		}
+	}
+
+	// binds the probe array to textureUnit and sets the probe uniforms of the pbr shader.
+	void bind(Shader& shader, unsigned int textureUnit)
+	{
+		if (!supported())
+		{
+			shader.setInt("probeCount", 0);
+			return;
+		}
+		if (shader.ID != boundProgram)
+		{
+			for (unsigned int i = 0; i < MAX_REFLECTION_PROBES; ++i)
+				sphereHandles[i] = shader.uniform("probeSpheres[" + std::to_string(i) + "]");
+			countHandle = shader.uniform("probeCount");
+			maxLodHandle = shader.uniform("probeMaxLod");
+			boundProgram = shader.ID;
+		}
+		glActiveTexture(GL_TEXTURE0 + textureUnit);
+		glBindTexture(GL_TEXTURE_CUBE_MAP_ARRAY, array);
+		int baked = 0;
+		for (size_t i = 0; i < probes.size(); ++i)
+			if (probes[i].baked)
+			{
+				// slots are fixed per probe, so unbaked probes get a zero radius
+				shader.set(sphereHandles[i], glm::vec4(probes[i].position, probes[i].radius));
+				baked = (int)i + 1;
+			}
+			else
+				shader.set(sphereHandles[i], glm::vec4(0.0f));
+		shader.set(countHandle, baked);
+		shader.set(maxLodHandle, (float)(mips - 1));
+	}
+
+	size_t probeCount() const { return probes.size(); }
+	unsigned int bakedThisSession() const { return bakeCount; }
+
+	// block until pending cache files are written.
+	void wait()
+	{
+		cacheWriter.wait();
+	}
+
+private:
+	struct Probe {
+		glm::vec3 position;
+		float radius = 0.0f;
+		bool dirty = true;
+		bool baked = false;
+	};
+
+	IBLBaker& baker;
+	SceneRenderer renderScene;
+	unsigned int size;
+	unsigned int mips;
+	unsigned int cacheVersion;
+	std::string cacheTag;
+	bool continuousUpdate = false;
+	size_t roundRobin = 0;
+	unsigned int bakeCount = 0;
+
+	std::vector<Probe> probes;
+	unsigned int array = 0;
+	IBLStoredMap capture;
+	IBLStoredMap prefiltered;
+	unsigned int captureFBO = 0;
+	unsigned int captureRBO = 0;
+	unsigned int readFBO = 0;
+	unsigned int drawFBO = 0;
+	glm::mat4 captureProjection;
+	IBLCacheWriter cacheWriter;
+
+	// uniform handles of the last program bind() was called with
+	unsigned int boundProgram = 0;
+	UniformHandle sphereHandles[MAX_REFLECTION_PROBES];
+	UniformHandle countHandle = -1;
+	UniformHandle maxLodHandle = -1;
+
+	unsigned int allocateArray(GLenum internalFormat)
+	{
+		unsigned int texture;
+		glGenTextures(1, &texture);
+		glBindTexture(GL_TEXTURE_CUBE_MAP_ARRAY, texture);
+		for (unsigned int level = 0; level < mips; ++level)
+		{
+			unsigned int levelSize = std::max(size >> level, 1u);
+			glTexImage3D(GL_TEXTURE_CUBE_MAP_ARRAY, level, internalFormat, levelSize, levelSize, 6 * MAX_REFLECTION_PROBES, 0, GL_RGB, GL_FLOAT, nullptr);
+		}
+		glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_MAX_LEVEL, mips - 1);
+		return texture;
+	}
+
+	void bake(int index)
+	{
+		Probe& probe = probes[index];
+		GLint viewport[4];
+		glGetIntegerv(GL_VIEWPORT, viewport);
+
+		// 1. capture the scene into the six faces
+		const glm::vec3 targets[6] = {
+			glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(-1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f),
+			glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 0.0f, -1.0f)
+		};
+		const glm::vec3 ups[6] = {
+			glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f),
+			glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f)
+		};
+		glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
+		glViewport(0, 0, size, size);
+		for (unsigned int i = 0; i < 6; ++i)
+		{
+			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, capture.texture, 0);
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			renderScene(glm::lookAt(probe.position, probe.position + targets[i], ups[i]), captureProjection, probe.position);
+		}
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		for (unsigned int level = 1; level < capture.levels; ++level)
+			baker.downsample(capture.texture, size, level);
+
+		// 2. GGX pre-filter, every mip
+		for (unsigned int mip = 0; mip < mips; ++mip)
+			baker.prefilter(capture.texture, size, prefiltered.texture, size, mip, mips);
+
+		// 3. copy into the probe's slot of the array
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, readFBO);
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, drawFBO);
+		for (unsigned int level = 0; level < mips; ++level)
+			for (unsigned int face = 0; face < 6; ++face)
+			{
+				int levelSize = iblLevelSize(prefiltered, level);
+				glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, prefiltered.texture, level);
+				glFramebufferTextureLayer(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, array, level, index * 6 + face);
+				glBlitFramebuffer(0, 0, levelSize, levelSize, 0, 0, levelSize, levelSize, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+			}
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+
+		// 4. read the result back (asynchronously) for the disk cache
+		cacheWriter.write(cachePath(index), PROBE_CACHE_MAGIC, { size, mips }, prefiltered.texture, size, mips);
+
+		probe.dirty = false;
+		probe.baked = true;
+		++bakeCount;
+	}
+
+	std::string cachePath(int index) const
+	{
+		// everything the baked probe depends on
+		std::ostringstream key;
+		key << probes[index].position.x << ',' << probes[index].position.y << ',' << probes[index].position.z << ','
+			<< probes[index].radius << ',' << size << ',' << mips << ',' << cacheVersion << ',' << cacheTag;
+		return iblCachePath("probe", key.str());
+	}
+
+	bool loadCached(int index)
+	{
+		if (!supported())
+			return false;
+		std::vector<uint16_t> halves(iblCacheHalfCount(size, mips));
+		if (!iblReadCache(cachePath(index), PROBE_CACHE_MAGIC, { size, mips }, halves))
+			return false;
+
+		glBindTexture(GL_TEXTURE_CUBE_MAP_ARRAY, array);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 2); // rows are size * 6 bytes
+		size_t offset = 0;
+		for (unsigned int level = 0; level < mips; ++level)
+		{
+			unsigned int levelSize = std::max(size >> level, 1u);
+			glTexSubImage3D(GL_TEXTURE_CUBE_MAP_ARRAY, level, 0, 0, index * 6, levelSize, levelSize, 6, GL_RGB, GL_HALF_FLOAT, &halves[offset]);
+			offset += (size_t)levelSize * levelSize * 6 * 3;
+		}
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		probes[index].baked = true;
+		return true;
+	}
+};
+
+#endif
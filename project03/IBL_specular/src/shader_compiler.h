@@ -0,0 +1,113 @@
+#ifndef _SHADER_COMPILER_H_
+#define _SHADER_COMPILER_H_
+
+#pragma once
+
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <thread>
+
+// Gets programs built (Shader/ComputeShader constructed with BUILD_LATER) without holding
+// up the render thread; poll their ready() and draw with the ones that are.
+//
+// With KHR/ARB_parallel_shader_compile the driver compiles on its own threads, so build()
+// is simply issued on the render thread and the program's completion status polled.
+// Without it a worker thread with a hidden window, whose context shares objects with the
+// render context, builds the programs one after the other and flushes each before
+// handing it over. If that window can't be created the programs are built right away.
+class ShaderCompiler {
+public:
+	explicit ShaderCompiler(GLFWwindow* renderWindow)
+	{
+		if (GLEW_KHR_parallel_shader_compile)
+		{
+			glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+			return;
+		}
+		if (GLEW_ARB_parallel_shader_compile)
+		{
+			glMaxShaderCompilerThreadsARB(0xFFFFFFFF);
+			return;
+		}
+
+		// the other hints (version, profile) are still those of the render window
+		glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+		workerWindow = glfwCreateWindow(1, 1, "shader compiler", NULL, renderWindow);
+		glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
+		glfwMakeContextCurrent(renderWindow);
+		if (!workerWindow)
+		{
+			std::cout << "No shared context for shader compilation; building programs on the render thread" << std::endl;
+			return;
+		}
+		worker = std::thread([this]() { run(); });
+	}
+
+	// start building program; returns right away unless there is neither the extension
+	// nor a worker.
+	template <typename Program>
+	void compile(Program& program)
+	{
+		if (!workerWindow)
+		{
+			program.build();
+			return;
+		}
+		std::lock_guard<std::mutex> lock(mutex);
+		jobs.push_back([&program]() { program.build(true); });
+		wake.notify_one();
+	}
+
+	// join the worker (call before the render context is destroyed). programs still
+	// queued are not built.
+	void stop()
+	{
+		if (!worker.joinable())
+			return;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+			wake.notify_one();
+		}
+		worker.join();
+		glfwDestroyWindow(workerWindow);
+		workerWindow = NULL;
+	}
+
+	~ShaderCompiler() { stop(); }
+
+private:
+	GLFWwindow* workerWindow = NULL;
+	std::thread worker;
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::deque<std::function<void()>> jobs;
+	bool stopping = false;
+
+	void run()
+	{
+		glfwMakeContextCurrent(workerWindow);
+		for (;;)
+		{
+			std::function<void()> job;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				wake.wait(lock, [this]() { return stopping || !jobs.empty(); });
+				if (stopping)
+					break;
+				job = jobs.front();
+				jobs.pop_front();
+			}
+			job();
+		}
+		glfwMakeContextCurrent(NULL);
+	}
+};
+
+#endif
@@ -0,0 +1,229 @@
+#ifndef _SHADER_HOT_RELOAD_H_
+#define _SHADER_HOT_RELOAD_H_
+
+#pragma once
+
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+#include <learnopengl/shader_source.h>
+
+#include "shader_compiler.h"
+
+#include <sys/stat.h>
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+// Rebuilds Shader/ComputeShader programs whose source files (their stages and every
+// #include, see sourceFiles()) changed on disk, while the application keeps running:
+//  1. the files are watched with inotify on Linux (the directories, as editors save by
+//     renaming a new file over the old one) and by their modification time elsewhere;
+//  2. a changed program is read again (a changed include in ShaderSourceMap too) and
+//     built through the ShaderCompiler, i.e. on its background context or the driver's
+//     compiler threads, never stalling a frame;
+//  3. once built, it replaces the old one between frames (Program::adopt) if it linked;
+//     a failed compile prints its log and the old program stays in use;
+//  4. the reloaded callback then lets the owner redo what depends on the program
+//     (a bake stage, cached captures).
+// Call update() once per frame on the render thread, and stop() the compiler before
+// this is destroyed.
+class ShaderHotReload {
+public:
+	explicit ShaderHotReload(ShaderCompiler& compiler) : compiler(compiler)
+	{
+#ifdef __linux__
+		notify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+		if (notify < 0)
+			std::cout << "inotify is not available, polling the shader files instead" << std::endl;
+#endif
+	}
+
+	~ShaderHotReload()
+	{
+#ifdef __linux__
+		if (notify >= 0)
+			close(notify);
+#endif
+	}
+
+	// watch the files of program, which has to outlive this. reloaded runs on the render
+	// thread after a new version of it has been swapped in.
+	template <typename Program>
+	void watch(Program& program, const std::function<void()>& reloaded = std::function<void()>())
+	{
+		programs.push_back(std::unique_ptr<Watched>(new WatchedProgram<Program>(program, reloaded)));
+		watchFiles(*programs.back());
+	}
+
+	// start rebuilding the programs whose files changed and swap in the finished ones.
+	void update()
+	{
+		std::set<std::string> changed = changedFiles();
+		// the includes are kept in the source map, read once: refresh the edited ones
+		for (std::set<std::string>::const_iterator file = changed.begin(); file != changed.end(); ++file)
+			ShaderSourceMap::global().reloadFile(*file);
+		for (size_t i = 0; i < programs.size(); ++i)
+		{
+			Watched& watched = *programs[i];
+			for (size_t f = 0; f < watched.files().size(); ++f)
+				if (changed.count(watched.files()[f]))
+				{
+					watched.start(compiler);
+					break;
+				}
+			if (watched.poll(compiler))
+				watchFiles(watched); // its includes may have changed
+		}
+	}
+
+private:
+	// a watched program and the rebuild in flight, if any.
+	struct Watched {
+		virtual ~Watched() {}
+		virtual const std::vector<std::string>& files() const = 0;
+		virtual void start(ShaderCompiler& compiler) = 0;
+		// true if a new program was swapped in
+		virtual bool poll(ShaderCompiler& compiler) = 0;
+	};
+
+	template <typename Program>
+	struct WatchedProgram : Watched {
+		Program& program;
+		std::function<void()> reloaded;
+		std::unique_ptr<Program> next;
+		bool restart = false; // changed again while next was building
+
+		WatchedProgram(Program& program, const std::function<void()>& reloaded) : program(program), reloaded(reloaded) {}
+
+		const std::vector<std::string>& files() const { return program.sourceFiles(); }
+
+		void start(ShaderCompiler& compiler)
+		{
+			// the compiler's worker may still reference next, so it is only replaced once built
+			if (next)
+			{
+				restart = true;
+				return;
+			}
+			next = program.rebuilt();
+			compiler.compile(*next);
+		}
+
+		bool poll(ShaderCompiler& compiler)
+		{
+			if (!next || !next->ready())
+				return false;
+			bool adopted = program.adopt(*next);
+			std::cout << (adopted ? "Reloaded" : "Failed to reload, keeping the previous program of");
+			for (size_t i = 0; i < program.sourceFiles().size(); ++i)
+				std::cout << (i ? ", " : " ") << program.sourceFiles()[i];
+			std::cout << std::endl;
+			next.reset();
+			if (restart)
+			{
+				restart = false;
+				start(compiler);
+			}
+			if (adopted && reloaded)
+				reloaded();
+			return adopted;
+		}
+	};
+
+	ShaderCompiler& compiler;
+	std::vector<std::unique_ptr<Watched>> programs;
+	// modification time of every watched file, compared by the polling fallback
+	std::map<std::string, time_t> modified;
+#ifdef __linux__
+	int notify = -1;
+	std::map<int, std::string> directories; // watch descriptor -> directory
+	std::set<std::string> watchedDirectories;
+#endif
+	double nextPoll = 0.0;
+
+	// how often the modification times are checked without inotify (seconds)
+	static constexpr double POLL_INTERVAL = 0.25;
+
+	static std::string directoryOf(const std::string& path)
+	{
+		size_t slash = path.find_last_of("/\\");
+		return slash == std::string::npos ? std::string(".") : path.substr(0, slash);
+	}
+
+	static time_t modificationTime(const std::string& path)
+	{
+		struct stat info;
+		return stat(path.c_str(), &info) == 0 ? info.st_mtime : 0;
+	}
+
+	void watchFiles(const Watched& watched)
+	{
+		for (size_t i = 0; i < watched.files().size(); ++i)
+		{
+			const std::string& file = watched.files()[i];
+			if (!modified.count(file))
+				modified[file] = modificationTime(file);
+#ifdef __linux__
+			std::string directory = directoryOf(file);
+			if (notify < 0 || watchedDirectories.count(directory))
+				continue;
+			int wd = inotify_add_watch(notify, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+			if (wd < 0)
+				std::cout << "Failed to watch " << directory << " for shader changes" << std::endl;
+			else
+				directories[wd] = directory;
+			watchedDirectories.insert(directory);
+#endif
+		}
+	}
+
+	std::set<std::string> changedFiles()
+	{
+		std::set<std::string> changed;
+#ifdef __linux__
+		if (notify >= 0)
+		{
+			alignas(struct inotify_event) char buffer[4096];
+			ssize_t length;
+			while ((length = read(notify, buffer, sizeof(buffer))) > 0)
+				for (char* p = buffer; p < buffer + length; p += sizeof(struct inotify_event) + ((struct inotify_event*)p)->len)
+				{
+					const struct inotify_event* event = (const struct inotify_event*)p;
+					std::map<int, std::string>::const_iterator directory = directories.find(event->wd);
+					if (event->len == 0 || directory == directories.end())
+						continue;
+					std::string file = directory->second == "." ? std::string(event->name) : directory->second + "/" + event->name;
+					if (modified.count(file))
+						changed.insert(file);
+				}
+			return changed;
+		}
+#endif
+		double now = glfwGetTime();
+		if (now < nextPoll)
+			return changed;
+		nextPoll = now + POLL_INTERVAL;
+		for (std::map<std::string, time_t>::iterator it = modified.begin(); it != modified.end(); ++it)
+		{
+			time_t time = modificationTime(it->first);
+			if (time != it->second)
+			{
+				it->second = time;
+				changed.insert(it->first);
+			}
+		}
+		return changed;
+	}
+};
+
+#endif
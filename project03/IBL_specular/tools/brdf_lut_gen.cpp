@@ -0,0 +1,54 @@
+#define _CRT_SECURE_NO_WARNINGS
+// brdf_lut_gen: build step that bakes the split-sum BRDF LUT once on the CPU.
+//
+// usage: brdf_lut_gen [size ...] [-samples N] [-out directory]
+//   with no size given, writes the 64, 128 and 256 variants.
+//   proj03 loads resources/textures/brdf_lut_<BRDF_LUT_SIZE>.bin at startup.
+
+#include "../src/brdf_lut.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+int main(int argc, char** argv)
+{
+	std::vector<unsigned int> sizes;
+	unsigned int sampleCount = 1024;
+	std::string outDir = "resources/textures";
+	for (int i = 1; i < argc; ++i)
+	{
+		if (std::strcmp(argv[i], "-samples") == 0 && i + 1 < argc)
+			sampleCount = (unsigned int)std::atoi(argv[++i]);
+		else if (std::strcmp(argv[i], "-out") == 0 && i + 1 < argc)
+			outDir = argv[++i];
+		else
+			sizes.push_back((unsigned int)std::atoi(argv[i]));
+	}
+	if (sizes.empty())
+		sizes = { 64, 128, 256 };
+
+	for (unsigned int i = 0; i < sizes.size(); ++i)
+	{
+		unsigned int size = sizes[i];
+		if (size == 0)
+		{
+			std::cout << "brdf_lut_gen: invalid size" << std::endl;
+			return 1;
+		}
+		auto start = std::chrono::steady_clock::now();
+		std::vector<uint16_t> lut = generateBRDFLUT(size, sampleCount);
+		auto end = std::chrono::steady_clock::now();
+
+		std::string path = outDir + "/brdf_lut_" + std::to_string(size) + ".bin";
+		if (!saveBRDFLUT(path, size, sampleCount, lut))
+		{
+			std::cout << "brdf_lut_gen: failed to write " << path << std::endl;
+			return 1;
+		}
+		std::cout << "brdf_lut_gen: " << path << " (" << size << "x" << size << ", " << sampleCount << " samples/texel) in "
+			<< std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() << " ms" << std::endl;
+	}
+	return 0;
+}
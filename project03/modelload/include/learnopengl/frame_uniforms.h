@@ -0,0 +1,86 @@
+#ifndef FRAME_UNIFORMS_H
+#define FRAME_UNIFORMS_H
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <iostream>
+
+// Per-frame values every program shares (camera and lights), kept in one std140 uniform
+// buffer bound to FRAME_UNIFORMS_BINDING. The shaders declare
+//
+//     layout (std140) uniform FrameUniforms
+//     {
+//         mat4 projection;
+//         mat4 view;
+//         vec4 camPos;                             // xyz
+//         vec4 lightPositions[MAX_FRAME_LIGHTS];   // xyz
+//         vec4 lightColors[MAX_FRAME_LIGHTS];      // rgb
+//     };
+//
+// with MAX_FRAME_LIGHTS given by the application or defaulting to 4 like the constant
+// below, so the layout matches Data in every stage. fill data, then upload() once per
+// frame: a single buffer write instead of a set of uniforms per program.
+const GLuint FRAME_UNIFORMS_BINDING = 0;
+const unsigned int MAX_FRAME_LIGHTS = 4;
+
+class FrameUniforms
+{
+public:
+    // std140 layout of the block: mat4 and vec4 members need no padding (272 bytes)
+    struct Data
+    {
+        glm::mat4 projection;
+        glm::mat4 view;
+        glm::vec4 camPos;
+        glm::vec4 lightPositions[MAX_FRAME_LIGHTS];
+        glm::vec4 lightColors[MAX_FRAME_LIGHTS];
+    };
+    Data data;
+
+    FrameUniforms() : data()
+    {
+        glGenBuffers(1, &ubo);
+        glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(Data), NULL, GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        glBindBufferBase(GL_UNIFORM_BUFFER, FRAME_UNIFORMS_BINDING, ubo);
+    }
+
+    // point the program's FrameUniforms block at the shared binding (once after linking).
+    void attach(unsigned int program) const
+    {
+        GLuint index = glGetUniformBlockIndex(program, "FrameUniforms");
+        if (index == GL_INVALID_INDEX)
+        {
+            std::cout << "ERROR::FRAME_UNIFORMS::PROGRAM_HAS_NO_FRAMEUNIFORMS_BLOCK" << std::endl;
+            return;
+        }
+        glUniformBlockBinding(program, index, FRAME_UNIFORMS_BINDING);
+    }
+
+    void setCamera(const glm::mat4 &projection, const glm::mat4 &view, const glm::vec3 &position)
+    {
+        data.projection = projection;
+        data.view = view;
+        data.camPos = glm::vec4(position, 1.0f);
+    }
+
+    void setLight(unsigned int i, const glm::vec3 &position, const glm::vec3 &color)
+    {
+        data.lightPositions[i] = glm::vec4(position, 1.0f);
+        data.lightColors[i] = glm::vec4(color, 0.0f);
+    }
+
+    // write the whole block (one glBufferSubData).
+    void upload() const
+    {
+        glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(Data), &data);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    }
+
+private:
+    unsigned int ubo;
+};
+#endif
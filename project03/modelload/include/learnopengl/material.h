@@ -0,0 +1,126 @@
+#ifndef MATERIAL_H
+#define MATERIAL_H
+
+#include <GL/glew.h>
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// The textures of a mesh, resolved once into (texture, unit) slots so binding it is a few
+// glActiveTexture/glBindTexture calls without strings or uniform lookups:
+//  - every sampler name (texture_diffuse1, texture_specular1, ...) gets a texture unit of
+//    its own on first sight, the same for all materials (materialTextureUnit);
+//  - a program's samplers are set to those units once, when a material is first bound
+//    with it (and again for names seen since); textures the program doesn't sample are
+//    not bound, leaving its other units alone.
+// The program has to be in use when bind() is called.
+inline std::unordered_map<std::string, GLint> &materialTextureUnits()
+{
+    static std::unordered_map<std::string, GLint> units;
+    return units;
+}
+
+// the units in the order they were handed out, i.e. sampler name by unit
+inline std::vector<std::string> &materialSamplerNames()
+{
+    static std::vector<std::string> names;
+    return names;
+}
+
+inline GLint materialTextureUnit(const std::string &sampler)
+{
+    std::unordered_map<std::string, GLint>::const_iterator unit = materialTextureUnits().find(sampler);
+    if (unit != materialTextureUnits().end())
+        return unit->second;
+    GLint next = (GLint)materialSamplerNames().size();
+    materialTextureUnits()[sampler] = next;
+    materialSamplerNames().push_back(sampler);
+    return next;
+}
+
+class Material
+{
+public:
+    struct Slot
+    {
+        GLuint texture;
+        GLint unit;
+
+        bool operator==(const Slot &other) const { return texture == other.texture && unit == other.unit; }
+    };
+
+    Material() {}
+
+    // textures: (id, type) in the mesh's order; the N-th texture of a type goes to the
+    // sampler <type>N, as Mesh::Draw always named them.
+    template <typename TextureList>
+    explicit Material(const TextureList &textures)
+    {
+        unsigned int diffuseNr  = 1;
+        unsigned int specularNr = 1;
+        unsigned int normalNr   = 1;
+        unsigned int heightNr   = 1;
+        for (size_t i = 0; i < textures.size(); ++i)
+        {
+            std::string number;
+            const std::string &name = textures[i].type;
+            if (name == "texture_diffuse")
+                number = std::to_string(diffuseNr++);
+            else if (name == "texture_specular")
+                number = std::to_string(specularNr++);
+            else if (name == "texture_normal")
+                number = std::to_string(normalNr++);
+            else if (name == "texture_height")
+                number = std::to_string(heightNr++);
+            Slot slot;
+            slot.texture = textures[i].id;
+            slot.unit = materialTextureUnit(name + number);
+            slots.push_back(slot);
+        }
+    }
+
+    bool operator==(const Material &other) const { return slots == other.slots; }
+    bool operator!=(const Material &other) const { return !(*this == other); }
+
+    // binds the textures to their units, setting up program's samplers first if needed.
+    void bind(GLuint program) const
+    {
+        const std::vector<bool> &sampled = configure(program);
+        for (size_t i = 0; i < slots.size(); ++i)
+        {
+            if (!sampled[slots[i].unit])
+                continue;
+            glActiveTexture(GL_TEXTURE0 + slots[i].unit);
+            glBindTexture(GL_TEXTURE_2D, slots[i].texture);
+        }
+    }
+
+    const std::vector<Slot> &textureSlots() const { return slots; }
+
+private:
+    std::vector<Slot> slots;
+
+    // per program, by unit: whether it has that sampler (set up so far)
+    static std::unordered_map<GLuint, std::vector<bool> > &configuredPrograms()
+    {
+        static std::unordered_map<GLuint, std::vector<bool> > programs;
+        return programs;
+    }
+
+    static const std::vector<bool> &configure(GLuint program)
+    {
+        const std::vector<std::string> &names = materialSamplerNames();
+        std::vector<bool> &sampled = configuredPrograms()[program];
+        while (sampled.size() < names.size())
+        {
+            GLint unit = (GLint)sampled.size();
+            GLint location = glGetUniformLocation(program, names[unit].c_str());
+            if (location >= 0)
+                glUniform1i(location, unit);
+            sampled.push_back(location >= 0);
+        }
+        return sampled;
+    }
+};
+#endif
@@ -5,10 +5,16 @@
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/packing.hpp>
 
+#include <learnopengl/material.h>
 #include <learnopengl/shader.h>
 
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
 #include <string>
+#include <utility>
 #include <vector>
 using namespace std;
 
@@ -25,72 +31,372 @@ struct Vertex {
     glm::vec3 Bitangent;
 };
 
+// layout of a mesh's vertex buffer; the Vertex arrays on the CPU are always full.
+enum VertexFormat {
+    VERTEX_FULL,        // Vertex as it is, 56 bytes
+    VERTEX_PACKED,      // PackedVertex, 24 bytes
+    VERTEX_QUANTIZED    // QuantizedVertex, 20 bytes
+};
+
+// the normal and the tangent frame as the packed formats store them:
+//  - the normal octahedral encoded, two snorm16 (attribute 1, a normalized vec2);
+//  - the tangent octahedral encoded in the upper 15 bits of two int16 and the sign of the
+//    bitangent (cross(N, T) * sign) in bit 0 of the first (attribute 3, an ivec2);
+//  - the texture coordinates as two half floats (attribute 2).
+// 2.2.1.vertex_packing.glsl has the matching decode.
+struct PackedFrame {
+    int16_t  Normal[2];
+    int16_t  Tangent[2];
+    uint16_t TexCoords[2];
+};
+
+// float positions (attribute 0, a vec3)
+struct PackedVertex {
+    float       Position[3];
+    PackedFrame Frame;
+};
+
+// positions as unorm16 within the mesh bounds (attribute 0, a normalized vec3), the
+// shader scales them back with the mesh's positionOffset and positionScale, which reach it
+// as vertex attributes POSITION_OFFSET_ATTRIBUTE and POSITION_SCALE_ATTRIBUTE (5 and 6):
+// constant ones for Mesh::Draw, per draw ones in a GeometryBuffer.
+struct QuantizedVertex {
+    uint16_t    Position[4];    // w is padding
+    PackedFrame Frame;
+};
+
+// octahedral encoding of a unit vector, in [-1, 1]^2 (ibl_storage.h has the [0, 1] one of the maps).
+inline glm::vec2 signedOctahedralEncode(glm::vec3 v)
+{
+    v /= std::abs(v.x) + std::abs(v.y) + std::abs(v.z);
+    glm::vec2 e(v.x, v.y);
+    if (v.z < 0.0f)
+    {
+        e = glm::vec2((1.0f - std::abs(v.y)) * (v.x >= 0.0f ? 1.0f : -1.0f),
+                      (1.0f - std::abs(v.x)) * (v.y >= 0.0f ? 1.0f : -1.0f));
+    }
+    return e;
+}
+
+inline PackedFrame packFrame(const Vertex &vertex)
+{
+    PackedFrame frame;
+    glm::vec3 normal = vertex.Normal;
+    if (glm::dot(normal, normal) == 0.0f)
+        normal = glm::vec3(0.0f, 0.0f, 1.0f);
+    glm::vec2 n = signedOctahedralEncode(glm::normalize(normal));
+    frame.Normal[0] = (int16_t)glm::packSnorm1x16(n.x);
+    frame.Normal[1] = (int16_t)glm::packSnorm1x16(n.y);
+
+    // meshes without texture coordinates have no tangents; any vector orthogonal to N will do
+    glm::vec3 tangent = vertex.Tangent - normal * glm::dot(normal, vertex.Tangent) / glm::dot(normal, normal);
+    if (glm::dot(tangent, tangent) < 1e-12f)
+        tangent = std::abs(normal.x) < 0.9f ? glm::cross(normal, glm::vec3(1.0f, 0.0f, 0.0f)) : glm::cross(normal, glm::vec3(0.0f, 1.0f, 0.0f));
+    glm::vec2 t = signedOctahedralEncode(glm::normalize(tangent));
+    bool flipped = glm::dot(glm::cross(normal, tangent), vertex.Bitangent) < 0.0f;
+    int tx = (int)std::floor(glm::clamp(t.x, -1.0f, 1.0f) * 16383.0f + 0.5f);
+    int ty = (int)std::floor(glm::clamp(t.y, -1.0f, 1.0f) * 16383.0f + 0.5f);
+    frame.Tangent[0] = (int16_t)(tx * 2 + (flipped ? 1 : 0));
+    frame.Tangent[1] = (int16_t)(ty * 2);
+
+    frame.TexCoords[0] = glm::packHalf1x16(vertex.TexCoords.x);
+    frame.TexCoords[1] = glm::packHalf1x16(vertex.TexCoords.y);
+    return frame;
+}
+
+// attributes of the position decode of quantized vertices (offset + position * scale).
+// They are constant attributes (glVertexAttrib3fv) when a mesh is drawn on its own and
+// per draw arrays in a GeometryBuffer (learnopengl/geometry_buffer.h).
+const GLuint POSITION_OFFSET_ATTRIBUTE = 5;
+const GLuint POSITION_SCALE_ATTRIBUTE = 6;
+
+// bytes per vertex in a vertex buffer of format.
+inline size_t vertexSize(VertexFormat format)
+{
+    if (format == VERTEX_PACKED)
+        return sizeof(PackedVertex);
+    if (format == VERTEX_QUANTIZED)
+        return sizeof(QuantizedVertex);
+    return sizeof(Vertex);
+}
+
+// appends vertices in format to buffer. offset and scale get their position decode, the
+// identity unless the positions are quantized (to the bounds of these vertices).
+inline void packVertices(const vector<Vertex> &vertices, VertexFormat format, vector<unsigned char> &buffer,
+    glm::vec3 &offset, glm::vec3 &scale)
+{
+    offset = glm::vec3(0.0f);
+    scale = glm::vec3(1.0f);
+    size_t start = buffer.size();
+    buffer.resize(start + vertices.size() * vertexSize(format));
+    if (vertices.empty())
+        return;
+    unsigned char *out = &buffer[start];
+    if (format == VERTEX_FULL)
+    {
+        memcpy(out, &vertices[0], vertices.size() * sizeof(Vertex));
+    }
+    else if (format == VERTEX_PACKED)
+    {
+        PackedVertex *packed = (PackedVertex *)out;
+        for (size_t i = 0; i < vertices.size(); ++i)
+        {
+            packed[i].Position[0] = vertices[i].Position.x;
+            packed[i].Position[1] = vertices[i].Position.y;
+            packed[i].Position[2] = vertices[i].Position.z;
+            packed[i].Frame = packFrame(vertices[i]);
+        }
+    }
+    else
+    {
+        glm::vec3 low = vertices[0].Position, high = vertices[0].Position;
+        for (size_t i = 1; i < vertices.size(); ++i)
+        {
+            low = glm::min(low, vertices[i].Position);
+            high = glm::max(high, vertices[i].Position);
+        }
+        offset = low;
+        scale = high - low;
+        glm::vec3 inverse(0.0f);
+        for (int c = 0; c < 3; ++c)
+            if (scale[c] > 0.0f)
+                inverse[c] = 1.0f / scale[c];
+
+        QuantizedVertex *packed = (QuantizedVertex *)out;
+        for (size_t i = 0; i < vertices.size(); ++i)
+        {
+            glm::vec3 unit = (vertices[i].Position - low) * inverse;
+            for (int c = 0; c < 3; ++c)
+                packed[i].Position[c] = glm::packUnorm1x16(unit[c]);
+            packed[i].Position[3] = 0;
+            packed[i].Frame = packFrame(vertices[i]);
+        }
+    }
+}
+
+// points attributes 0 to 4 of the bound vertex array at the bound GL_ARRAY_BUFFER, which
+// holds vertices in format from its start.
+inline void setupVertexAttributes(VertexFormat format)
+{
+    if (format == VERTEX_FULL)
+    {
+        // vertex Positions
+        glEnableVertexAttribArray(0);	
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
+        // vertex normals
+        glEnableVertexAttribArray(1);	
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
+        // vertex texture coords
+        glEnableVertexAttribArray(2);	
+        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
+        // vertex tangent
+        glEnableVertexAttribArray(3);
+        glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Tangent));
+        // vertex bitangent
+        glEnableVertexAttribArray(4);
+        glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
+        return;
+    }
+
+    GLsizei stride = (GLsizei)vertexSize(format);
+    size_t frame = format == VERTEX_PACKED ? offsetof(PackedVertex, Frame) : offsetof(QuantizedVertex, Frame);
+    glEnableVertexAttribArray(0);
+    if (format == VERTEX_PACKED)
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)0);
+    else
+        glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, stride, (void*)0);
+    // the frame; there is no attribute 4 (the bitangent)
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 2, GL_SHORT, GL_TRUE, stride, (void*)(frame + offsetof(PackedFrame, Normal)));
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, stride, (void*)(frame + offsetof(PackedFrame, TexCoords)));
+    glEnableVertexAttribArray(3);
+    glVertexAttribIPointer(3, 2, GL_SHORT, stride, (void*)(frame + offsetof(PackedFrame, Tangent)));
+}
+
 struct Texture {
     unsigned int id;
     string type;
     string path;
 };
 
+// bytes held in system memory and on the GPU
+struct MemoryStats {
+    size_t cpuBytes = 0;
+    size_t gpuBytes = 0;
+
+    MemoryStats &operator+=(const MemoryStats &other)
+    {
+        cpuBytes += other.cpuBytes;
+        gpuBytes += other.gpuBytes;
+        return *this;
+    }
+};
+
 class Mesh {
 public:
     // mesh Data
     vector<Vertex>       vertices;
     vector<unsigned int> indices;
     vector<Texture>      textures;
+    Material             material;  // the textures' sampler bindings
+    // coarser levels of detail (1, 2, ...): index lists over the same vertices, see
+    // learnopengl/mesh_simplify.h; drawn through a GeometryBuffer
+    vector<vector<unsigned int> > lods;
+    // sizes of the geometry, also once the copies above are released
+    size_t vertexCount;
+    size_t indexCount;
+    // bounds of the vertices: box and the sphere around its centre
+    glm::vec3 boundsMin;
+    glm::vec3 boundsMax;
+    glm::vec3 sphereCenter;
+    float sphereRadius;
     unsigned int VAO;
+    VertexFormat format;
+    // quantized positions are positionOffset + position * positionScale
+    glm::vec3 positionOffset;
+    glm::vec3 positionScale;
 
-    // constructor
-    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures)
+    // constructor; the arrays are moved in (pass them with std::move to avoid any copy).
+    // without ownBuffers the mesh is drawn from a GeometryBuffer it is added to and gets no
+    // buffers of its own.
+    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures, VertexFormat format = VERTEX_FULL,
+        bool ownBuffers = true)
+        : vertices(std::move(vertices)), indices(std::move(indices)), textures(std::move(textures)),
+          vertexCount(this->vertices.size()), indexCount(this->indices.size()),
+          VAO(0), format(format), positionOffset(0.0f), positionScale(1.0f), VBO(0), EBO(0)
     {
-        this->vertices = vertices;
-        this->indices = indices;
-        this->textures = textures;
+        material = Material(this->textures);
+        computeBounds();
 
         // now that we have all the required data, set the vertex buffers and its attribute pointers.
-        setupMesh();
+        if (ownBuffers)
+            setupMesh();
+    }
+
+    // its own buffers (if any) are deleted with it, on the GL thread while the context is
+    // current. meshes are kept in a vector: moved, the buffers going along, never copied.
+    ~Mesh()
+    {
+        deleteBuffers();
+    }
+
+    Mesh(const Mesh &) = delete;
+    Mesh &operator=(const Mesh &) = delete;
+
+    Mesh(Mesh &&other) noexcept
+        : VAO(0), VBO(0), EBO(0)
+    {
+        *this = std::move(other);
+    }
+
+    Mesh &operator=(Mesh &&other) noexcept
+    {
+        if (this == &other)
+            return *this;
+        deleteBuffers();
+        vertices = std::move(other.vertices);
+        indices = std::move(other.indices);
+        textures = std::move(other.textures);
+        material = std::move(other.material);
+        lods = std::move(other.lods);
+        vertexCount = other.vertexCount;
+        indexCount = other.indexCount;
+        boundsMin = other.boundsMin;
+        boundsMax = other.boundsMax;
+        sphereCenter = other.sphereCenter;
+        sphereRadius = other.sphereRadius;
+        format = other.format;
+        positionOffset = other.positionOffset;
+        positionScale = other.positionScale;
+        VAO = other.VAO;
+        VBO = other.VBO;
+        EBO = other.EBO;
+        bufferBytes = other.bufferBytes;
+        other.VAO = other.VBO = other.EBO = 0;
+        other.bufferBytes = 0;
+        return *this;
     }
 
-    // render the mesh
+    // render the mesh (at full detail)
     void Draw(Shader &shader) 
     {
         // bind appropriate textures
-        unsigned int diffuseNr  = 1;
-        unsigned int specularNr = 1;
-        unsigned int normalNr   = 1;
-        unsigned int heightNr   = 1;
-        for(unsigned int i = 0; i < textures.size(); i++)
-        {
-            glActiveTexture(GL_TEXTURE0 + i); // active proper texture unit before binding
-            // retrieve texture number (the N in diffuse_textureN)
-            string number;
-            string name = textures[i].type;
-            if(name == "texture_diffuse")
-                number = std::to_string(diffuseNr++);
-            else if(name == "texture_specular")
-                number = std::to_string(specularNr++); // transfer unsigned int to stream
-            else if(name == "texture_normal")
-                number = std::to_string(normalNr++); // transfer unsigned int to stream
-             else if(name == "texture_height")
-                number = std::to_string(heightNr++); // transfer unsigned int to stream
-
-            // now set the sampler to the correct texture unit
-            glUniform1i(glGetUniformLocation(shader.ID, (name + number).c_str()), i);
-            // and finally bind the texture
-            glBindTexture(GL_TEXTURE_2D, textures[i].id);
-        }
-        
+        material.bind(shader.ID);
+        setPositionDecode();
+
         // draw mesh
         glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
+        glDrawElements(GL_TRIANGLES, (GLsizei)indexCount, GL_UNSIGNED_INT, 0);
         glBindVertexArray(0);
 
         // always good practice to set everything back to defaults once configured.
         glActiveTexture(GL_TEXTURE0);
     }
 
+    // frees the vertices, indices and levels kept in system memory, once they are in a
+    // buffer (its own, or a GeometryBuffer the mesh was added to); bounds and counts stay.
+    void releaseGeometry()
+    {
+        vector<Vertex>().swap(vertices);
+        vector<unsigned int>().swap(indices);
+        vector<vector<unsigned int> >().swap(lods);
+    }
+
+    // the copies in system memory and the mesh's own buffers (a GeometryBuffer's are
+    // counted by the Model)
+    MemoryStats memoryUsage() const
+    {
+        MemoryStats stats;
+        stats.cpuBytes = vertices.capacity() * sizeof(Vertex) + indices.capacity() * sizeof(unsigned int);
+        for (size_t i = 0; i < lods.size(); ++i)
+            stats.cpuBytes += lods[i].capacity() * sizeof(unsigned int);
+        stats.gpuBytes = bufferBytes;
+        return stats;
+    }
+
+    // the position decode as constant attributes (the identity for float positions, so a
+    // shader can serve all formats).
+    void setPositionDecode() const
+    {
+        glVertexAttrib3fv(POSITION_OFFSET_ATTRIBUTE, &positionOffset[0]);
+        glVertexAttrib3fv(POSITION_SCALE_ATTRIBUTE, &positionScale[0]);
+    }
+
 private:
     // render data 
     unsigned int VBO, EBO;
+    size_t bufferBytes = 0;
+
+    void computeBounds()
+    {
+        boundsMin = boundsMax = vertices.empty() ? glm::vec3(0.0f) : vertices[0].Position;
+        for (size_t i = 1; i < vertices.size(); ++i)
+        {
+            boundsMin = glm::min(boundsMin, vertices[i].Position);
+            boundsMax = glm::max(boundsMax, vertices[i].Position);
+        }
+        sphereCenter = (boundsMin + boundsMax) * 0.5f;
+        float radius2 = 0.0f;
+        for (size_t i = 0; i < vertices.size(); ++i)
+        {
+            glm::vec3 d = vertices[i].Position - sphereCenter;
+            radius2 = glm::max(radius2, glm::dot(d, d));
+        }
+        sphereRadius = glm::sqrt(radius2);
+    }
+
+    void deleteBuffers()
+    {
+        if (VAO)
+            glDeleteVertexArrays(1, &VAO);
+        if (VBO)
+            glDeleteBuffers(1, &VBO);
+        if (EBO)
+            glDeleteBuffers(1, &EBO);
+        VAO = VBO = EBO = 0;
+        bufferBytes = 0;
+    }
 
     // initializes all the buffer objects/arrays
     void setupMesh()
@@ -103,30 +409,16 @@ private:
         glBindVertexArray(VAO);
         // load data into vertex buffers
         glBindBuffer(GL_ARRAY_BUFFER, VBO);
-        // A great thing about structs is that their memory layout is sequential for all its items.
-        // The effect is that we can simply pass a pointer to the struct and it translates perfectly to a glm::vec3/2 array which
-        // again translates to 3/2 floats which translates to a byte array.
-        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);  
+        vector<unsigned char> packed;
+        packVertices(vertices, format, packed, positionOffset, positionScale);
+        glBufferData(GL_ARRAY_BUFFER, packed.size(), packed.empty() ? nullptr : &packed[0], GL_STATIC_DRAW);  
 
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.empty() ? nullptr : &indices[0], GL_STATIC_DRAW);
+        bufferBytes = packed.size() + indices.size() * sizeof(unsigned int);
 
         // set the vertex attribute pointers
-        // vertex Positions
-        glEnableVertexAttribArray(0);	
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
-        // vertex normals
-        glEnableVertexAttribArray(1);	
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
-        // vertex texture coords
-        glEnableVertexAttribArray(2);	
-        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
-        // vertex tangent
-        glEnableVertexAttribArray(3);
-        glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Tangent));
-        // vertex bitangent
-        glEnableVertexAttribArray(4);
-        glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
+        setupVertexAttributes(format);
 
         glBindVertexArray(0);
     }
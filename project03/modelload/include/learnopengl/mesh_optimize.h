@@ -0,0 +1,337 @@
+#ifndef MESH_OPTIMIZE_H
+#define MESH_OPTIMIZE_H
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/mesh.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+// Reordering of an imported triangle list for the GPU, in three passes:
+//  1. optimizeVertexCache: triangles in the order of Forsyth's "Linear-Speed Vertex Cache
+//     Optimisation", so the post-transform cache serves most vertices again;
+//  2. optimizeOverdraw: that order cut into clusters (Tipsify's, Sander et al. 2007, where
+//     the cache restarts anyway or the cluster is no worse than threshold times the whole)
+//     and the clusters sorted to draw the outward facing ones first;
+//  3. optimizeVertexFetch: the vertices renumbered in the order the indices first use them,
+//     so the vertex fetch reads the buffer front to back (unused vertices are dropped).
+// analyzeVertexCache measures the result with a FIFO cache like the hardware's.
+
+// cache misses of a triangle list; ACMR is misses per triangle (0.5 to 3), ATVR misses
+// per referenced vertex (1 is ideal).
+struct VertexCacheStats {
+    size_t triangles = 0;
+    size_t vertices = 0;
+    size_t misses = 0;
+
+    float acmr() const { return triangles ? (float)misses / triangles : 0.0f; }
+    float atvr() const { return vertices ? (float)misses / vertices : 0.0f; }
+
+    VertexCacheStats &operator+=(const VertexCacheStats &other)
+    {
+        triangles += other.triangles;
+        vertices += other.vertices;
+        misses += other.misses;
+        return *this;
+    }
+};
+
+// entries of the FIFO cache analyzeVertexCache simulates
+const unsigned int VERTEX_CACHE_FIFO_SIZE = 16;
+
+inline VertexCacheStats analyzeVertexCache(const vector<unsigned int> &indices, size_t vertexCount,
+    unsigned int cacheSize = VERTEX_CACHE_FIFO_SIZE)
+{
+    VertexCacheStats stats;
+    stats.triangles = indices.size() / 3;
+    // the time each vertex entered the cache; it is still there while misses - time < cacheSize
+    vector<size_t> entered(vertexCount, 0);
+    vector<bool> referenced(vertexCount, false);
+    for (size_t i = 0; i < indices.size(); ++i)
+    {
+        unsigned int v = indices[i];
+        if (!referenced[v])
+        {
+            referenced[v] = true;
+            ++stats.vertices;
+        }
+        else if (stats.misses - entered[v] < cacheSize)
+            continue;
+        entered[v] = stats.misses++;
+    }
+    return stats;
+}
+
+// Forsyth's scoring of a vertex in an LRU cache of this size
+const int VERTEX_CACHE_LRU_SIZE = 32;
+
+inline float forsythVertexScore(int cachePosition, unsigned int remainingTriangles)
+{
+    if (remainingTriangles == 0)
+        return -1.0f;
+    float score = 0.0f;
+    if (cachePosition >= 0)
+    {
+        // the last triangle's vertices score the same, so its order doesn't matter
+        if (cachePosition < 3)
+            score = 0.75f;
+        else
+            score = std::pow(1.0f - (float)(cachePosition - 3) / (VERTEX_CACHE_LRU_SIZE - 3), 1.5f);
+    }
+    // vertices with few triangles left are finished first, leaving no stragglers
+    return score + 2.0f / std::sqrt((float)remainingTriangles);
+}
+
+inline vector<unsigned int> optimizeVertexCache(const vector<unsigned int> &indices, size_t vertexCount)
+{
+    size_t triangleCount = indices.size() / 3;
+    vector<unsigned int> result;
+    result.reserve(triangleCount * 3);
+
+    // triangles of each vertex
+    vector<unsigned int> remaining(vertexCount, 0);
+    for (size_t i = 0; i < triangleCount * 3; ++i)
+        ++remaining[indices[i]];
+    vector<size_t> firstTriangle(vertexCount + 1, 0);
+    for (size_t v = 0; v < vertexCount; ++v)
+        firstTriangle[v + 1] = firstTriangle[v] + remaining[v];
+    vector<unsigned int> adjacency(firstTriangle[vertexCount]);
+    {
+        vector<size_t> fill(firstTriangle.begin(), firstTriangle.end() - 1);
+        for (size_t i = 0; i < triangleCount * 3; ++i)
+            adjacency[fill[indices[i]]++] = (unsigned int)(i / 3);
+    }
+
+    vector<float> vertexScore(vertexCount);
+    for (size_t v = 0; v < vertexCount; ++v)
+        vertexScore[v] = forsythVertexScore(-1, remaining[v]);
+    vector<float> triangleScore(triangleCount);
+    for (size_t t = 0; t < triangleCount; ++t)
+        triangleScore[t] = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+    vector<bool> emitted(triangleCount, false);
+
+    // the LRU cache, with room for the three vertices pushed in front of it
+    vector<unsigned int> cache, nextCache;
+    cache.reserve(VERTEX_CACHE_LRU_SIZE + 3);
+    nextCache.reserve(VERTEX_CACHE_LRU_SIZE + 3);
+
+    // restarts: the vertices of the emitted triangles, latest last, then the triangles in
+    // input order; both only advance, so the restarts cost O(T) together
+    vector<unsigned int> deadEnd;
+    deadEnd.reserve(triangleCount * 3);
+    size_t scan = 0; // no triangle before this is left
+    long best = -1;
+    for (size_t emittedCount = 0; emittedCount < triangleCount; ++emittedCount)
+    {
+        if (best < 0)
+        {
+            // nothing in the cache touches a triangle left: the best one of the latest
+            // vertex that has some, else the next one left
+            float bestScore = -1.0f;
+            while (best < 0 && !deadEnd.empty())
+            {
+                unsigned int v = deadEnd.back();
+                deadEnd.pop_back();
+                for (unsigned int j = 0; j < remaining[v]; ++j)
+                {
+                    unsigned int t = adjacency[firstTriangle[v] + j];
+                    if (triangleScore[t] > bestScore)
+                    {
+                        bestScore = triangleScore[t];
+                        best = (long)t;
+                    }
+                }
+            }
+            if (best < 0)
+            {
+                while (emitted[scan])
+                    ++scan;
+                best = (long)scan;
+            }
+        }
+        const unsigned int *triangle = &indices[best * 3];
+        result.insert(result.end(), triangle, triangle + 3);
+        emitted[best] = true;
+        deadEnd.insert(deadEnd.end(), triangle, triangle + 3);
+
+        // move its vertices to the front of the cache and take it off their lists
+        nextCache.assign(triangle, triangle + 3);
+        for (size_t i = 0; i < cache.size(); ++i)
+            if (cache[i] != triangle[0] && cache[i] != triangle[1] && cache[i] != triangle[2])
+                nextCache.push_back(cache[i]);
+        for (int k = 0; k < 3; ++k)
+        {
+            unsigned int v = triangle[k];
+            unsigned int *list = &adjacency[firstTriangle[v]];
+            for (unsigned int j = 0; j < remaining[v]; ++j)
+                if (list[j] == (unsigned int)best)
+                {
+                    list[j] = list[remaining[v] - 1];
+                    --remaining[v];
+                    break;
+                }
+        }
+        cache.swap(nextCache);
+
+        // rescore the cached vertices (and the ones that just fell out) and their triangles
+        for (size_t i = 0; i < cache.size(); ++i)
+        {
+            unsigned int v = cache[i];
+            float score = forsythVertexScore(i < (size_t)VERTEX_CACHE_LRU_SIZE ? (int)i : -1, remaining[v]);
+            float delta = score - vertexScore[v];
+            vertexScore[v] = score;
+            for (unsigned int j = 0; j < remaining[v]; ++j)
+                triangleScore[adjacency[firstTriangle[v] + j]] += delta;
+        }
+        if (cache.size() > (size_t)VERTEX_CACHE_LRU_SIZE)
+            cache.resize(VERTEX_CACHE_LRU_SIZE);
+
+        // the next one is the best triangle of the cached vertices
+        best = -1;
+        float bestScore = -1.0f;
+        for (size_t i = 0; i < cache.size(); ++i)
+        {
+            unsigned int v = cache[i];
+            for (unsigned int j = 0; j < remaining[v]; ++j)
+            {
+                unsigned int t = adjacency[firstTriangle[v] + j];
+                if (triangleScore[t] > bestScore)
+                {
+                    bestScore = triangleScore[t];
+                    best = (long)t;
+                }
+            }
+        }
+    }
+    return result;
+}
+
+// threshold: how much worse than the whole mesh a cluster's ACMR may be when it ends at a
+// point the cache doesn't restart; larger values give smaller clusters, better sorted.
+inline vector<unsigned int> optimizeOverdraw(const vector<unsigned int> &indices, const vector<Vertex> &vertices,
+    float threshold = 1.05f)
+{
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount < 2)
+        return indices;
+
+    // cluster boundaries along the cache order, with the FIFO of analyzeVertexCache. a
+    // cluster may be drawn after any other, so its misses are counted from an empty cache
+    // (clock jumps past every entry at a boundary).
+    float limit = analyzeVertexCache(indices, vertices.size()).acmr() * threshold;
+    vector<size_t> clusters(1, 0);
+    vector<size_t> entered(vertices.size(), 0);
+    vector<bool> referenced(vertices.size(), false);
+    size_t clock = 0, clusterMisses = 0;
+    for (size_t t = 0; t < triangleCount; ++t)
+    {
+        unsigned int triangleMisses = 0;
+        for (int k = 0; k < 3; ++k)
+        {
+            unsigned int v = indices[t * 3 + k];
+            if (referenced[v] && clock - entered[v] < VERTEX_CACHE_FIFO_SIZE)
+                continue;
+            referenced[v] = true;
+            entered[v] = clock++;
+            ++triangleMisses;
+        }
+        if (t > clusters.back() && triangleMisses == 3)
+        {
+            // nothing of the cluster so far is reused: a boundary for free
+            clusters.push_back(t);
+            clusterMisses = 0;
+        }
+        clusterMisses += triangleMisses;
+        if (t + 1 < triangleCount && t > clusters.back() && (float)clusterMisses / (t + 1 - clusters.back()) <= limit)
+        {
+            clusters.push_back(t + 1);
+            clusterMisses = 0;
+            clock += VERTEX_CACHE_FIFO_SIZE;
+        }
+    }
+    clusters.push_back(triangleCount);
+
+    // area weighted centroid and normal of the mesh and of each cluster
+    size_t clusterCount = clusters.size() - 1;
+    vector<glm::vec3> centroid(clusterCount, glm::vec3(0.0f));
+    vector<glm::vec3> normal(clusterCount, glm::vec3(0.0f));
+    glm::vec3 meshCentroid(0.0f);
+    float meshArea = 0.0f;
+    for (size_t c = 0; c < clusterCount; ++c)
+    {
+        float area = 0.0f;
+        for (size_t t = clusters[c]; t < clusters[c + 1]; ++t)
+        {
+            glm::vec3 a = vertices[indices[t * 3]].Position;
+            glm::vec3 b = vertices[indices[t * 3 + 1]].Position;
+            glm::vec3 d = vertices[indices[t * 3 + 2]].Position;
+            glm::vec3 n = glm::cross(b - a, d - a);
+            float triangleArea = glm::length(n);
+            centroid[c] += (a + b + d) * (triangleArea / 3.0f);
+            normal[c] += n;
+            area += triangleArea;
+        }
+        meshCentroid += centroid[c];
+        meshArea += area;
+        if (area > 0.0f)
+            centroid[c] /= area;
+    }
+    if (meshArea > 0.0f)
+        meshCentroid /= meshArea;
+
+    // outward facing clusters (seen from outside the mesh, in front of the others) first
+    vector<float> key(clusterCount);
+    vector<size_t> order(clusterCount);
+    for (size_t c = 0; c < clusterCount; ++c)
+    {
+        float length = glm::length(normal[c]);
+        key[c] = length > 0.0f ? glm::dot(centroid[c] - meshCentroid, normal[c] / length) : 0.0f;
+        order[c] = c;
+    }
+    std::stable_sort(order.begin(), order.end(), [&key](size_t a, size_t b) { return key[a] > key[b]; });
+
+    vector<unsigned int> result;
+    result.reserve(indices.size());
+    for (size_t i = 0; i < clusterCount; ++i)
+        result.insert(result.end(), indices.begin() + clusters[order[i]] * 3, indices.begin() + clusters[order[i] + 1] * 3);
+    return result;
+}
+
+// renumbers the vertices in the order of first use; drops the ones no triangle uses.
+inline void optimizeVertexFetch(vector<Vertex> &vertices, vector<unsigned int> &indices)
+{
+    const unsigned int UNUSED = ~0u;
+    vector<unsigned int> remap(vertices.size(), UNUSED);
+    vector<Vertex> ordered;
+    ordered.reserve(vertices.size());
+    for (size_t i = 0; i < indices.size(); ++i)
+    {
+        unsigned int &target = remap[indices[i]];
+        if (target == UNUSED)
+        {
+            target = (unsigned int)ordered.size();
+            ordered.push_back(vertices[indices[i]]);
+        }
+        indices[i] = target;
+    }
+    vertices.swap(ordered);
+}
+
+// all three passes; before and after (may be null) get the cache statistics of the input
+// and the result.
+inline void optimizeMesh(vector<Vertex> &vertices, vector<unsigned int> &indices,
+    VertexCacheStats *before = nullptr, VertexCacheStats *after = nullptr)
+{
+    indices.resize(indices.size() / 3 * 3);
+    if (before)
+        *before = analyzeVertexCache(indices, vertices.size());
+    indices = optimizeVertexCache(indices, vertices.size());
+    indices = optimizeOverdraw(indices, vertices);
+    optimizeVertexFetch(vertices, indices);
+    if (after)
+        *after = analyzeVertexCache(indices, vertices.size());
+}
+#endif
@@ -10,86 +10,465 @@
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
 
+#include <learnopengl/frustum.h>
+#include <learnopengl/geometry_buffer.h>
 #include <learnopengl/mesh.h>
+#include <learnopengl/mesh_cache.h>
+#include <learnopengl/mesh_optimize.h>
+#include <learnopengl/mesh_simplify.h>
+#include <learnopengl/parallel.h>
 #include <learnopengl/shader.h>
+#include <learnopengl/texture_cache.h>
+#include <learnopengl/texture_loader.h>
 
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <limits>
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <iostream>
 #include <map>
+#include <memory>
+#include <unordered_map>
 #include <vector>
 using namespace std;
 
 unsigned int TextureFromFile(const char *path, const string &directory, bool gamma = false);
 
+// post-processing of every import; part of the mesh cache key. the identical vertices are
+// joined, so triangles share them (without, OBJ and FBX faces each get three of their own
+// and neither the vertex cache order nor the simplification has anything to work with).
+const unsigned int MODEL_IMPORT_FLAGS = aiProcess_Triangulate | aiProcess_JoinIdenticalVertices | aiProcess_GenSmoothNormals
+    | aiProcess_FlipUVs | aiProcess_CalcTangentSpace;
+
+// Model::SelectLod: a model is drawn at full detail down to this size on screen (the
+// diameter of its bounding sphere), one level coarser at every halving; a level changes
+// once the size is this fraction past the threshold
+const float MODEL_LOD_FULL_DETAIL_PIXELS = 400.0f;
+const float MODEL_LOD_HYSTERESIS = 0.15f;
+
 class Model 
 {
 public:
     // model data 
-    vector<Texture> textures_loaded;	// stores all the textures loaded so far, optimization to make sure textures aren't loaded more than once.
+    vector<Texture> textures_loaded;	// the model's textures, each file once; shared with other models through TextureCache::global().
     vector<Mesh>    meshes;
     string directory;
     bool gammaCorrection;
+    VertexFormat vertexFormat;  // of the meshes' vertex buffers
+    // whether the meshes keep their vertices and indices in system memory once they are in
+    // the geometry buffer (Mesh::releaseGeometry)
+    bool keepCpuGeometry;
+    // bounding sphere of the meshes, in model space
+    glm::vec3 boundsCenter = glm::vec3(0.0f);
+    float boundsRadius = 0.0f;
+    unsigned int lodCount = 1;  // levels of detail, the full one included
+    unsigned int lodLevel = 0;  // the one Draw uses (0: full detail), see SelectLod
+    CullingStats cullingStats;  // meshes the last Cull kept and dropped
 
-    // constructor, expects a filepath to a 3D model.
-    Model(string const &path, bool gamma = false) : gammaCorrection(gamma)
+    // constructor, expects a filepath to a 3D model. the meshes share a vertex and an
+    // index buffer of the model's own.
+    Model(string const &path, bool gamma = false, VertexFormat format = VERTEX_FULL, bool keepCpuGeometry = true)
+        : gammaCorrection(gamma), vertexFormat(format), keepCpuGeometry(keepCpuGeometry),
+          ownGeometry(new GeometryBuffer(format)), geometry(ownGeometry.get())
     {
         loadModel(path);
+        geometry->upload();
+    }
+
+    // the meshes go into geometry (in its format), shared with other models; upload() it
+    // after the last of them is loaded, before drawing.
+    Model(string const &path, GeometryBuffer &geometry, bool gamma = false, bool keepCpuGeometry = true)
+        : gammaCorrection(gamma), vertexFormat(geometry.vertexFormat()), keepCpuGeometry(keepCpuGeometry), geometry(&geometry)
+    {
+        loadModel(path);
+    }
+
+    // drops the model's references to its textures (TextureCache::collect deletes them).
+    ~Model()
+    {
+        for (size_t i = 0; i < textures_loaded.size(); ++i)
+            TextureCache::global().release(textures_loaded[i].id);
     }
 
-    // draws the model, and thus all its meshes
+    // draws the model, and thus all its meshes the last Cull kept, at lodLevel: consecutive
+    // meshes with the same material in one call (see GeometryBuffer::draw), the material
+    // bound only when it changes.
     void Draw(Shader &shader)
     {
-        for(unsigned int i = 0; i < meshes.size(); i++)
-            meshes[i].Draw(shader);
+        if (!geometry->uploaded())
+        {
+            cout << "ERROR::MODEL::GEOMETRY_NOT_UPLOADED" << endl;
+            return;
+        }
+        geometry->bind();
+        unsigned int level = std::min(lodLevel, lodCount - 1);
+        const Material *bound = nullptr;
+        for (size_t i = 0; i < runs.size(); ++i)
+        {
+            unsigned int end = runs[i].first + runs[i].count;
+            for (unsigned int first = runs[i].first; first < end; )
+            {
+                if (!meshVisible[first])
+                {
+                    ++first;
+                    continue;
+                }
+                unsigned int last = first + 1;
+                while (last < end && meshVisible[last])
+                    ++last;
+                const Material &material = meshes[first].material;
+                if (!bound || *bound != material)
+                {
+                    material.bind(shader.ID);
+                    bound = &material;
+                }
+                geometry->draw(lodFirstDraw[level] + first, last - first);
+                first = last;
+            }
+        }
+        glBindVertexArray(0);
+    }
+
+    // keeps the meshes whose boxes are in the view volume for the following Draws (the
+    // model's sphere first, then the boxes four at a time); matrices as the shader gets
+    // them. false if nothing is visible.
+    bool Cull(const glm::mat4 &model, const glm::mat4 &view, const glm::mat4 &projection)
+    {
+        // planes in model space, so the bounds are tested as they are
+        Frustum frustum(projection * view * model);
+        if (frustum.intersectsSphere(boundsCenter, boundsRadius))
+            cullingStats = cullBoxes(frustum, meshBounds, meshVisible);
+        else
+        {
+            std::fill(meshVisible.begin(), meshVisible.end(), 0);
+            cullingStats.visible = 0;
+            cullingStats.culled = (unsigned int)meshes.size();
+        }
+        return cullingStats.visible > 0;
+    }
+
+    // sets the level Draw uses from the size of the bounding sphere on screen, as drawn
+    // with these matrices into a viewport of viewportHeight pixels; the level is returned.
+    unsigned int SelectLod(const glm::mat4 &model, const glm::mat4 &view, const glm::mat4 &projection, float viewportHeight)
+    {
+        glm::vec3 center = glm::vec3(view * model * glm::vec4(boundsCenter, 1.0f));
+        float scale = std::max(glm::length(glm::vec3(model[0])), std::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+        float radius = boundsRadius * scale;
+        float distance = glm::length(center);
+        float pixels = distance > radius ? radius * projection[1][1] * viewportHeight / distance : std::numeric_limits<float>::max();
+
+        // coarser only once it is that small even a bit larger, finer once it is that large even a bit smaller
+        unsigned int coarsest = lodForPixels(pixels * (1.0f - MODEL_LOD_HYSTERESIS));
+        unsigned int finest = lodForPixels(pixels * (1.0f + MODEL_LOD_HYSTERESIS));
+        lodLevel = std::min(std::max(lodLevel, finest), coarsest);
+        return lodLevel;
+    }
+
+    // triangles drawn at a level of detail
+    size_t TriangleCount(unsigned int level) const
+    {
+        if (lodTriangles.empty())
+            return 0;
+        return lodTriangles[std::min((size_t)level, lodTriangles.size() - 1)];
+    }
+
+    // system memory: the meshes' copies (none without keepCpuGeometry); video memory: the
+    // model's part of the geometry buffer and its textures (a texture shared with other
+    // models counts for each of them).
+    MemoryStats MemoryUsage() const
+    {
+        MemoryStats stats;
+        for (size_t i = 0; i < meshes.size(); ++i)
+            stats += meshes[i].memoryUsage();
+        stats.gpuBytes += geometryBytes;
+        for (size_t i = 0; i < textures_loaded.size(); ++i)
+            stats.gpuBytes += TextureCache::global().textureBytes(textures_loaded[i].id);
+        return stats;
     }
     
 private:
+    std::unique_ptr<GeometryBuffer> ownGeometry;
+    GeometryBuffer *geometry;
+    vector<unsigned int> lodFirstDraw;  // draw index of meshes[0] in geometry, by level
+    vector<size_t> lodTriangles;        // by level
+    size_t geometryBytes = 0;           // vertices and indices added to geometry
+    // consecutive meshes with the same material, drawn together
+    struct DrawRun
+    {
+        unsigned int first;
+        unsigned int count;
+    };
+    vector<DrawRun> runs;
+    // the meshes' boxes and what the last Cull kept (all, until there is one)
+    BoundingBoxes meshBounds;
+    vector<unsigned char> meshVisible;
+    // index in textures_loaded by file
+    unordered_map<string, size_t> loadedByFile;
+
+    // adds the meshes to the geometry buffer, as consecutive draws, and then each coarser
+    // level of them the same way (a mesh with fewer levels repeating its last), so the runs
+    // are draw ranges at every level.
+    void addToGeometry()
+    {
+        size_t staged = geometry->stagedBytes();
+        lodCount = 1;
+        for (size_t i = 0; i < meshes.size(); ++i)
+        {
+            lodCount = std::max(lodCount, (unsigned int)meshes[i].lods.size() + 1);
+            unsigned int draw = geometry->add(meshes[i]);
+            if (i == 0)
+                lodFirstDraw.assign(1, draw);
+            if (runs.empty() || meshes[i].material != meshes[runs.back().first].material)
+            {
+                DrawRun run = { (unsigned int)i, 0 };
+                runs.push_back(run);
+            }
+            ++runs.back().count;
+        }
+        for (unsigned int level = 1; level < lodCount; ++level)
+            for (size_t i = 0; i < meshes.size(); ++i)
+            {
+                const Mesh &mesh = meshes[i];
+                unsigned int draw = level <= mesh.lods.size()
+                    ? geometry->addLevel(lodFirstDraw[0] + (unsigned int)i, mesh.lods[level - 1])
+                    : geometry->repeat(lodFirstDraw[level - 1] + (unsigned int)i);
+                if (i == 0)
+                    lodFirstDraw.push_back(draw);
+            }
+        geometryBytes = geometry->stagedBytes() - staged;
+
+        lodTriangles.assign(lodCount, 0);
+        for (size_t i = 0; i < meshes.size(); ++i)
+        {
+            Mesh &mesh = meshes[i];
+            for (unsigned int level = 0; level < lodCount; ++level)
+            {
+                size_t meshLevel = std::min((size_t)level, mesh.lods.size());
+                lodTriangles[level] += (meshLevel ? mesh.lods[meshLevel - 1].size() : mesh.indexCount) / 3;
+            }
+            if (!keepCpuGeometry)
+                mesh.releaseGeometry();
+        }
+    }
+
+    // the meshes' boxes, and the sphere around the centre of their union enclosing the
+    // meshes' spheres
+    void computeBounds()
+    {
+        glm::vec3 lower(std::numeric_limits<float>::max()), upper(-std::numeric_limits<float>::max());
+        for (size_t i = 0; i < meshes.size(); ++i)
+        {
+            meshBounds.add(meshes[i].boundsMin, meshes[i].boundsMax);
+            lower = glm::min(lower, meshes[i].boundsMin);
+            upper = glm::max(upper, meshes[i].boundsMax);
+        }
+        meshVisible.assign(meshes.size(), 1);
+        cullingStats.visible = (unsigned int)meshes.size();
+        if (meshes.empty())
+            return;
+        boundsCenter = (lower + upper) * 0.5f;
+        boundsRadius = 0.0f;
+        for (size_t i = 0; i < meshes.size(); ++i)
+            boundsRadius = std::max(boundsRadius, glm::length(meshes[i].sphereCenter - boundsCenter) + meshes[i].sphereRadius);
+    }
+
+    // the level for a size on screen: full detail from MODEL_LOD_FULL_DETAIL_PIXELS, one
+    // level coarser at every halving.
+    unsigned int lodForPixels(float pixels) const
+    {
+        unsigned int level = 0;
+        for (float threshold = MODEL_LOD_FULL_DETAIL_PIXELS; level + 1 < lodCount && pixels < threshold; threshold *= 0.5f)
+            ++level;
+        return level;
+    }
+
     // loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
+    // the processed meshes are kept in <path>.meshcache, which later loads of the unchanged file (and materials) read instead.
     void loadModel(string const &path)
     {
+        // retrieve the directory path of the filepath
+        directory = path.substr(0, path.find_last_of('/'));
+
+        uint64_t sourceHash = 0;
+        bool hashed = hashSource(path, sourceHash);
+        string cachePath = path + ".meshcache";
+        if (hashed && loadCache(cachePath, sourceHash))
+        {
+            computeBounds();
+            addToGeometry();
+            return;
+        }
+
         // read file via ASSIMP
         Assimp::Importer importer;
-        const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
+        const aiScene* scene = importer.ReadFile(path, MODEL_IMPORT_FLAGS);
         // check for errors
         if(!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is Not Zero
         {
             cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << endl;
             return;
         }
-        // retrieve the directory path of the filepath
-        directory = path.substr(0, path.find_last_of('/'));
 
-        // process ASSIMP's root node recursively
-        processNode(scene->mRootNode, scene);
+        // the meshes in the order of the node hierarchy, and the textures their materials use
+        vector<const aiMesh *> order;
+        processNode(scene->mRootNode, scene, order);
+        vector<vector<pair<string, string> > > references(order.size());
+        for (size_t i = 0; i < order.size(); ++i)
+            references[i] = materialTextures(scene->mMaterials[order[i]->mMaterialIndex]);
+        vector<PendingTexture> pending = texturesToLoad(references);
+
+        // convert the meshes and hash the new texture files on all cores, then decode those
+        // the texture cache doesn't have and upload them on this (the GL) thread
+        vector<vector<Vertex> > vertices(order.size());
+        vector<vector<unsigned int> > indices(order.size());
+        vector<vector<vector<unsigned int> > > lods(order.size());
+        vector<VertexCacheStats> before(order.size()), after(order.size());
+        parallel_for(0, (int)(order.size() + pending.size()), [&](int job)
+        {
+            if (job < (int)order.size())
+                processMesh(order[job], vertices[job], indices[job], lods[job], before[job], after[job]);
+            else
+                hashTexture(pending[job - order.size()]);
+        });
+        loadTextures(pending);
+        VertexCacheStats totalBefore, totalAfter;
+        meshes.reserve(order.size());
+        for (size_t i = 0; i < order.size(); ++i)
+        {
+            meshes.emplace_back(std::move(vertices[i]), std::move(indices[i]), meshTextures(references[i]), vertexFormat, false);
+            meshes.back().lods = std::move(lods[i]);
+            totalBefore += before[i];
+            totalAfter += after[i];
+        }
+        cout << "Optimized " << path << ": ACMR " << totalBefore.acmr() << " -> " << totalAfter.acmr()
+             << ", ATVR " << totalBefore.atvr() << " -> " << totalAfter.atvr()
+             << " (FIFO of " << VERTEX_CACHE_FIFO_SIZE << ")" << endl;
+        if (hashed)
+            saveCache(cachePath, sourceHash);
+        computeBounds();
+        addToGeometry();
+        cout << "Levels of detail of " << path << ":";
+        for (unsigned int level = 0; level < lodCount; ++level)
+            cout << (level ? " / " : " ") << TriangleCount(level);
+        cout << " triangles" << endl;
+    }
+
+    // hash of the model file and, for OBJ, of the material libraries it names: the cache holds
+    // the texture references read from the .mtl, so editing it has to invalidate the cache too.
+    // false if the model file can't be opened.
+    bool hashSource(const string &path, uint64_t &hash) const
+    {
+        MappedFile file;
+        if (!file.open(path))
+            return false;
+        const char *text = (const char *)file.data();
+        size_t size = file.size();
+        hash = fnv1aHash(text, size);
+        string extension = path.substr(path.find_last_of('.') + 1);
+        std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+        if (extension != "obj")
+            return true;
+        for (size_t line = 0; line < size; )
+        {
+            size_t end = line;
+            while (end < size && text[end] != '\n')
+                ++end;
+            // like assimp, the rest of the line is the file name ("mtllib old chair.mtl")
+            if (end - line > 7 && strncmp(text + line, "mtllib", 6) == 0 && isspace((unsigned char)text[line + 6]))
+            {
+                size_t first = line + 7, last = end;
+                while (first < last && isspace((unsigned char)text[first]))
+                    ++first;
+                while (last > first && isspace((unsigned char)text[last - 1]))
+                    --last;
+                string name(text + first, last - first);
+                hash = fnv1aHash(name.data(), name.size(), hash);
+                MappedFile library;
+                if (library.open(directory + '/' + name))
+                    hash = fnv1aHash(library.data(), library.size(), hash);
+            }
+            line = end + 1;
+        }
+        return true;
+    }
+
+    // create the meshes from a valid cache file. the geometry is copied out of the mapping into the
+    // meshes, which upload it and keep or release it like freshly imported geometry.
+    bool loadCache(const string &cachePath, uint64_t sourceHash)
+    {
+        MeshCacheReader cache;
+        if (!cache.open(cachePath, sourceHash, MODEL_IMPORT_FLAGS, sizeof(Vertex)))
+            return false;
+        // the textures first
+        vector<vector<pair<string, string> > > references(cache.meshCount());
+        for (uint32_t i = 0; i < cache.meshCount(); ++i)
+        {
+            const MeshCacheEntry &entry = cache.mesh(i);
+            for (uint32_t t = entry.firstTexture; t < entry.firstTexture + entry.textureCount; ++t)
+                references[i].push_back(make_pair(string(cache.textureType(t)), string(cache.texturePath(t))));
+        }
+        vector<PendingTexture> pending = texturesToLoad(references);
+        parallel_for(0, (int)pending.size(), [&](int i) { hashTexture(pending[i]); });
+        loadTextures(pending);
+
+        meshes.reserve(cache.meshCount());
+        for (uint32_t i = 0; i < cache.meshCount(); ++i)
+        {
+            const MeshCacheEntry &entry = cache.mesh(i);
+            const Vertex *first = (const Vertex *)cache.vertices(i);
+            vector<Vertex> vertices(first, first + entry.vertexCount);
+            vector<unsigned int> indices(cache.indices(i), cache.indices(i) + entry.indexCount);
+            meshes.emplace_back(std::move(vertices), std::move(indices), meshTextures(references[i]), vertexFormat, false);
+            for (uint32_t l = 0; l < entry.lodCount; ++l)
+                meshes.back().lods.push_back(vector<unsigned int>(cache.lodIndices(i, l), cache.lodIndices(i, l) + cache.lod(i, l).indexCount));
+        }
+        return true;
+    }
+
+    void saveCache(const string &cachePath, uint64_t sourceHash) const
+    {
+        MeshCacheWriter cache(sizeof(Vertex));
+        for (size_t i = 0; i < meshes.size(); ++i)
+        {
+            const Mesh &mesh = meshes[i];
+            vector<pair<string, string> > textures;
+            for (size_t t = 0; t < mesh.textures.size(); ++t)
+                textures.push_back(make_pair(mesh.textures[t].type, mesh.textures[t].path));
+            cache.addMesh(mesh.vertices.empty() ? nullptr : &mesh.vertices[0], (uint32_t)mesh.vertices.size(),
+                mesh.indices.empty() ? nullptr : &mesh.indices[0], (uint32_t)mesh.indices.size(), textures, mesh.lods);
+        }
+        cache.write(cachePath, sourceHash, MODEL_IMPORT_FLAGS);
     }
 
-    // processes a node in a recursive fashion. Processes each individual mesh located at the node and repeats this process on its children nodes (if any).
-    void processNode(aiNode *node, const aiScene *scene)
+    // processes a node in a recursive fashion. Collects each individual mesh located at the node and repeats this process on its children nodes (if any).
+    void processNode(aiNode *node, const aiScene *scene, vector<const aiMesh *> &order)
     {
         // process each mesh located at the current node
         for(unsigned int i = 0; i < node->mNumMeshes; i++)
         {
             // the node object only contains indices to index the actual objects in the scene. 
             // the scene contains all the data, node is just to keep stuff organized (like relations between nodes).
-            aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-            meshes.push_back(processMesh(mesh, scene));
+            order.push_back(scene->mMeshes[node->mMeshes[i]]);
         }
         // after we've processed all of the meshes (if any) we then recursively process each of the children nodes
         for(unsigned int i = 0; i < node->mNumChildren; i++)
         {
-            processNode(node->mChildren[i], scene);
+            processNode(node->mChildren[i], scene, order);
         }
 
     }
 
-    Mesh processMesh(aiMesh *mesh, const aiScene *scene)
+    // converts the mesh (reading the scene only, so meshes can be processed concurrently)
+    // and builds its levels of detail; before and after get the vertex cache statistics
+    // (see optimizeMesh).
+    static void processMesh(const aiMesh *mesh, vector<Vertex> &vertices, vector<unsigned int> &indices,
+        vector<vector<unsigned int> > &lods, VertexCacheStats &before, VertexCacheStats &after)
     {
-        // data to fill
-        vector<Vertex> vertices;
-        vector<unsigned int> indices;
-        vector<Texture> textures;
+        vertices.reserve(mesh->mNumVertices);
+        indices.reserve(mesh->mNumFaces * 3);
 
         // walk through each of the mesh's vertices
         for(unsigned int i = 0; i < mesh->mNumVertices; i++)
@@ -137,68 +516,172 @@ private:
         // now wak through each of the mesh's faces (a face is a mesh its triangle) and retrieve the corresponding vertex indices.
         for(unsigned int i = 0; i < mesh->mNumFaces; i++)
         {
-            aiFace face = mesh->mFaces[i];
+            const aiFace &face = mesh->mFaces[i];
             // retrieve all indices of the face and store them in the indices vector
             for(unsigned int j = 0; j < face.mNumIndices; j++)
                 indices.push_back(face.mIndices[j]);        
         }
-        // process materials
-        aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];    
+        // reorder for the vertex cache, overdraw and fetch (learnopengl/mesh_optimize.h)
+        optimizeMesh(vertices, indices, &before, &after);
+        // coarser index lists over the same vertices (learnopengl/mesh_simplify.h)
+        lods = buildMeshLods(vertices, indices);
+    }
+
+    // the (type, path) of the material's textures.
+    static vector<pair<string, string> > materialTextures(aiMaterial *material)
+    {
         // we assume a convention for sampler names in the shaders. Each diffuse texture should be named
         // as 'texture_diffuseN' where N is a sequential number ranging from 1 to MAX_SAMPLER_NUMBER. 
         // Same applies to other texture as the following list summarizes:
         // diffuse: texture_diffuseN
         // specular: texture_specularN
         // normal: texture_normalN
-
+        vector<pair<string, string> > textures;
         // 1. diffuse maps
-        vector<Texture> diffuseMaps = loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse");
-        textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
+        materialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse", textures);
         // 2. specular maps
-        vector<Texture> specularMaps = loadMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular");
-        textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
+        materialTextures(material, aiTextureType_SPECULAR, "texture_specular", textures);
         // 3. normal maps
-        std::vector<Texture> normalMaps = loadMaterialTextures(material, aiTextureType_HEIGHT, "texture_normal");
-        textures.insert(textures.end(), normalMaps.begin(), normalMaps.end());
+        materialTextures(material, aiTextureType_HEIGHT, "texture_normal", textures);
         // 4. height maps
-        std::vector<Texture> heightMaps = loadMaterialTextures(material, aiTextureType_AMBIENT, "texture_height");
-        textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
-        
-        // return a mesh object created from the extracted mesh data
-        return Mesh(vertices, indices, textures);
+        materialTextures(material, aiTextureType_AMBIENT, "texture_height", textures);
+        return textures;
     }
 
-    // checks all material textures of a given type and loads the textures if they're not loaded yet.
-    // the required info is returned as a Texture struct.
-    vector<Texture> loadMaterialTextures(aiMaterial *mat, aiTextureType type, string typeName)
+    // checks all material textures of a given type and adds them to textures.
+    static void materialTextures(aiMaterial *mat, aiTextureType type, const string &typeName, vector<pair<string, string> > &textures)
     {
-        vector<Texture> textures;
         for(unsigned int i = 0; i < mat->GetTextureCount(type); i++)
         {
             aiString str;
             mat->GetTexture(type, i, &str);
-            // check if texture was loaded before and if so, continue to next iteration: skip loading a new texture
-            bool skip = false;
-            for(unsigned int j = 0; j < textures_loaded.size(); j++)
+            textures.push_back(make_pair(typeName, string(str.C_Str())));
+        }
+    }
+
+    // a texture file of the model that TextureCache::global() didn't have under its path
+    struct PendingTexture
+    {
+        string file;        // relative to the model's directory
+        string canonical;   // canonicalTexturePath
+        bool hashed;        // false if the file can't be read
+        uint64_t hash;      // of the contents
+        int image;          // the decoded image it gets, -1 if it is found by its contents
+    };
+
+    // the files of references that aren't loaded yet, each once; those the texture cache has
+    // are taken from it, the others returned.
+    vector<PendingTexture> texturesToLoad(const vector<vector<pair<string, string> > > &references)
+    {
+        vector<PendingTexture> pending;
+        unordered_map<string, bool> seen;
+        for (size_t i = 0; i < references.size(); ++i)
+            for (size_t t = 0; t < references[i].size(); ++t)
             {
-                if(std::strcmp(textures_loaded[j].path.data(), str.C_Str()) == 0)
+                const string &file = references[i][t].second;
+                if (findTexture(file) || !seen.insert(make_pair(file, true)).second)
+                    continue;
+                PendingTexture texture = { file, canonicalTexturePath(directory + '/' + file), false, 0, -1 };
+                unsigned int id = TextureCache::global().acquire(texture.canonical);
+                if (id)
+                    addTexture(file, id);
+                else
+                    pending.push_back(texture);
+            }
+        return pending;
+    }
+
+    // thread safe
+    void hashTexture(PendingTexture &texture) const
+    {
+        texture.hashed = meshCacheHashFile(directory + '/' + texture.file, texture.hash);
+    }
+
+    // the hashed pending files: the ones with contents the texture cache (or an earlier one
+    // of them) has share that texture, the rest are decoded on all cores and uploaded.
+    void loadTextures(vector<PendingTexture> &pending)
+    {
+        vector<string> files;
+        unordered_map<uint64_t, int> batch; // contents -> image
+        for (size_t i = 0; i < pending.size(); ++i)
+        {
+            PendingTexture &texture = pending[i];
+            if (texture.hashed)
+            {
+                unsigned int id = TextureCache::global().acquire(texture.hash, texture.canonical);
+                if (id)
+                {
+                    addTexture(texture.file, id);
+                    continue;
+                }
+                unordered_map<uint64_t, int>::const_iterator copy = batch.find(texture.hash);
+                if (copy != batch.end())
                 {
-                    textures.push_back(textures_loaded[j]);
-                    skip = true; // a texture with the same filepath has already been loaded, continue to next one. (optimization)
-                    break;
+                    texture.image = copy->second;
+                    continue;
                 }
+                batch[texture.hash] = (int)files.size();
             }
-            if(!skip)
-            {   // if texture hasn't been loaded already, load it
-                Texture texture;
-                texture.id = TextureFromFile(str.C_Str(), this->directory);
-                texture.type = typeName;
-                texture.path = str.C_Str();
-                textures.push_back(texture);
-                textures_loaded.push_back(texture);  // store it as texture loaded for entire model, to ensure we won't unnecesery load duplicate textures.
+            texture.image = (int)files.size();
+            files.push_back(texture.file);
+        }
+
+        vector<TextureImage> images(files.size());
+        parallel_for(0, (int)files.size(), [&](int i) { images[i].decode(this->directory + '/' + files[i]); });
+        vector<size_t> bytes(images.size());
+        for (size_t i = 0; i < images.size(); ++i)
+            bytes[i] = images[i].bytes() + images[i].bytes() / 3;  // with the mipmaps
+        vector<unsigned int> ids = uploadTextureImages(images);
+        vector<bool> inserted(ids.size(), false);
+        for (size_t i = 0; i < pending.size(); ++i)
+        {
+            const PendingTexture &texture = pending[i];
+            if (texture.image < 0)
+                continue;
+            unsigned int id = ids[texture.image];
+            if (!inserted[texture.image])
+            {
+                TextureCache::global().insert(texture.canonical, texture.hashed, texture.hash, id, bytes[texture.image]);
+                inserted[texture.image] = true;
             }
+            else
+                TextureCache::global().acquire(texture.hash, texture.canonical);
+            addTexture(texture.file, id);
         }
-        return textures;
+        if (!textures_loaded.empty())
+            cout << "Textures of " << directory << ": " << files.size() << " uploaded, "
+                 << textures_loaded.size() - files.size() << " shared" << endl;
+    }
+
+    void addTexture(const string &file, unsigned int id)
+    {
+        Texture texture;
+        texture.id = id;
+        texture.path = file;
+        loadedByFile[file] = textures_loaded.size();
+        textures_loaded.push_back(texture);  // store it as texture loaded for entire model, to ensure we won't unnecesery load duplicate textures.
+    }
+
+    // the loaded textures of a mesh's references.
+    vector<Texture> meshTextures(const vector<pair<string, string> > &references) const
+    {
+        vector<Texture> result;
+        for (size_t t = 0; t < references.size(); ++t)
+        {
+            const Texture *loaded = findTexture(references[t].second);
+            if (!loaded)
+                continue;
+            Texture texture = *loaded;
+            texture.type = references[t].first;
+            result.push_back(texture);
+        }
+        return result;
+    }
+
+    const Texture *findTexture(const string &file) const
+    {
+        unordered_map<string, size_t>::const_iterator found = loadedByFile.find(file);
+        return found == loadedByFile.end() ? nullptr : &textures_loaded[found->second];
     }
 };
 
@@ -208,38 +691,8 @@ unsigned int TextureFromFile(const char *path, const string &directory, bool gam
     string filename = string(path);
     filename = directory + '/' + filename;
 
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-
-    int width, height, nrComponents;
-    unsigned char *data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
-    if (data)
-    {
-        GLenum format;
-        if (nrComponents == 1)
-            format = GL_RED;
-        else if (nrComponents == 3)
-            format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
-
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        stbi_image_free(data);
-    }
-    else
-    {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
-    }
-
-    return textureID;
+    vector<TextureImage> images(1);
+    images[0].decode(filename);
+    return uploadTextureImages(images)[0];
 }
 #endif
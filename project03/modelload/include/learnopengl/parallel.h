@@ -0,0 +1,44 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+// splits [begin, end) into contiguous chunks and runs func(i) for every index on
+// one std::thread per hardware thread. func must be safe to call concurrently for
+// different indices. Blocks until every chunk is done.
+template <typename Func>
+void parallel_for(int begin, int end, Func func)
+{
+    int count = end - begin;
+    if (count <= 0)
+        return;
+    int threadCount = (int)std::max(1u, std::thread::hardware_concurrency());
+    threadCount = std::min(threadCount, count);
+    if (threadCount == 1)
+    {
+        for (int i = begin; i < end; ++i)
+            func(i);
+        return;
+    }
+
+    std::vector<std::thread> workers;
+    workers.reserve(threadCount);
+    int chunk = (count + threadCount - 1) / threadCount;
+    for (int t = 0; t < threadCount; ++t)
+    {
+        int first = begin + t * chunk;
+        int last = std::min(end, first + chunk);
+        if (first >= last)
+            break;
+        workers.emplace_back([first, last, &func]()
+        {
+            for (int i = first; i < last; ++i)
+                func(i);
+        });
+    }
+    for (unsigned int t = 0; t < workers.size(); ++t)
+        workers[t].join();
+}
+#endif
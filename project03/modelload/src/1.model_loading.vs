@@ -1,16 +1,30 @@
 #version 330 core
-layout (location = 0) in vec3 aPos;
-layout (location = 1) in vec3 aNormal;
+layout (location = 0) in vec3 aPos;       // float, or unorm16 within the mesh bounds
 layout (location = 2) in vec2 aTexCoords;
+// quantized positions are aPositionOffset + aPos * aPositionScale (learnopengl/mesh.h,
+// the identity for float positions)
+layout (location = 5) in vec3 aPositionOffset;
+layout (location = 6) in vec3 aPositionScale;
 
 out vec2 TexCoords;
 
+// per-frame camera and lights shared by all programs (learnopengl/frame_uniforms.h); the
+// lights as many as its MAX_FRAME_LIGHTS
+#ifndef MAX_FRAME_LIGHTS
+#define MAX_FRAME_LIGHTS 4
+#endif
+layout (std140) uniform FrameUniforms
+{
+    mat4 projection;
+    mat4 view;
+    vec4 camPos;                            // xyz
+    vec4 lightPositions[MAX_FRAME_LIGHTS];  // xyz
+    vec4 lightColors[MAX_FRAME_LIGHTS];     // rgb
+};
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
 
 void main()
 {
     TexCoords = aTexCoords;    
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
+    gl_Position = projection * view * model * vec4(aPositionOffset + aPos * aPositionScale, 1.0);
 }
\ No newline at end of file
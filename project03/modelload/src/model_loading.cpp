@@ -11,6 +11,7 @@
 #include <learnopengl/shader_m.h>
 #include <learnopengl/camera.h>
 #include <learnopengl/model.h>
+#include <learnopengl/frame_uniforms.h>
 #undef STB_IMAGE_IMPLEMENTATION
 
 #include <iostream>
@@ -88,57 +89,73 @@ int main()
     // -------------------------
     Shader ourShader("src/1.model_loading.vs", "src/1.model_loading.fs");
 
-    // load models
-    // -----------
-    Model ourModel(FileSystem::getPath("../resources/cd/Vazz.obj"));
-    Model ourModel2(FileSystem::getPath("../resources/cd/VazGlass.obj"));
-    
-    // draw in wireframe
-    //glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+    // view/projection of every program, one uniform buffer write per frame
+    FrameUniforms frameUniforms;
+    frameUniforms.attach(ourShader.ID);
 
-    // render loop
+    // load models, with quantized positions and packed normals and texture coordinates
+    // (learnopengl/mesh.h); the vertex shader scales the positions back. both go into one
+    // vertex and index buffer (learnopengl/geometry_buffer.h), which keeps the only copy.
     // -----------
-    while (!glfwWindowShouldClose(window))
+    // the models and their geometry buffer live in this block, so the buffers are deleted
+    // at its end while the context is current, and the textures by the collect below
     {
-        // per-frame time logic
-        // --------------------
-        float currentFrame = glfwGetTime();
-        deltaTime = currentFrame - lastFrame;
-        lastFrame = currentFrame;
-
-        // input
-        // -----
-        processInput(window);
-
-        // render
-        // ------
-        glClearColor(0.05f, 0.05f, 0.05f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-        // don't forget to enable shader before setting uniforms
-        ourShader.use();
-
-        // view/projection transformations
-        glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
-        glm::mat4 view = camera.GetViewMatrix();
-        ourShader.setMat4("projection", projection);
-        ourShader.setMat4("view", view);
-
-        // render the loaded model
-        glm::mat4 model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(0.0f, 0.0f, 0.0f)); // translate it down so it's at the center of the scene
-        model = glm::scale(model, glm::vec3(0.2f, 0.2f, 0.2f));	// it's a bit too big for our scene, so scale it down
-		model = glm::rotate(model, objRotate.pitch(), glm::vec3(1.0f, 0.0f, 0.0f)); //pitch
-		model = glm::rotate(model, objRotate.yaw(), glm::vec3(0.0f, 1.0f, 0.0f)); //yaw
-        ourShader.setMat4("model", model);
-        ourModel.Draw(ourShader);
-        ourModel2.Draw(ourShader);
-
-        // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
-        // -------------------------------------------------------------------------------
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+        GeometryBuffer sceneGeometry(VERTEX_QUANTIZED);
+        Model ourModel(FileSystem::getPath("../resources/cd/Vazz.obj"), sceneGeometry, false, false);
+        Model ourModel2(FileSystem::getPath("../resources/cd/VazGlass.obj"), sceneGeometry, false, false);
+        sceneGeometry.upload();
+    
+        // draw in wireframe
+        //glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+
+        // render loop
+        // -----------
+        while (!glfwWindowShouldClose(window))
+        {
+            // per-frame time logic
+            // --------------------
+            float currentFrame = glfwGetTime();
+            deltaTime = currentFrame - lastFrame;
+            lastFrame = currentFrame;
+
+            // input
+            // -----
+            processInput(window);
+
+            // render
+            // ------
+            glClearColor(0.05f, 0.05f, 0.05f, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+            // view/projection transformations
+            glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
+            frameUniforms.setCamera(projection, camera.GetViewMatrix(), camera.Position);
+            frameUniforms.upload();
+
+            // don't forget to enable shader before setting uniforms
+            ourShader.use();
+
+            // render the loaded model
+            glm::mat4 model = glm::mat4(1.0f);
+            model = glm::translate(model, glm::vec3(0.0f, 0.0f, 0.0f)); // translate it down so it's at the center of the scene
+            model = glm::scale(model, glm::vec3(0.2f, 0.2f, 0.2f));	// it's a bit too big for our scene, so scale it down
+			model = glm::rotate(model, objRotate.pitch(), glm::vec3(1.0f, 0.0f, 0.0f)); //pitch
+			model = glm::rotate(model, objRotate.yaw(), glm::vec3(0.0f, 1.0f, 0.0f)); //yaw
+            ourShader.setMat4("model", model);
+            ourModel.SelectLod(model, camera.GetViewMatrix(), projection, (float)SCR_HEIGHT);
+            ourModel2.SelectLod(model, camera.GetViewMatrix(), projection, (float)SCR_HEIGHT);
+            if (ourModel.Cull(model, camera.GetViewMatrix(), projection))
+                ourModel.Draw(ourShader);
+            if (ourModel2.Cull(model, camera.GetViewMatrix(), projection))
+                ourModel2.Draw(ourShader);
+
+            // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
+            // -------------------------------------------------------------------------------
+            glfwSwapBuffers(window);
+            glfwPollEvents();
+        }
     }
+    TextureCache::global().collect();
 
     // glfw: terminate, clearing all previously allocated GLFW resources.
     // ------------------------------------------------------------------